@@ -36,7 +36,6 @@
 #include "pipeline/pipeline.h"
 #include "vulkan/vulkan.h"
 #include "vulkan/remove_xlib_macros.h"
-#include "util/void_t.h"
 
 #if SDL_MAJOR_VERSION != 2
 #error wrong SDL varsion
@@ -905,17 +904,20 @@ int test_main(int argc, char **argv)
         {
         };
         Uniforms uniforms{};
+        const vulkan::Vulkan_image *color_attachments[color_attachment_count] = {
+            color_attachment.get(),
+        };
         graphics_pipeline->run(vertex_start_index,
                                vertex_end_index,
                                instance_id,
-                               *color_attachment,
+                               instance_id + 1,
+                               nullptr,
+                               color_attachments,
+                               nullptr,
                                bindings,
-                               &uniforms);
+                               &uniforms,
+                               1);
         typedef std::uint32_t Pixel_type;
-        // check Pixel_type
-        static_assert(std::is_void<util::void_t<decltype(graphics_pipeline->run_fragment_shader(
-                          static_cast<Pixel_type *>(nullptr), nullptr))>>::value,
-                      "");
         auto rgba = [](std::uint8_t r,
                        std::uint8_t g,
                        std::uint8_t b,
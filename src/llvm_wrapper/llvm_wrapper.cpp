@@ -162,6 +162,14 @@ LLVM_intrinsic_id get_llvm_intrinsic_id(Intrinsic intrinsic) noexcept
     {
     case Intrinsic::fmuladd:
         return cvt(ID::fmuladd);
+    case Intrinsic::masked_gather:
+        return cvt(ID::masked_gather);
+    case Intrinsic::masked_load:
+        return cvt(ID::masked_load);
+    case Intrinsic::masked_store:
+        return cvt(ID::masked_store);
+    case Intrinsic::sqrt:
+        return cvt(ID::sqrt);
     }
     assert(false);
     return LLVM_intrinsic_id::Not_intrinsic;
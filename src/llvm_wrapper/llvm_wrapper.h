@@ -321,6 +321,10 @@ struct Target_machine : public Wrapper<::LLVMTargetMachineRef, Target_machine_de
 enum class Intrinsic // doesn't match llvm::Intrinsic::ID
 {
     fmuladd,
+    masked_gather,
+    masked_load,
+    masked_store,
+    sqrt,
 };
 
 enum class LLVM_intrinsic_id : unsigned
@@ -462,6 +466,134 @@ struct Builder : public Wrapper<::LLVMBuilderRef, Builder_deleter>
     {
         return build_fmuladd(get(), module, factor1, factor2, term, result_name);
     }
+    static ::LLVMValueRef build_sqrt(::LLVMBuilderRef builder,
+                                     ::LLVMModuleRef module,
+                                     ::LLVMValueRef value,
+                                     const char *result_name)
+    {
+        auto intrinsic = Module::get_intrinsic_declaration(
+            module, get_llvm_intrinsic_id(Intrinsic::sqrt), {::LLVMTypeOf(value)});
+        constexpr std::size_t arg_count = 1;
+        ::LLVMValueRef args[arg_count] = {
+            value,
+        };
+        return ::LLVMBuildCall(builder, intrinsic, args, arg_count, result_name);
+    }
+    ::LLVMValueRef build_sqrt(::LLVMModuleRef module,
+                              ::LLVMValueRef value,
+                              const char *result_name) const
+    {
+        return build_sqrt(get(), module, value, result_name);
+    }
+    /** loads the value pointed to by each element of the vector of pointers pointers where the
+     * corresponding element of the vector of i1 mask is set and returns pass_through's element
+     * for the others */
+    static ::LLVMValueRef build_masked_gather(::LLVMBuilderRef builder,
+                                              ::LLVMModuleRef module,
+                                              ::LLVMValueRef pointers,
+                                              unsigned alignment,
+                                              ::LLVMValueRef mask,
+                                              ::LLVMValueRef pass_through,
+                                              const char *result_name)
+    {
+        auto type = ::LLVMTypeOf(pass_through);
+        auto pointers_type = ::LLVMTypeOf(pointers);
+        assert(::LLVMGetTypeKind(type) == ::LLVMVectorTypeKind);
+        assert(::LLVMGetTypeKind(pointers_type) == ::LLVMVectorTypeKind);
+        assert(::LLVMGetElementType(::LLVMGetElementType(pointers_type))
+               == ::LLVMGetElementType(type));
+        auto context = ::LLVMGetTypeContext(type);
+        auto intrinsic = Module::get_intrinsic_declaration(
+            module, get_llvm_intrinsic_id(Intrinsic::masked_gather), {type, pointers_type});
+        constexpr std::size_t arg_count = 4;
+        ::LLVMValueRef args[arg_count] = {
+            pointers,
+            ::LLVMConstInt(::LLVMInt32TypeInContext(context), alignment, false),
+            mask,
+            pass_through,
+        };
+        return ::LLVMBuildCall(builder, intrinsic, args, arg_count, result_name);
+    }
+    ::LLVMValueRef build_masked_gather(::LLVMModuleRef module,
+                                       ::LLVMValueRef pointers,
+                                       unsigned alignment,
+                                       ::LLVMValueRef mask,
+                                       ::LLVMValueRef pass_through,
+                                       const char *result_name) const
+    {
+        return build_masked_gather(
+            get(), module, pointers, alignment, mask, pass_through, result_name);
+    }
+    /** loads the elements where the corresponding element of the vector of i1 mask is set and
+     * returns pass_through's element for the others; memory for the other elements isn't
+     * accessed */
+    static ::LLVMValueRef build_masked_load(::LLVMBuilderRef builder,
+                                            ::LLVMModuleRef module,
+                                            ::LLVMValueRef pointer,
+                                            unsigned alignment,
+                                            ::LLVMValueRef mask,
+                                            ::LLVMValueRef pass_through,
+                                            const char *result_name)
+    {
+        auto type = ::LLVMTypeOf(pass_through);
+        auto pointer_type = ::LLVMTypeOf(pointer);
+        assert(::LLVMGetTypeKind(type) == ::LLVMVectorTypeKind);
+        assert(::LLVMGetElementType(pointer_type) == type);
+        auto context = ::LLVMGetTypeContext(type);
+        auto intrinsic = Module::get_intrinsic_declaration(
+            module, get_llvm_intrinsic_id(Intrinsic::masked_load), {type, pointer_type});
+        constexpr std::size_t arg_count = 4;
+        ::LLVMValueRef args[arg_count] = {
+            pointer,
+            ::LLVMConstInt(::LLVMInt32TypeInContext(context), alignment, false),
+            mask,
+            pass_through,
+        };
+        return ::LLVMBuildCall(builder, intrinsic, args, arg_count, result_name);
+    }
+    ::LLVMValueRef build_masked_load(::LLVMModuleRef module,
+                                     ::LLVMValueRef pointer,
+                                     unsigned alignment,
+                                     ::LLVMValueRef mask,
+                                     ::LLVMValueRef pass_through,
+                                     const char *result_name) const
+    {
+        return build_masked_load(
+            get(), module, pointer, alignment, mask, pass_through, result_name);
+    }
+    /** stores the elements of value where the corresponding element of the vector of i1 mask is
+     * set; memory for the other elements isn't accessed */
+    static ::LLVMValueRef build_masked_store(::LLVMBuilderRef builder,
+                                             ::LLVMModuleRef module,
+                                             ::LLVMValueRef value,
+                                             ::LLVMValueRef pointer,
+                                             unsigned alignment,
+                                             ::LLVMValueRef mask)
+    {
+        auto type = ::LLVMTypeOf(value);
+        auto pointer_type = ::LLVMTypeOf(pointer);
+        assert(::LLVMGetTypeKind(type) == ::LLVMVectorTypeKind);
+        assert(::LLVMGetElementType(pointer_type) == type);
+        auto context = ::LLVMGetTypeContext(type);
+        auto intrinsic = Module::get_intrinsic_declaration(
+            module, get_llvm_intrinsic_id(Intrinsic::masked_store), {type, pointer_type});
+        constexpr std::size_t arg_count = 4;
+        ::LLVMValueRef args[arg_count] = {
+            value,
+            pointer,
+            ::LLVMConstInt(::LLVMInt32TypeInContext(context), alignment, false),
+            mask,
+        };
+        return ::LLVMBuildCall(builder, intrinsic, args, arg_count, "");
+    }
+    ::LLVMValueRef build_masked_store(::LLVMModuleRef module,
+                                      ::LLVMValueRef value,
+                                      ::LLVMValueRef pointer,
+                                      unsigned alignment,
+                                      ::LLVMValueRef mask) const
+    {
+        return build_masked_store(get(), module, value, pointer, alignment, mask);
+    }
 };
 
 struct Pass_manager_deleter
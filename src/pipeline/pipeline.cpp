@@ -21,17 +21,24 @@
  *
  */
 #include "pipeline.h"
+#include "rasterizer.h"
 #include "spirv_to_llvm/spirv_to_llvm.h"
 #include "llvm_wrapper/llvm_wrapper.h"
 #include "llvm_wrapper/orc_compile_stack.h"
 #include "vulkan/util.h"
+#include "vulkan/color_format.h"
 #include "util/soft_float.h"
+#include "util/bit_intrinsics.h"
 #include "json/json.h"
 #include <stdexcept>
 #include <cassert>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
 
 namespace kazan
 {
@@ -200,6 +207,115 @@ llvm_wrapper::Module Pipeline::optimize_module(llvm_wrapper::Module module,
 
 struct Graphics_pipeline::Implementation
 {
+    static constexpr std::size_t vec4_native_alignment = alignof(float) * 4;
+    static constexpr std::size_t max_alignment = alignof(std::max_align_t);
+    static constexpr std::size_t vec4_alignment =
+        vec4_native_alignment > max_alignment ? max_alignment : vec4_native_alignment;
+    static constexpr std::size_t ivec4_native_alignment = alignof(std::int32_t) * 4;
+    static constexpr std::size_t ivec4_alignment =
+        ivec4_native_alignment > max_alignment ? max_alignment : ivec4_native_alignment;
+    struct alignas(vec4_alignment) Vec4
+    {
+        float x;
+        float y;
+        float z;
+        float w;
+        constexpr Vec4() noexcept : x(), y(), z(), w()
+        {
+        }
+        constexpr explicit Vec4(float x, float y, float z, float w) noexcept : x(x),
+                                                                               y(y),
+                                                                               z(z),
+                                                                               w(w)
+        {
+        }
+    };
+    struct alignas(ivec4_alignment) Ivec4
+    {
+        std::int32_t x;
+        std::int32_t y;
+        std::int32_t z;
+        std::int32_t w;
+        constexpr Ivec4() noexcept : x(), y(), z(), w()
+        {
+        }
+        constexpr explicit Ivec4(std::int32_t x,
+                                 std::int32_t y,
+                                 std::int32_t z,
+                                 std::int32_t w) noexcept : x(x),
+                                                            y(y),
+                                                            z(z),
+                                                            w(w)
+        {
+        }
+    };
+    static constexpr std::size_t triangle_vertex_count = 3;
+    static constexpr std::size_t line_vertex_count = 2;
+    struct Triangle
+    {
+        Vec4 vertexes[triangle_vertex_count];
+        // index of the unclipped triangle in the current vertex batch
+        std::uint32_t primitive_index;
+        constexpr Triangle() noexcept : vertexes{}, primitive_index()
+        {
+        }
+        constexpr Triangle(const Vec4 &v0,
+                           const Vec4 &v1,
+                           const Vec4 &v2,
+                           std::uint32_t primitive_index) noexcept
+            : vertexes{v0, v1, v2},
+              primitive_index(primitive_index)
+        {
+        }
+    };
+    struct Primitive_setup
+    {
+        Edge_equation edge_equations[triangle_vertex_count];
+        Plane_equation depth_plane;
+        // only set up when the fragment shader has inputs
+        Plane_equation inverse_w_plane;
+        std::size_t varying_plane_start;
+        std::int32_t min_x;
+        std::int32_t end_x;
+        std::int32_t min_y;
+        std::int32_t end_y;
+        // small triangles are rasterized using small_triangle_coverage_mask, which the front end
+        // computes for the pixels relative to (min_x, min_y), instead of edge_equations
+        bool is_small;
+        Small_triangle_coverage_mask small_triangle_coverage_mask;
+    };
+    /** the buffers for one partition of the front end (vertex shading, clipping, triangle setup
+     * and binning); kept between draws so they don't need to be reallocated */
+    struct Front_end_buffers
+    {
+        // the vertex shader outputs of the current vertex batch
+        std::vector<unsigned char> vertex_buffer;
+        // the index into vertex_buffer of each vertex in the current vertex batch, multiplied by
+        // the batch's instance count; the outputs for the batch's i-th instance follow at
+        // vertex_buffer_indexes[vertex] * instance_count + i. For indexed draws, each vertex
+        // that's used more than once in the batch is only shaded once.
+        std::vector<std::uint32_t> vertex_buffer_indexes;
+        // the vertex index of each vertex in the current vertex batch; only used for indexed draws
+        std::vector<std::uint32_t> vertex_indexes;
+        // whether each vertex in the current vertex batch is a primitive restart index; kept
+        // separately from vertex_indexes since every vertex index can be used by a draw
+        std::vector<bool> primitive_restarts;
+        // the sorted unique vertex indexes of the current vertex batch, in vertex_buffer order;
+        // only used for indexed draws
+        std::vector<std::uint32_t> unique_vertex_indexes;
+        // the indexes into vertex_buffer of the vertexes of each primitive assembled from the
+        // current vertex batch
+        std::vector<std::uint32_t> primitive_vertex_buffer_indexes;
+        std::vector<Triangle> triangles;
+        // triangles that cross the near or far planes or the sides of the guard band
+        std::vector<Triangle> triangles_to_clip;
+        std::vector<Triangle> temp_triangles;
+        std::vector<Primitive_setup> primitive_setups;
+        // one plane per fragment shader input component for each triangle
+        std::vector<Plane_equation> varying_planes;
+        // each bin holds indexes into primitive_setups in submission order
+        std::vector<std::vector<std::uint32_t>> tile_bins;
+    };
     llvm_wrapper::Context llvm_context = llvm_wrapper::Context::create();
     spirv_to_llvm::Jit_symbol_resolver jit_symbol_resolver;
     llvm_wrapper::Orc_compile_stack jit_stack;
@@ -207,6 +323,54 @@ struct Graphics_pipeline::Implementation
     std::unique_ptr<Instantiated_pipeline_layout> instantiated_pipeline_layout;
     std::vector<spirv_to_llvm::Converted_module> compiled_shaders;
     std::shared_ptr<spirv_to_llvm::Struct_type_descriptor> vertex_shader_output_struct;
+    // the number of vertexes (or indexes, for indexed draws) assembled at a time by each worker
+    // thread; a multiple of triangle_vertex_count, so triangle list batches don't share vertexes
+    std::size_t vertex_batch_size = get_default_vertex_batch_size();
+    std::vector<Front_end_buffers> front_end_buffers;
+    /** returns the value of the KAZAN_VERTEX_BATCH_SIZE environment variable, rounded down to a
+     * multiple of triangle_vertex_count, if it's set; otherwise returns 96. */
+    static std::size_t get_default_vertex_batch_size() noexcept
+    {
+        constexpr std::size_t default_vertex_batch_size = 96;
+        static_assert(default_vertex_batch_size % triangle_vertex_count == 0, "");
+        if(const char *vertex_batch_size_string = std::getenv("KAZAN_VERTEX_BATCH_SIZE"))
+        {
+            char *end = nullptr;
+            errno = 0;
+            unsigned long long vertex_batch_size =
+                std::strtoull(vertex_batch_size_string, &end, 10);
+            vertex_batch_size -= vertex_batch_size % triangle_vertex_count;
+            if(errno == 0 && end != vertex_batch_size_string && *end == '\0'
+               && vertex_batch_size != 0)
+                return vertex_batch_size;
+        }
+        return default_vertex_batch_size;
+    }
+    static std::size_t get_primitive_vertex_count(VkPrimitiveTopology topology) noexcept
+    {
+        switch(topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return 1;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            return line_vertex_count;
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+            return triangle_vertex_count;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_RANGE_SIZE:
+        case VK_PRIMITIVE_TOPOLOGY_MAX_ENUM:
+            break;
+        }
+        assert(!"unsupported primitive topology");
+        return triangle_vertex_count;
+    }
     std::string append_value_to_string(std::string str,
                                        spirv_to_llvm::Type_descriptor &type,
                                        const void *value) const
@@ -469,21 +633,95 @@ void Graphics_pipeline::dump_vertex_shader_output_struct(const void *output_stru
 
 void Graphics_pipeline::run(std::uint32_t vertex_start_index,
                             std::uint32_t vertex_end_index,
-                            std::uint32_t instance_id,
-                            const vulkan::Vulkan_image &color_attachment,
+                            std::uint32_t instance_start_index,
+                            std::uint32_t instance_end_index,
+                            const Index_buffer *index_buffer,
+                            const vulkan::Vulkan_image *const *color_attachments,
+                            const vulkan::Vulkan_image *depth_attachment,
                             void *const *bindings,
-                            void *uniforms)
+                            void *uniforms,
+                            float dynamic_line_width)
 {
-    typedef std::uint32_t Pixel_type;
-    assert(color_attachment.descriptor.tiling == VK_IMAGE_TILING_LINEAR);
-    auto color_attachment_memory_properties = color_attachment.descriptor.get_memory_properties();
-    auto color_attachment_memory_properties_color_component =
-        color_attachment_memory_properties.get_color_component();
-    std::size_t color_attachment_stride = color_attachment_memory_properties_color_component.stride;
-    std::size_t color_attachment_pixel_size =
-        color_attachment_memory_properties_color_component.pixel_size;
-    assert(color_attachment_memory_properties_color_component.offset_from_array_layer_start == 0);
-    void *color_attachment_memory = color_attachment.memory.get();
+    typedef Implementation::Vec4 Vec4;
+    typedef Implementation::Triangle Triangle;
+    typedef Implementation::Primitive_setup Primitive_setup;
+    typedef Implementation::Front_end_buffers Front_end_buffers;
+    constexpr std::size_t triangle_vertex_count = Implementation::triangle_vertex_count;
+    constexpr std::size_t line_vertex_count = Implementation::line_vertex_count;
+    std::uint32_t sample_count = multisample_state.sample_count;
+    auto *sample_positions = get_standard_sample_positions(sample_count);
+    typedef vulkan::Vulkan_image_descriptor::Image_memory_properties::Subimage Image_subimage;
+    // the start of each sample plane of the color attachments and each attachment's layout;
+    // shade_span uses them to pass the address of each span to the fragment shader. Unused
+    // attachments are null and are never accessed. Multisample attachments have an element for
+    // each sample plane.
+    std::vector<unsigned char *> color_attachment_memory(color_attachment_count * sample_count,
+                                                         nullptr);
+    std::vector<Image_subimage> color_attachment_subimages(color_attachment_count);
+    // the multisample color attachments written by the fragment shader, which keep track of
+    // compressed pixels
+    struct Compressed_color_attachment
+    {
+        const vulkan::Vulkan_image *image;
+        Color_attachment_write_kind write_kind;
+    };
+    std::vector<Compressed_color_attachment> compressed_color_attachments;
+    // the attachments accessed by the draw that can have cleared tiles, which are filled with
+    // the clear value before the back end rasterizes the tile
+    std::vector<const vulkan::Vulkan_image *> lazily_cleared_attachments;
+    // the area that can be rendered to is the intersection of all the attachments
+    VkExtent2D framebuffer_extent = {
+        .width = std::numeric_limits<std::uint32_t>::max(),
+        .height = std::numeric_limits<std::uint32_t>::max(),
+    };
+    for(std::size_t i = 0; i < color_attachment_count; i++)
+    {
+        auto *color_attachment = color_attachments[i];
+        if(!color_attachment)
+            continue;
+        auto color_attachment_memory_properties_color_component =
+            color_attachment->descriptor.get_memory_properties().get_color_component();
+        assert(color_attachment_memory_properties_color_component.offset_from_array_layer_start
+               == 0);
+        assert(color_attachment->descriptor.get_sample_count() == sample_count);
+        for(std::uint32_t sample = 0; sample < sample_count; sample++)
+        {
+            color_attachment_memory[i * sample_count + sample] =
+                static_cast<unsigned char *>(color_attachment->memory.get())
+                + sample * color_attachment_memory_properties_color_component.sample_plane_size;
+        }
+        color_attachment_subimages[i] = color_attachment_memory_properties_color_component;
+        if(color_attachment->sample_compression_masks
+           && color_attachment_write_kinds[i] != Color_attachment_write_kind::Not_written)
+            compressed_color_attachments.push_back(Compressed_color_attachment{
+                .image = color_attachment, .write_kind = color_attachment_write_kinds[i],
+            });
+        if(color_attachment->cleared_tiles
+           && color_attachment_write_kinds[i] != Color_attachment_write_kind::Not_written)
+            lazily_cleared_attachments.push_back(color_attachment);
+        framebuffer_extent.width =
+            std::min(framebuffer_extent.width, color_attachment->descriptor.extent.width);
+        framebuffer_extent.height =
+            std::min(framebuffer_extent.height, color_attachment->descriptor.extent.height);
+    }
+    // depth_attachment_memory is null when the depth test is disabled
+    unsigned char *depth_attachment_memory = nullptr;
+    Image_subimage depth_attachment_subimage;
+    if(depth_state.test_enable && depth_attachment)
+    {
+        assert(depth_attachment->descriptor.get_sample_count() == sample_count);
+        assert(depth_attachment->descriptor.extent.width >= framebuffer_extent.width);
+        assert(depth_attachment->descriptor.extent.height >= framebuffer_extent.height);
+        auto depth_attachment_memory_properties_depth_component =
+            depth_attachment->descriptor.get_memory_properties().get_depth_component();
+        assert(depth_attachment_memory_properties_depth_component.pixel_size == sizeof(float));
+        depth_attachment_memory =
+            static_cast<unsigned char *>(depth_attachment->memory.get())
+            + depth_attachment_memory_properties_depth_component.offset_from_array_layer_start;
+        depth_attachment_subimage = depth_attachment_memory_properties_depth_component;
+        if(depth_attachment->cleared_tiles)
+            lazily_cleared_attachments.push_back(depth_attachment);
+    }
     float viewport_x_scale, viewport_x_offset, viewport_y_scale, viewport_y_offset,
         viewport_z_scale, viewport_z_offset;
     {
@@ -500,48 +738,6 @@ void Graphics_pipeline::run(std::uint32_t vertex_start_index,
         viewport_z_scale = pz;
         viewport_z_offset = oz;
     }
-    constexpr std::size_t vec4_native_alignment = alignof(float) * 4;
-    constexpr std::size_t max_alignment = alignof(std::max_align_t);
-    constexpr std::size_t vec4_alignment =
-        vec4_native_alignment > max_alignment ? max_alignment : vec4_native_alignment;
-    constexpr std::size_t ivec4_native_alignment = alignof(std::int32_t) * 4;
-    constexpr std::size_t ivec4_alignment =
-        ivec4_native_alignment > max_alignment ? max_alignment : ivec4_native_alignment;
-    struct alignas(vec4_alignment) Vec4
-    {
-        float x;
-        float y;
-        float z;
-        float w;
-        constexpr Vec4() noexcept : x(), y(), z(), w()
-        {
-        }
-        constexpr explicit Vec4(float x, float y, float z, float w) noexcept : x(x),
-                                                                               y(y),
-                                                                               z(z),
-                                                                               w(w)
-        {
-        }
-    };
-    struct alignas(ivec4_alignment) Ivec4
-    {
-        std::int32_t x;
-        std::int32_t y;
-        std::int32_t z;
-        std::int32_t w;
-        constexpr Ivec4() noexcept : x(), y(), z(), w()
-        {
-        }
-        constexpr explicit Ivec4(std::int32_t x,
-                                 std::int32_t y,
-                                 std::int32_t z,
-                                 std::int32_t w) noexcept : x(x),
-                                                            y(y),
-                                                            z(z),
-                                                            w(w)
-        {
-        }
-    };
     auto interpolate_float = [](float t, float v0, float v1) noexcept->float
     {
         return t * v1 + (1.0f - t) * v0;
@@ -554,18 +750,6 @@ void Graphics_pipeline::run(std::uint32_t vertex_start_index,
                     interpolate_float(t, v0.z, v1.z),
                     interpolate_float(t, v0.w, v1.w));
     };
-    static constexpr std::size_t triangle_vertex_count = 3;
-    struct Triangle
-    {
-        Vec4 vertexes[triangle_vertex_count];
-        constexpr Triangle() noexcept : vertexes{}
-        {
-        }
-        constexpr Triangle(const Vec4 &v0, const Vec4 &v1, const Vec4 &v2) noexcept
-            : vertexes{v0, v1, v2}
-        {
-        }
-    };
     auto solve_for_t = [](float v0, float v1) noexcept->float
     {
         // solves interpolate_float(t, v0, v1) == 0
@@ -654,296 +838,1753 @@ void Graphics_pipeline::run(std::uint32_t vertex_start_index,
             case 2:
                 continue;
             case 3:
-                temp_triangles.push_back(
-                    Triangle(output_vertexes[0], output_vertexes[1], output_vertexes[2]));
+                temp_triangles.push_back(Triangle(output_vertexes[0],
+                                                  output_vertexes[1],
+                                                  output_vertexes[2],
+                                                  input.primitive_index));
                 continue;
             case 4:
-                temp_triangles.push_back(
-                    Triangle(output_vertexes[0], output_vertexes[1], output_vertexes[2]));
-                temp_triangles.push_back(
-                    Triangle(output_vertexes[0], output_vertexes[2], output_vertexes[3]));
+                temp_triangles.push_back(Triangle(output_vertexes[0],
+                                                  output_vertexes[1],
+                                                  output_vertexes[2],
+                                                  input.primitive_index));
+                temp_triangles.push_back(Triangle(output_vertexes[0],
+                                                  output_vertexes[2],
+                                                  output_vertexes[3],
+                                                  input.primitive_index));
                 continue;
             }
             assert(!"clipping algorithm failed");
         }
         temp_triangles.swap(triangles);
     };
-    std::vector<Triangle> triangles;
-    std::vector<Triangle> temp_triangles;
-    constexpr std::size_t chunk_max_size = 96;
-    static_assert(chunk_max_size % triangle_vertex_count == 0, "");
-    std::unique_ptr<unsigned char[]> chunk_vertex_buffer(
-        new unsigned char[get_vertex_shader_output_struct_size() * chunk_max_size]);
-    while(vertex_start_index < vertex_end_index)
+    VkOffset2D clipped_scissor_rect_min = scissor_rect.offset;
+    VkOffset2D clipped_scissor_rect_end = {
+        .x = scissor_rect.offset.x + static_cast<std::int32_t>(scissor_rect.extent.width),
+        .y = scissor_rect.offset.y + static_cast<std::int32_t>(scissor_rect.extent.height),
+    };
+    if(clipped_scissor_rect_min.x < 0)
+        clipped_scissor_rect_min.x = 0;
+    if(clipped_scissor_rect_min.y < 0)
+        clipped_scissor_rect_min.y = 0;
+    if(clipped_scissor_rect_end.x > framebuffer_extent.width)
+        clipped_scissor_rect_end.x = framebuffer_extent.width;
+    if(clipped_scissor_rect_end.y > framebuffer_extent.height)
+        clipped_scissor_rect_end.y = framebuffer_extent.height;
+    if(clipped_scissor_rect_end.x <= clipped_scissor_rect_min.x)
+        return;
+    if(clipped_scissor_rect_end.y <= clipped_scissor_rect_min.y)
+        return;
+    if(!multisample_state.sample_mask)
+        return;
+    typedef Edge_equation::Integer_type Edge_equation_integer_type;
+    // vertexes are snapped to 1 / scale pixels, and the edge equations' a and b are the
+    // differences of the snapped coordinates times scale. When the viewport is at most
+    // max_narrow_viewport_size pixels in each direction, vertexes are snapped to
+    // narrow_log2_scale bits, so the edges of the triangles that fit in the viewport can be
+    // narrowed to 32 bits in the back end; otherwise, they get wide_log2_scale bits and are always
+    // stepped in 64 bits.
+    constexpr int narrow_log2_scale = 8;
+    constexpr int wide_log2_scale = 16;
+    constexpr float max_narrow_viewport_size = 2048;
+    static_assert(max_narrow_viewport_size * (1LL << (2 * narrow_log2_scale))
+                      <= max_narrow_edge_coefficient,
+                  "");
+    bool use_narrow_scale = std::fabs(viewport_x_scale) * 2 <= max_narrow_viewport_size
+                            && std::fabs(viewport_y_scale) * 2 <= max_narrow_viewport_size;
+    int log2_scale = use_narrow_scale ? narrow_log2_scale : wide_log2_scale;
+    // the guard band is the range of framebuffer coordinates that the fixed-point edge equations
+    // can handle without overflowing: a, b and c have at most 2 * (log2_guard_band_size +
+    // log2_scale) + 2 bits. Triangles only need to be clipped against the sides of the guard
+    // band instead of the sides of the viewport, since the rasterizer never visits pixels
+    // outside of the scissor rectangle anyway.
+    constexpr int max_log2_guard_band_size_plus_scale = 30;
+    static_assert(2 * max_log2_guard_band_size_plus_scale + 2 < 64,
+                  "edge equations can overflow inside the guard band");
+    static_assert(1ULL << (max_log2_guard_band_size_plus_scale
+                           - vulkan::Vulkan_physical_device::sub_pixel_precision_bits)
+                      >= vulkan::Vulkan_physical_device::max_framebuffer_size,
+                  "the guard band can't contain the largest framebuffer");
+    int log2_guard_band_size = max_log2_guard_band_size_plus_scale - log2_scale;
+    // the guard band has to contain the scissor rectangle, so large framebuffers trade subpixel
+    // precision for a larger guard band
+    while(clipped_scissor_rect_end.x > 1LL << log2_guard_band_size
+          || clipped_scissor_rect_end.y > 1LL << log2_guard_band_size)
+    {
+        log2_guard_band_size++;
+        log2_scale--;
+    }
+    assert(log2_scale
+           >= static_cast<int>(vulkan::Vulkan_physical_device::sub_pixel_precision_bits));
+    const Edge_equation_integer_type scale = 1LL << log2_scale;
+    // rounds to the nearest 1 / scale pixel
+    auto snap_to_subpixel = [&](float value) noexcept->Edge_equation_integer_type
+    {
+        return std::llrint(value * static_cast<float>(scale));
+    };
+    const float guard_band_size = static_cast<float>(1LL << log2_guard_band_size);
+    // the far edges of the scissor rectangle are inside the guard band, so they are rasterized
+    assert(clipped_scissor_rect_end.x <= guard_band_size
+           && clipped_scissor_rect_end.y <= guard_band_size);
+    // the guard band in normalized device coordinates
+    float guard_band_x_min = (-guard_band_size - viewport_x_offset) / viewport_x_scale;
+    float guard_band_x_max = (guard_band_size - viewport_x_offset) / viewport_x_scale;
+    float guard_band_y_min = (-guard_band_size - viewport_y_offset) / viewport_y_scale;
+    float guard_band_y_max = (guard_band_size - viewport_y_offset) / viewport_y_scale;
+    if(guard_band_x_min > guard_band_x_max)
+        std::swap(guard_band_x_min, guard_band_x_max);
+    if(guard_band_y_min > guard_band_y_max)
+        std::swap(guard_band_y_min, guard_band_y_max);
+    static_assert(triangle_edge_count == triangle_vertex_count, "");
+    // tiled binning: the front end (vertex shading, clipping and triangle setup) sorts triangles
+    // into fixed-size screen tiles, then the back end rasterizes one tile at a time so the
+    // tile's part of the color attachment stays in the cache while it is shaded.
+    // 64x64 pixels at 4 bytes per pixel is 16kB, which fits in L1/L2 on everything we target.
+    constexpr std::int32_t log2_tile_size = 6;
+    constexpr std::int32_t tile_size = 1 << log2_tile_size;
+    static_assert(tile_size % block_size == 0, "");
+    std::int32_t tile_count_x = (clipped_scissor_rect_end.x + tile_size - 1) >> log2_tile_size;
+    std::int32_t tile_count_y = (clipped_scissor_rect_end.y + tile_size - 1) >> log2_tile_size;
+    std::size_t tile_count = static_cast<std::size_t>(tile_count_x) * tile_count_y;
+    auto bin_primitive = [&](Front_end_buffers &buffers, const Primitive_setup &primitive_setup)
+    {
+        auto &tile_bins = buffers.tile_bins;
+        auto primitive_setup_index = static_cast<std::uint32_t>(buffers.primitive_setups.size());
+        buffers.primitive_setups.push_back(primitive_setup);
+        std::int32_t min_tile_x = primitive_setup.min_x >> log2_tile_size;
+        std::int32_t end_tile_x = ((primitive_setup.end_x - 1) >> log2_tile_size) + 1;
+        std::int32_t min_tile_y = primitive_setup.min_y >> log2_tile_size;
+        std::int32_t end_tile_y = ((primitive_setup.end_y - 1) >> log2_tile_size) + 1;
+        for(std::int32_t tile_y = min_tile_y; tile_y < end_tile_y; tile_y++)
+            for(std::int32_t tile_x = min_tile_x; tile_x < end_tile_x; tile_x++)
+                tile_bins[tile_x + tile_y * tile_count_x].push_back(primitive_setup_index);
+    };
+    auto get_vertex = [&](const Front_end_buffers &buffers,
+                          std::uint32_t vertex_buffer_index) noexcept->const unsigned char *
+    {
+        return buffers.vertex_buffer.data()
+               + vertex_buffer_index * vertex_shader_output_struct_size;
+    };
+    auto get_vertex_position = [&](const unsigned char *vertex) noexcept->Vec4
+    {
+        return *reinterpret_cast<const Vec4 *>(vertex + vertex_shader_position_output_offset);
+    };
+    // the fragment shader inputs are interpolated using planes solved from the unclipped
+    // triangle in homogeneous coordinates (Olano and Greer), so clipping doesn't need to
+    // interpolate the vertex shader outputs and perspective correction only needs 1/w per pixel.
+    // varying_planes holds one plane per input component for each primitive, in the order of
+    // fragment_inputs.
+    // positions has the clip coordinates of the primitive's vertex_count vertexes; for lines, the
+    // third position is a direction (with w == 0) perpendicular to the line in framebuffer
+    // coordinates, so the inputs are constant across the width of the line. Flat inputs are
+    // copied from provoking_vertex.
+    auto setup_varying_planes = [&](std::vector<Plane_equation> &varying_planes,
+                                    Primitive_setup &primitive_setup,
+                                    const Vec4 *positions,
+                                    const unsigned char *const *vertexes,
+                                    std::size_t vertex_count,
+                                    const unsigned char *provoking_vertex) -> bool
     {
-        std::uint32_t chunk_size = vertex_end_index - vertex_start_index;
-        if(chunk_size > chunk_max_size)
-            chunk_size = chunk_max_size;
-        auto current_vertex_start_index = vertex_start_index;
-        vertex_start_index += chunk_size;
-        run_vertex_shader(current_vertex_start_index,
-                          current_vertex_start_index + chunk_size,
-                          instance_id,
-                          chunk_vertex_buffer.get(),
-                          bindings,
-                          uniforms);
-        const unsigned char *current_vertex =
-            chunk_vertex_buffer.get() + vertex_shader_position_output_offset;
-        triangles.clear();
-        for(std::uint32_t i = 0; i + triangle_vertex_count <= chunk_size;
-            i += triangle_vertex_count)
+        double m[3][triangle_vertex_count]; // each column is (x, y, w) of a vertex
+        for(std::size_t i = 0; i < triangle_vertex_count; i++)
+        {
+            m[0][i] = positions[i].x;
+            m[1][i] = positions[i].y;
+            m[2][i] = positions[i].w;
+        }
+        double cofactors[3][3];
+        for(std::size_t row = 0; row < 3; row++)
         {
-            Triangle triangle;
-            for(std::size_t j = 0; j < triangle_vertex_count; j++)
+            for(std::size_t column = 0; column < 3; column++)
             {
-                triangle.vertexes[j] = *reinterpret_cast<const Vec4 *>(current_vertex);
-                current_vertex += vertex_shader_output_struct_size;
+                std::size_t row1 = (row + 1) % 3, row2 = (row + 2) % 3;
+                std::size_t column1 = (column + 1) % 3, column2 = (column + 2) % 3;
+                cofactors[row][column] =
+                    m[row1][column1] * m[row2][column2] - m[row1][column2] * m[row2][column1];
             }
-            triangles.push_back(triangle);
         }
-        // clip to 0 <= vertex.z
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.z;
-                       });
-        // clip to vertex.z <= vertex.w
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.w - vertex.z;
-                       });
-        // clip to -vertex.w <= vertex.x
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.x + vertex.w;
-                       });
-        // clip to vertex.x <= vertex.w
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.w - vertex.x;
-                       });
-        // clip to -vertex.w <= vertex.y
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.y + vertex.w;
-                       });
-        // clip to vertex.y <= vertex.w
-        clip_triangles(triangles,
-                       temp_triangles,
-                       [](const Vec4 &vertex) noexcept->float
-                       {
-                           return vertex.w - vertex.y;
-                       });
-        VkOffset2D clipped_scissor_rect_min = scissor_rect.offset;
-        VkOffset2D clipped_scissor_rect_end = {
-            .x = scissor_rect.offset.x + static_cast<std::int32_t>(scissor_rect.extent.width),
-            .y = scissor_rect.offset.y + static_cast<std::int32_t>(scissor_rect.extent.height),
+        double determinant =
+            m[0][0] * cofactors[0][0] + m[0][1] * cofactors[0][1] + m[0][2] * cofactors[0][2];
+        if(!(determinant < 0) && !(determinant > 0))
+            return false;
+        // k[i] is the i-th vertex's weight divided by w at a pixel; k = inverse(m) * (x, y, 1) in
+        // normalized device coordinates, converted here to use framebuffer pixel coordinates
+        struct Double_plane
+        {
+            double a;
+            double b;
+            double c;
         };
-        if(clipped_scissor_rect_min.x < 0)
-            clipped_scissor_rect_min.x = 0;
-        if(clipped_scissor_rect_min.y < 0)
-            clipped_scissor_rect_min.y = 0;
-        if(clipped_scissor_rect_end.x > color_attachment.descriptor.extent.width)
-            clipped_scissor_rect_end.x = color_attachment.descriptor.extent.width;
-        if(clipped_scissor_rect_end.y < color_attachment.descriptor.extent.height)
-            clipped_scissor_rect_end.y = color_attachment.descriptor.extent.height;
-        if(clipped_scissor_rect_end.x <= clipped_scissor_rect_min.x)
-            continue;
-        if(clipped_scissor_rect_end.y <= clipped_scissor_rect_min.y)
-            continue;
-        for(std::size_t triangle_index = 0; triangle_index < triangles.size(); triangle_index++)
+        Double_plane k[triangle_vertex_count];
+        double x_scale = 1.0 / viewport_x_scale;
+        double y_scale = 1.0 / viewport_y_scale;
+        double x_offset = (0.5 - viewport_x_offset) * x_scale;
+        double y_offset = (0.5 - viewport_y_offset) * y_scale;
+        for(std::size_t i = 0; i < triangle_vertex_count; i++)
+        {
+            double a = cofactors[0][i] / determinant;
+            double b = cofactors[1][i] / determinant;
+            double c = cofactors[2][i] / determinant;
+            k[i] = {
+                .a = a * x_scale, .b = b * y_scale, .c = c + a * x_offset + b * y_offset,
+            };
+        }
+        // a line's direction isn't a vertex, so it doesn't contribute to 1/w or the inputs
+        Double_plane inverse_w_plane = {
+            .a = 0, .b = 0, .c = 0,
+        };
+        for(std::size_t i = 0; i < vertex_count; i++)
         {
-            Triangle triangle = triangles[triangle_index];
-            Vec4 projected_triangle_and_inv_w[triangle_vertex_count];
-            Vec4 framebuffer_coordinates[triangle_vertex_count];
-            for(std::size_t i = 0; i < triangle_vertex_count; i++)
+            inverse_w_plane.a += k[i].a;
+            inverse_w_plane.b += k[i].b;
+            inverse_w_plane.c += k[i].c;
+        }
+        primitive_setup.inverse_w_plane =
+            Plane_equation(inverse_w_plane.a, inverse_w_plane.b, inverse_w_plane.c);
+        primitive_setup.varying_plane_start = varying_planes.size();
+        for(auto &fragment_input : fragment_inputs)
+        {
+            for(std::size_t component = 0; component < fragment_input.component_count;
+                component++)
             {
-                projected_triangle_and_inv_w[i].w = 1.0f / triangle.vertexes[i].w;
-                projected_triangle_and_inv_w[i].x =
-                    triangle.vertexes[i].x * projected_triangle_and_inv_w[i].w;
-                projected_triangle_and_inv_w[i].y =
-                    triangle.vertexes[i].y * projected_triangle_and_inv_w[i].w;
-                projected_triangle_and_inv_w[i].z =
-                    triangle.vertexes[i].z * projected_triangle_and_inv_w[i].w;
-                framebuffer_coordinates[i] =
-                    Vec4(projected_triangle_and_inv_w[i].x * viewport_x_scale + viewport_x_offset,
-                         projected_triangle_and_inv_w[i].y * viewport_y_scale + viewport_y_offset,
-                         projected_triangle_and_inv_w[i].z * viewport_z_scale + viewport_z_offset,
-                         0);
+                std::size_t offset =
+                    fragment_input.vertex_shader_output_offset + component * sizeof(float);
+                if(fragment_input.interpolation_kind == Interpolation_kind::Flat)
+                {
+                    // copy the bits unchanged
+                    Plane_equation plane(0, 0, 0);
+                    std::memcpy(&plane.c, provoking_vertex + offset, sizeof(float));
+                    varying_planes.push_back(plane);
+                    continue;
+                }
+                Double_plane plane = {
+                    .a = 0, .b = 0, .c = 0,
+                };
+                for(std::size_t i = 0; i < vertex_count; i++)
+                {
+                    float value_float;
+                    std::memcpy(&value_float, vertexes[i] + offset, sizeof(float));
+                    double value = value_float;
+                    if(fragment_input.interpolation_kind == Interpolation_kind::Linear)
+                        value *= m[2][i];
+                    plane.a += value * k[i].a;
+                    plane.b += value * k[i].b;
+                    plane.c += value * k[i].c;
+                }
+                varying_planes.push_back(Plane_equation(plane.a, plane.b, plane.c));
             }
-            float orientation = 0;
-            for(std::size_t start_vertex_index = 0, end_vertex_index = 1;
-                start_vertex_index < triangle_vertex_count;
-                start_vertex_index++)
+        }
+        return true;
+    };
+    // sets up the varying planes of the triangle with primitive_index in the current vertex batch
+    auto setup_triangle_varying_planes = [&](Front_end_buffers &buffers,
+                                             Primitive_setup &primitive_setup,
+                                             std::uint32_t primitive_index) -> bool
+    {
+        const unsigned char *primitive_vertexes[triangle_vertex_count];
+        Vec4 primitive_positions[triangle_vertex_count];
+        for(std::size_t j = 0; j < triangle_vertex_count; j++)
+        {
+            primitive_vertexes[j] = get_vertex(
+                buffers,
+                buffers.primitive_vertex_buffer_indexes[primitive_index * triangle_vertex_count
+                                                        + j]);
+            primitive_positions[j] = get_vertex_position(primitive_vertexes[j]);
+        }
+        return setup_varying_planes(buffers.varying_planes,
+                                    primitive_setup,
+                                    primitive_positions,
+                                    primitive_vertexes,
+                                    triangle_vertex_count,
+                                    primitive_vertexes[0]);
+    };
+    auto is_face_culled = [&](bool is_counter_clockwise) noexcept->bool
+    {
+        bool is_front_face = is_counter_clockwise
+                             == (rasterization_state.front_face == VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        return rasterization_state.cull_mode
+               & (is_front_face ? VK_CULL_MODE_FRONT_BIT : VK_CULL_MODE_BACK_BIT);
+    };
+    // primitive setup: rejects back faces, zero-area triangles, and triangles with NaN coordinates
+    // before clipping. The orientation is the sign of the determinant of the clip coordinates'
+    // x, y, and w, which is only valid before the perspective divide when all the w are
+    // positive; other triangles are checked again after clipping.
+    auto is_culled_before_clipping = [&](const Triangle &triangle) noexcept->bool
+    {
+        auto &v0 = triangle.vertexes[0];
+        auto &v1 = triangle.vertexes[1];
+        auto &v2 = triangle.vertexes[2];
+        float determinant = v0.x * (v1.y * v2.w - v2.y * v1.w)
+                            - v1.x * (v0.y * v2.w - v2.y * v0.w)
+                            + v2.x * (v0.y * v1.w - v1.y * v0.w);
+        if(determinant != determinant)
+            return true; // triangle coordinate is NaN
+        if(!(v0.w > 0 && v1.w > 0 && v2.w > 0))
+            return false;
+        if(determinant == 0)
+            return true;
+        // the viewport transform flips the orientation when it mirrors the triangle
+        bool is_counter_clockwise = (determinant < 0) == (viewport_x_scale * viewport_y_scale > 0);
+        return is_face_culled(is_counter_clockwise);
+    };
+    // outcodes have a bit set for each plane that a vertex is on the outside of
+    constexpr std::uint32_t outcode_near = 1 << 0;
+    constexpr std::uint32_t outcode_far = 1 << 1;
+    constexpr std::uint32_t outcode_left = 1 << 2;
+    constexpr std::uint32_t outcode_right = 1 << 3;
+    constexpr std::uint32_t outcode_top = 1 << 4;
+    constexpr std::uint32_t outcode_bottom = 1 << 5;
+    // returns the outcodes for the planes of the view volume
+    auto get_view_volume_outcodes = [](const Vec4 &vertex) noexcept->std::uint32_t
+    {
+        std::uint32_t retval = 0;
+        if(vertex.z < 0)
+            retval |= outcode_near;
+        if(vertex.z > vertex.w)
+            retval |= outcode_far;
+        if(vertex.x < -vertex.w)
+            retval |= outcode_left;
+        if(vertex.x > vertex.w)
+            retval |= outcode_right;
+        if(vertex.y < -vertex.w)
+            retval |= outcode_top;
+        if(vertex.y > vertex.w)
+            retval |= outcode_bottom;
+        return retval;
+    };
+    // returns the outcodes for the planes that need geometric clipping: the near and far planes
+    // and the sides of the guard band
+    auto get_clip_outcodes = [&](const Vec4 &vertex) noexcept->std::uint32_t
+    {
+        std::uint32_t retval = 0;
+        if(vertex.z < 0)
+            retval |= outcode_near;
+        if(vertex.z > vertex.w)
+            retval |= outcode_far;
+        if(vertex.x < guard_band_x_min * vertex.w)
+            retval |= outcode_left;
+        if(vertex.x > guard_band_x_max * vertex.w)
+            retval |= outcode_right;
+        if(vertex.y < guard_band_y_min * vertex.w)
+            retval |= outcode_top;
+        if(vertex.y > guard_band_y_max * vertex.w)
+            retval |= outcode_bottom;
+        return retval;
+    };
+    // the planes tested by get_clip_outcodes, in the order of the outcode bits; a vertex is
+    // inside a plane when the dot product of the plane and the vertex is non-negative
+    const Vec4 clip_planes[] = {
+        Vec4(0, 0, 1, 0),
+        Vec4(0, 0, -1, 1),
+        Vec4(1, 0, 0, -guard_band_x_min),
+        Vec4(-1, 0, 0, guard_band_x_max),
+        Vec4(0, 1, 0, -guard_band_y_min),
+        Vec4(0, -1, 0, guard_band_y_max),
+    };
+    auto get_plane_distance = [](const Vec4 &plane, const Vec4 &vertex) noexcept->float
+    {
+        return plane.x * vertex.x + plane.y * vertex.y + plane.z * vertex.z + plane.w * vertex.w;
+    };
+    float line_width = rasterization_state.dynamic_line_width ? dynamic_line_width :
+                                                                rasterization_state.line_width;
+    if(!(line_width >= 1))
+        line_width = 1;
+    else if(line_width > max_line_width)
+        line_width = max_line_width;
+    // points are squares with no edges, so the rasterizer fills every tile and block of a point
+    // without any edge tests. The fragment shader inputs are the same for the whole point.
+#warning implement PointCoord
+    auto setup_point = [&](Front_end_buffers &buffers, std::uint32_t vertex_buffer_index)
+    {
+        auto *vertex = get_vertex(buffers, vertex_buffer_index);
+        auto position = get_vertex_position(vertex);
+        // points outside of the view volume are discarded instead of clipped; written so that
+        // points with NaN coordinates are outside
+        if(!(position.w > 0 && position.x >= -position.w && position.x <= position.w
+             && position.y >= -position.w
+             && position.y <= position.w
+             && position.z >= 0
+             && position.z <= position.w))
+            return;
+        float point_size = 1;
+        if(vertex_shader_point_size_output_offset)
+            std::memcpy(
+                &point_size, vertex + *vertex_shader_point_size_output_offset, sizeof(float));
+        if(!(point_size >= 1))
+            point_size = 1;
+        else if(point_size > max_point_size)
+            point_size = max_point_size;
+        float inverse_w = 1.0f / position.w;
+        float x = position.x * inverse_w * viewport_x_scale + viewport_x_offset;
+        float y = position.y * inverse_w * viewport_y_scale + viewport_y_offset;
+        float z = position.z * inverse_w * viewport_z_scale + viewport_z_offset;
+        // the pixels with their centers in [x - point_size / 2, x + point_size / 2) by
+        // [y - point_size / 2, y + point_size / 2)
+        float half_size = point_size * 0.5f;
+        auto min_x = static_cast<std::int32_t>(std::ceil(x - half_size - 0.5f));
+        auto end_x = static_cast<std::int32_t>(std::ceil(x + half_size - 0.5f));
+        auto min_y = static_cast<std::int32_t>(std::ceil(y - half_size - 0.5f));
+        auto end_y = static_cast<std::int32_t>(std::ceil(y + half_size - 0.5f));
+        if(min_x < clipped_scissor_rect_min.x)
+            min_x = clipped_scissor_rect_min.x;
+        if(end_x > clipped_scissor_rect_end.x)
+            end_x = clipped_scissor_rect_end.x;
+        if(min_y < clipped_scissor_rect_min.y)
+            min_y = clipped_scissor_rect_min.y;
+        if(end_y > clipped_scissor_rect_end.y)
+            end_y = clipped_scissor_rect_end.y;
+        if(min_x >= end_x || min_y >= end_y)
+            return;
+        Primitive_setup primitive_setup;
+        // the default edge equation is 0 everywhere, so every pixel is inside it
+        for(auto &edge_equation : primitive_setup.edge_equations)
+            edge_equation = Edge_equation();
+        primitive_setup.depth_plane = Plane_equation(0, 0, z);
+        if(!fragment_inputs.empty())
+        {
+            // w is 1, so perspective correction doesn't change the inputs
+            primitive_setup.inverse_w_plane = Plane_equation(0, 0, 1);
+            primitive_setup.varying_plane_start = buffers.varying_planes.size();
+            for(auto &fragment_input : fragment_inputs)
             {
-                float x1 = framebuffer_coordinates[start_vertex_index].x;
-                float y1 = framebuffer_coordinates[start_vertex_index].y;
-                float x2 = framebuffer_coordinates[end_vertex_index].x;
-                float y2 = framebuffer_coordinates[end_vertex_index].y;
-                orientation += x2 * y1 - x1 * y2;
-                if(++end_vertex_index >= triangle_vertex_count)
-                    end_vertex_index = 0;
+                for(std::size_t component = 0; component < fragment_input.component_count;
+                    component++)
+                {
+                    // copy the bits unchanged, so flat integer inputs work too
+                    Plane_equation plane(0, 0, 0);
+                    std::memcpy(&plane.c,
+                                vertex + fragment_input.vertex_shader_output_offset
+                                    + component * sizeof(float),
+                                sizeof(float));
+                    buffers.varying_planes.push_back(plane);
+                }
             }
-            if(!(orientation < 0)
-               && !(orientation > 0)) // zero area triangle or triangle coordinate is NaN
-                continue;
-            // orientation > 0 for counter-clockwise triangle
-            // orientation < 0 for clockwise triangle
-            std::int32_t min_x, end_x, min_y, end_y;
-            bool first = true;
-            for(std::size_t i = 0; i < triangle_vertex_count; i++)
+        }
+        primitive_setup.min_x = min_x;
+        primitive_setup.end_x = end_x;
+        primitive_setup.min_y = min_y;
+        primitive_setup.end_y = end_y;
+        primitive_setup.is_small = false;
+        bin_primitive(buffers, primitive_setup);
+    };
+    // lines are quads: two edge equations for the sides, line_width apart along the minor axis,
+    // and the bounding box's sides for the ends, so lines go through the same rasterizer as
+    // triangles with the third edge equation left always inside. Lines of width 1 use the
+    // diamond-exit rule to decide which pixels at the ends are covered, which leaves exactly one
+    // pixel per column (or per row for y-major lines); wider lines are parallelograms covering
+    // the pixels with their centers between the ends (non-strict lines).
+#warning test the ends of lines at each sample when multisampling
+    auto setup_line = [&](Front_end_buffers &buffers,
+                          std::uint32_t start_vertex_buffer_index,
+                          std::uint32_t end_vertex_buffer_index,
+                          std::uint32_t provoking_vertex_buffer_index)
+    {
+        const unsigned char *vertexes[line_vertex_count] = {
+            get_vertex(buffers, start_vertex_buffer_index),
+            get_vertex(buffers, end_vertex_buffer_index),
+        };
+        Vec4 clip_coordinates[line_vertex_count];
+        std::uint32_t view_volume_outcodes_and = -1;
+        std::uint32_t clip_outcodes_or = 0;
+        for(std::size_t i = 0; i < line_vertex_count; i++)
+        {
+            clip_coordinates[i] = get_vertex_position(vertexes[i]);
+            view_volume_outcodes_and &= get_view_volume_outcodes(clip_coordinates[i]);
+            clip_outcodes_or |= get_clip_outcodes(clip_coordinates[i]);
+        }
+        if(view_volume_outcodes_and != 0)
+            return; // both vertexes are outside the same plane: trivial reject
+        // clip by shrinking the range of the line's parameter that's inside every plane
+        float start_t = 0;
+        float end_t = 1;
+        for(std::uint32_t outcodes = clip_outcodes_or; outcodes; outcodes &= outcodes - 1)
+        {
+            auto &plane = clip_planes[util::ctz32(outcodes)];
+            float start_distance = get_plane_distance(plane, clip_coordinates[0]);
+            float end_distance = get_plane_distance(plane, clip_coordinates[1]);
+            if(start_distance < 0 && end_distance < 0)
+                return;
+            if(start_distance < 0)
+                start_t = std::max(start_t, solve_for_t(start_distance, end_distance));
+            else if(end_distance < 0)
+                end_t = std::min(end_t, solve_for_t(start_distance, end_distance));
+        }
+        if(!(start_t < end_t))
+            return;
+        Vec4 framebuffer_coordinates[line_vertex_count];
+        for(std::size_t i = 0; i < line_vertex_count; i++)
+        {
+            auto clipped = interpolate_vec4(
+                i == 0 ? start_t : end_t, clip_coordinates[0], clip_coordinates[1]);
+            float inverse_w = 1.0f / clipped.w;
+            framebuffer_coordinates[i] =
+                Vec4(clipped.x * inverse_w * viewport_x_scale + viewport_x_offset,
+                     clipped.y * inverse_w * viewport_y_scale + viewport_y_offset,
+                     clipped.z * inverse_w * viewport_z_scale + viewport_z_offset,
+                     0);
+        }
+        float x0 = framebuffer_coordinates[0].x;
+        float y0 = framebuffer_coordinates[0].y;
+        float x1 = framebuffer_coordinates[1].x;
+        float y1 = framebuffer_coordinates[1].y;
+        float dx = x1 - x0;
+        float dy = y1 - y0;
+        if(!(dx * dx + dy * dy > 0)) // zero length line or line coordinate is NaN
+            return;
+        bool is_x_major = std::fabs(dx) >= std::fabs(dy);
+        float half_width = line_width * 0.5f;
+        // the offset from the line to its sides
+        float offset_x = is_x_major ? 0 : half_width;
+        float offset_y = is_x_major ? half_width : 0;
+        Primitive_setup primitive_setup;
+        {
+            // the first side goes from start - offset to end - offset and the second side goes
+            // back from end + offset to start + offset, so the inside of both sides has the
+            // same sign
+            bool negate = dx * offset_y - dy * offset_x < 0;
+            for(std::size_t side = 0; side < 2; side++)
             {
-                // x and y will be >= 0 so we can use truncate instead of floor for speed
-                auto current_min_x = static_cast<std::int32_t>(framebuffer_coordinates[i].x);
-                auto current_min_y = static_cast<std::int32_t>(framebuffer_coordinates[i].y);
-                std::int32_t current_end_x = current_min_x + 1;
-                std::int32_t current_end_y = current_min_y + 1;
-                if(first || current_min_x < min_x)
-                    min_x = current_min_x;
-                if(first || current_end_x > end_x)
-                    end_x = current_end_x;
-                if(first || current_min_y < min_y)
-                    min_y = current_min_y;
-                if(first || current_end_y > end_y)
-                    end_y = current_end_y;
-                first = false;
+                float sign = side == 0 ? -1 : 1;
+                const Vec4 &side_start = framebuffer_coordinates[side];
+                const Vec4 &side_end = framebuffer_coordinates[1 - side];
+                auto x1_fixed = snap_to_subpixel(side_start.x + sign * offset_x);
+                auto y1_fixed = snap_to_subpixel(side_start.y + sign * offset_y);
+                auto x2_fixed = snap_to_subpixel(side_end.x + sign * offset_x);
+                auto y2_fixed = snap_to_subpixel(side_end.y + sign * offset_y);
+                Edge_equation_integer_type a = (y1_fixed - y2_fixed) * scale;
+                Edge_equation_integer_type b = (x2_fixed - x1_fixed) * scale;
+                Edge_equation_integer_type c = x1_fixed * y2_fixed - x2_fixed * y1_fixed;
+                // offset to end up checking at pixel center instead of top-left pixel corner
+                c += (a + b) / 2;
+                if(negate)
+                {
+                    a = -a;
+                    b = -b;
+                    c = -c;
+                }
+                // top-left fill rule; the sides are parallel, so pixel centers exactly on a
+                // side are only inside one of them
+                if(a < 0 || (a == 0 && b < 0))
+                    c--;
+                primitive_setup.edge_equations[side] = Edge_equation(a, b, c);
             }
-            if(min_x < clipped_scissor_rect_min.x)
-                min_x = clipped_scissor_rect_min.x;
-            if(end_x > clipped_scissor_rect_end.x)
-                end_x = clipped_scissor_rect_end.x;
-            if(min_y < clipped_scissor_rect_min.y)
-                min_y = clipped_scissor_rect_min.y;
-            if(end_y > clipped_scissor_rect_end.y)
-                end_y = clipped_scissor_rect_end.y;
-            constexpr int log2_scale = 16;
-            constexpr auto scale = 1LL << log2_scale;
-            typedef std::int64_t Edge_equation_integer_type;
-            struct Edge_equation
+            static_assert(triangle_edge_count == 3, "");
+            // the default edge equation is 0 everywhere, so every pixel is inside it
+            primitive_setup.edge_equations[2] = Edge_equation();
+        }
+        // u is along the major axis and v is along the minor axis
+        float u0 = is_x_major ? x0 : y0;
+        float v0 = is_x_major ? y0 : x0;
+        float u1 = is_x_major ? x1 : y1;
+        float v1 = is_x_major ? y1 : x1;
+        float du = u1 - u0;
+        float dv = v1 - v0;
+        std::int32_t min_u, end_u;
+        if(line_width == 1)
+        {
+            // diamond-exit rule: a pixel is covered when the line exits the diamond
+            // |u - center_u| + |v - center_v| < 0.5 inside the pixel. The sides already pick
+            // the pixel in each column whose diamond the line passes through, so only the
+            // pixels at the ends need to be tested.
+            auto exits_diamond = [&](float pixel_u) noexcept->bool
             {
-                Edge_equation_integer_type a;
-                Edge_equation_integer_type b;
-                Edge_equation_integer_type c;
-                Edge_equation_integer_type padding;
-                constexpr Edge_equation() noexcept : a(), b(), c(), padding()
+                float center_u = pixel_u + 0.5f;
+                float center_v = std::floor(v0 + (center_u - u0) * dv / du) + 0.5f;
+                auto get_distance = [&](float t) noexcept->float
                 {
+                    return std::fabs(u0 + t * du - center_u) + std::fabs(v0 + t * dv - center_v);
+                };
+                if(get_distance(1) < 0.5f)
+                    return false; // the line ends inside the diamond
+                // the distance is piecewise linear along the line, so its minimum is at an end
+                // or where the line crosses the center's row or column
+                float min_distance = std::min(get_distance(0), get_distance(1));
+                float t = (center_u - u0) / du;
+                if(t > 0 && t < 1)
+                    min_distance = std::min(min_distance, get_distance(t));
+                if(dv != 0)
+                {
+                    t = (center_v - v0) / dv;
+                    if(t > 0 && t < 1)
+                        min_distance = std::min(min_distance, get_distance(t));
                 }
-                constexpr Edge_equation(Edge_equation_integer_type a,
-                                        Edge_equation_integer_type b,
-                                        Edge_equation_integer_type c) noexcept : a(a),
-                                                                                 b(b),
-                                                                                 c(c),
-                                                                                 padding()
+                return min_distance < 0.5f;
+            };
+            float step = du > 0 ? 1 : -1;
+            float first_pixel_u = std::floor(u0);
+            float last_pixel_u = std::floor(u1);
+            if(first_pixel_u == last_pixel_u)
+            {
+                if(!exits_diamond(first_pixel_u))
+                    return;
+            }
+            else
+            {
+                if(!exits_diamond(first_pixel_u))
+                    first_pixel_u += step;
+                if(!exits_diamond(last_pixel_u))
+                    last_pixel_u -= step;
+                if((last_pixel_u - first_pixel_u) * step < 0)
+                    return;
+            }
+            min_u = static_cast<std::int32_t>(std::min(first_pixel_u, last_pixel_u));
+            end_u = static_cast<std::int32_t>(std::max(first_pixel_u, last_pixel_u)) + 1;
+        }
+        else
+        {
+            // the pixels with their centers between the ends
+            min_u = static_cast<std::int32_t>(std::ceil(std::min(u0, u1) - 0.5f));
+            end_u = static_cast<std::int32_t>(std::ceil(std::max(u0, u1) - 0.5f));
+        }
+        auto min_v = static_cast<std::int32_t>(std::floor(std::min(v0, v1) - half_width));
+        auto end_v = static_cast<std::int32_t>(std::floor(std::max(v0, v1) + half_width)) + 1;
+        std::int32_t min_x = is_x_major ? min_u : min_v;
+        std::int32_t end_x = is_x_major ? end_u : end_v;
+        std::int32_t min_y = is_x_major ? min_v : min_u;
+        std::int32_t end_y = is_x_major ? end_v : end_u;
+        if(min_x < clipped_scissor_rect_min.x)
+            min_x = clipped_scissor_rect_min.x;
+        if(end_x > clipped_scissor_rect_end.x)
+            end_x = clipped_scissor_rect_end.x;
+        if(min_y < clipped_scissor_rect_min.y)
+            min_y = clipped_scissor_rect_min.y;
+        if(end_y > clipped_scissor_rect_end.y)
+            end_y = clipped_scissor_rect_end.y;
+        if(min_x >= end_x || min_y >= end_y)
+            return;
+        // the depth and the inputs are constant across the line, so they're the values at the
+        // nearest point on the line
+        primitive_setup.depth_plane = Plane_equation::solve(x0,
+                                                            y0,
+                                                            framebuffer_coordinates[0].z,
+                                                            x1,
+                                                            y1,
+                                                            framebuffer_coordinates[1].z,
+                                                            x0 - dy,
+                                                            y0 + dx,
+                                                            framebuffer_coordinates[0].z);
+        if(!fragment_inputs.empty())
+        {
+            // the line through the unclipped vertexes in homogeneous framebuffer coordinates is
+            // their cross product, and its first two components are perpendicular to the line
+            float homogeneous_x[line_vertex_count];
+            float homogeneous_y[line_vertex_count];
+            for(std::size_t i = 0; i < line_vertex_count; i++)
+            {
+                homogeneous_x[i] = clip_coordinates[i].x * viewport_x_scale
+                                   + clip_coordinates[i].w * viewport_x_offset;
+                homogeneous_y[i] = clip_coordinates[i].y * viewport_y_scale
+                                   + clip_coordinates[i].w * viewport_y_offset;
+            }
+            float perpendicular_x = homogeneous_y[0] * clip_coordinates[1].w
+                                    - clip_coordinates[0].w * homogeneous_y[1];
+            float perpendicular_y = clip_coordinates[0].w * homogeneous_x[1]
+                                    - homogeneous_x[0] * clip_coordinates[1].w;
+            const Vec4 positions[triangle_vertex_count] = {
+                clip_coordinates[0],
+                clip_coordinates[1],
+                Vec4(perpendicular_x / viewport_x_scale, perpendicular_y / viewport_y_scale, 0, 0),
+            };
+            if(!setup_varying_planes(buffers.varying_planes,
+                                     primitive_setup,
+                                     positions,
+                                     vertexes,
+                                     line_vertex_count,
+                                     get_vertex(buffers, provoking_vertex_buffer_index)))
+                return;
+        }
+        primitive_setup.min_x = min_x;
+        primitive_setup.end_x = end_x;
+        primitive_setup.min_y = min_y;
+        primitive_setup.end_y = end_y;
+        primitive_setup.is_small = false;
+        bin_primitive(buffers, primitive_setup);
+    };
+    // the front end is split into one partition of consecutive vertex batches per worker thread.
+    // Each partition bins into its own tile bins, and the back end visits the partitions' bins
+    // in partition order, so triangles are still rasterized in submission order.
+    std::size_t vertex_batch_size = implementation->vertex_batch_size;
+    assert(vertex_batch_size % triangle_vertex_count == 0);
+    std::size_t vertex_count =
+        vertex_end_index > vertex_start_index ? vertex_end_index - vertex_start_index : 0;
+    std::size_t instance_count =
+        instance_end_index > instance_start_index ? instance_end_index - instance_start_index : 0;
+    // each instance group is split into the same vertex batches. Instances that fit in half a
+    // vertex batch are grouped, so several instances are shaded by each vertex shader call;
+    // otherwise, each group is a single instance.
+    std::size_t instance_vertex_batch_count =
+        (vertex_count + vertex_batch_size - 1) / vertex_batch_size;
+    std::size_t instance_group_size = 1;
+    if(instance_vertex_batch_count == 1)
+        instance_group_size = vertex_batch_size / vertex_count;
+    std::size_t instance_group_count =
+        (instance_count + instance_group_size - 1) / instance_group_size;
+    std::size_t vertex_batch_count = instance_group_count * instance_vertex_batch_count;
+    std::size_t partition_count =
+        std::min(worker_thread_pool.get_thread_count(), vertex_batch_count);
+    std::size_t primitive_vertex_count =
+        Implementation::get_primitive_vertex_count(input_assembly_state.topology);
+    // a batch also shades the vertexes of the previous batch used by the primitives that cross
+    // into it, and the triangle fan's center
+    std::size_t max_batch_vertex_count = vertex_batch_size + primitive_vertex_count;
+    auto &front_end_buffers = implementation->front_end_buffers;
+    if(front_end_buffers.size() < partition_count)
+        front_end_buffers.resize(partition_count);
+    for(std::size_t partition_index = 0; partition_index < partition_count; partition_index++)
+    {
+        auto &buffers = front_end_buffers[partition_index];
+        buffers.vertex_buffer.resize(vertex_shader_output_struct_size * max_batch_vertex_count);
+        buffers.vertex_buffer_indexes.resize(max_batch_vertex_count);
+        buffers.vertex_indexes.reserve(max_batch_vertex_count);
+        buffers.primitive_restarts.reserve(max_batch_vertex_count);
+        buffers.unique_vertex_indexes.reserve(max_batch_vertex_count);
+        buffers.primitive_vertex_buffer_indexes.reserve(vertex_batch_size * triangle_vertex_count);
+        buffers.primitive_setups.clear();
+        buffers.varying_planes.clear();
+        buffers.tile_bins.resize(tile_count);
+        for(auto &tile_bin : buffers.tile_bins)
+            tile_bin.clear();
+    }
+    bool uses_primitive_restart = index_buffer && input_assembly_state.primitive_restart_enable;
+    std::uint32_t primitive_restart_index = 0;
+    auto with_indexes = [&](auto fn)
+    {
+        switch(index_buffer->index_type)
+        {
+        case VK_INDEX_TYPE_UINT16:
+            fn(static_cast<const std::uint16_t *>(index_buffer->indexes));
+            return;
+        case VK_INDEX_TYPE_UINT32:
+            fn(static_cast<const std::uint32_t *>(index_buffer->indexes));
+            return;
+        case VK_INDEX_TYPE_RANGE_SIZE:
+        case VK_INDEX_TYPE_MAX_ENUM:
+            break;
+        }
+        assert(!"invalid index type");
+    };
+    if(uses_primitive_restart)
+        primitive_restart_index =
+            index_buffer->index_type == VK_INDEX_TYPE_UINT16 ? 0xFFFFU : 0xFFFFFFFFUL;
+    // returns the first index of the restart-delimited part of the draw (the segment) that
+    // index_index is in
+    auto find_segment_start_index = [&](std::uint32_t index_index) -> std::uint32_t
+    {
+        if(!uses_primitive_restart)
+            return vertex_start_index;
+        with_indexes([&](const auto *indexes)
+                     {
+                         while(index_index > vertex_start_index
+                               && indexes[index_index - 1] != primitive_restart_index)
+                             index_index--;
+                     });
+        return index_index;
+    };
+    // runs the vertex shader for a vertex batch, then assembles the primitives that end in the
+    // batch for each of the batch's instances, filling buffers.primitive_vertex_buffer_indexes.
+    // segment_start_index is the first index of the current segment, and is updated for the
+    // primitive restarts in the batch. A batch with more than one instance has all of the draw's
+    // vertexes.
+    // The batch's vertexes are the ones from first_index to batch_end_index, including the last
+    // vertexes of the previous batch needed by primitives that cross into this batch, followed
+    // by the triangle fan's center if it's before first_index. For indexed draws, the batch's
+    // vertex indexes are deduplicated, then each run of consecutive vertex indexes is shaded
+    // with one vertex shader call, so the vertex shader outputs are reused for repeated indexes.
+    auto assemble_vertex_batch = [&](Front_end_buffers &buffers,
+                                     std::uint32_t batch_start_index,
+                                     std::uint32_t batch_end_index,
+                                     std::uint32_t batch_instance_start_index,
+                                     std::uint32_t batch_instance_end_index,
+                                     std::uint32_t &segment_start_index)
+    {
+        std::uint32_t batch_instance_count = batch_instance_end_index - batch_instance_start_index;
+        // list primitives only overlap the previous batch when it ends partway through one of
+        // them; strips and fans overlap it by all but one vertex of a primitive
+        std::uint32_t overlap_vertex_count;
+        switch(input_assembly_state.topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+            overlap_vertex_count =
+                (batch_start_index - segment_start_index) % primitive_vertex_count;
+            break;
+        default:
+            overlap_vertex_count = std::min<std::uint32_t>(batch_start_index - vertex_start_index,
+                                                           primitive_vertex_count - 1);
+            break;
+        }
+        std::uint32_t first_index = batch_start_index - overlap_vertex_count;
+        std::uint32_t batch_vertex_count = batch_end_index - first_index;
+        bool has_separate_fan_center =
+            input_assembly_state.topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN
+            && segment_start_index < first_index;
+        auto &vertex_buffer_indexes = buffers.vertex_buffer_indexes;
+        auto &vertex_indexes = buffers.vertex_indexes;
+        auto &primitive_restarts = buffers.primitive_restarts;
+        if(!index_buffer)
+        {
+            run_vertex_shader(first_index,
+                              batch_end_index,
+                              batch_instance_start_index,
+                              batch_instance_end_index,
+                              buffers.vertex_buffer.data(),
+                              bindings,
+                              uniforms);
+            if(has_separate_fan_center)
+                run_vertex_shader(segment_start_index,
+                                  segment_start_index + 1,
+                                  batch_instance_start_index,
+                                  batch_instance_end_index,
+                                  buffers.vertex_buffer.data()
+                                      + batch_vertex_count * vertex_shader_output_struct_size,
+                                  bindings,
+                                  uniforms);
+            for(std::uint32_t i = 0; i < batch_vertex_count + has_separate_fan_center; i++)
+                vertex_buffer_indexes[i] = i;
+        }
+        else
+        {
+            vertex_indexes.clear();
+            primitive_restarts.clear();
+            with_indexes([&](const auto *indexes)
+                         {
+                             auto add_index = [&](std::uint32_t index_index)
+                             {
+                                 primitive_restarts.push_back(
+                                     uses_primitive_restart
+                                     && indexes[index_index] == primitive_restart_index);
+                                 vertex_indexes.push_back(
+                                     static_cast<std::uint32_t>(indexes[index_index])
+                                     + index_buffer->vertex_offset);
+                             };
+                             for(std::uint32_t i = first_index; i < batch_end_index; i++)
+                                 add_index(i);
+                             if(has_separate_fan_center)
+                                 add_index(segment_start_index);
+                         });
+            // primitive restart indexes aren't shaded
+            auto &unique_vertex_indexes = buffers.unique_vertex_indexes;
+            unique_vertex_indexes.clear();
+            for(std::size_t i = 0; i < vertex_indexes.size(); i++)
+                if(!primitive_restarts[i])
+                    unique_vertex_indexes.push_back(vertex_indexes[i]);
+            std::sort(unique_vertex_indexes.begin(), unique_vertex_indexes.end());
+            unique_vertex_indexes.erase(
+                std::unique(unique_vertex_indexes.begin(), unique_vertex_indexes.end()),
+                unique_vertex_indexes.end());
+            for(std::size_t i = 0; i < vertex_indexes.size(); i++)
+                vertex_buffer_indexes[i] =
+                    primitive_restarts[i] ? 0 : std::lower_bound(unique_vertex_indexes.begin(),
+                                                                 unique_vertex_indexes.end(),
+                                                                 vertex_indexes[i])
+                                                    - unique_vertex_indexes.begin();
+            for(std::size_t run_start = 0, run_end = 0; run_start < unique_vertex_indexes.size();
+                run_start = run_end)
+            {
+                run_end = run_start + 1;
+                while(run_end < unique_vertex_indexes.size()
+                      && unique_vertex_indexes[run_end] == unique_vertex_indexes[run_end - 1] + 1)
+                    run_end++;
+                // the end is 64 bits so a run can end with vertex index 0xFFFFFFFF
+                std::uint64_t run_vertex_end_index = unique_vertex_indexes[run_end - 1];
+                run_vertex_end_index++;
+                run_vertex_shader(unique_vertex_indexes[run_start],
+                                  run_vertex_end_index,
+                                  batch_instance_start_index,
+                                  batch_instance_end_index,
+                                  buffers.vertex_buffer.data()
+                                      + run_start * batch_instance_count
+                                            * vertex_shader_output_struct_size,
+                                  bindings,
+                                  uniforms);
+            }
+        }
+        auto &primitive_vertex_buffer_indexes = buffers.primitive_vertex_buffer_indexes;
+        primitive_vertex_buffer_indexes.clear();
+        std::uint32_t instance = 0;
+        auto add_vertex = [&](std::uint32_t index_index)
+        {
+            primitive_vertex_buffer_indexes.push_back(
+                vertex_buffer_indexes[index_index >= first_index ? index_index - first_index :
+                                                                   batch_vertex_count]
+                    * batch_instance_count
+                + instance);
+        };
+        for(; instance < batch_instance_count; instance++)
+        {
+            if(instance != 0)
+            {
+                assert(batch_start_index == vertex_start_index);
+                segment_start_index = vertex_start_index;
+            }
+            for(std::uint32_t i = batch_start_index; i < batch_end_index; i++)
+            {
+                if(uses_primitive_restart && primitive_restarts[i - first_index])
                 {
+                    segment_start_index = i + 1;
+                    continue;
                 }
-                constexpr bool inside(std::int32_t x, std::int32_t y) const noexcept
+                std::uint32_t segment_vertex_count = i - segment_start_index + 1;
+                switch(input_assembly_state.topology)
                 {
-                    return a * x + b * y + c >= 0;
+                case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+                    add_vertex(i);
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+                    if(segment_vertex_count % 2 != 0)
+                        break;
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+                    if(segment_vertex_count < 2)
+                        break;
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+                    if(segment_vertex_count % 3 != 0)
+                        break;
+                    add_vertex(i - 2);
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+                    if(segment_vertex_count < 3)
+                        break;
+                    // odd triangles swap their last two vertexes to keep the same orientation
+                    add_vertex(i - 2);
+                    if(segment_vertex_count % 2 != 0)
+                    {
+                        add_vertex(i - 1);
+                        add_vertex(i);
+                    }
+                    else
+                    {
+                        add_vertex(i);
+                        add_vertex(i - 1);
+                    }
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+                    if(segment_vertex_count < 3)
+                        break;
+                    add_vertex(i - 1);
+                    add_vertex(i);
+                    add_vertex(segment_start_index);
+                    break;
+                case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+                case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+                case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY:
+                case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY:
+                case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+                case VK_PRIMITIVE_TOPOLOGY_RANGE_SIZE:
+                case VK_PRIMITIVE_TOPOLOGY_MAX_ENUM:
+                    assert(!"unsupported primitive topology");
+                    break;
                 }
-            };
-            Edge_equation edge_equations[triangle_vertex_count];
-            bool skip_triangle = false;
-            for(std::size_t start_vertex_index = 0, end_vertex_index = 1, other_vertex_index = 2;
-                start_vertex_index < triangle_vertex_count;
-                start_vertex_index++)
+            }
+        }
+    };
+    auto &small_triangle_coverage_kernel = Small_triangle_coverage_kernel::get();
+    auto run_front_end = [&](std::size_t partition_index, std::size_t)
+    {
+        auto &buffers = front_end_buffers[partition_index];
+        // consecutive small triangles wait here until there are enough of them to fill a batch for
+        // the small triangle coverage kernel; the varying planes are only set up for the ones
+        // that cover a sample
+        Small_triangle_batch small_triangle_batch;
+        Primitive_setup small_triangle_setups[small_triangle_batch_size];
+        std::uint32_t small_triangle_primitive_indexes[small_triangle_batch_size];
+        std::size_t small_triangle_count = 0;
+        auto flush_small_triangles = [&]()
+        {
+            Small_triangle_coverage_mask coverage_masks[small_triangle_batch_size];
+            small_triangle_coverage_kernel.function(small_triangle_batch,
+                                                    small_triangle_count,
+                                                    sample_positions,
+                                                    multisample_state.sample_mask,
+                                                    coverage_masks);
+            for(std::size_t i = 0; i < small_triangle_count; i++)
+            {
+                auto &primitive_setup = small_triangle_setups[i];
+                // small_triangle_coverage_mask has the pixels inside the scissor rectangle
+                primitive_setup.small_triangle_coverage_mask &= coverage_masks[i];
+                if(!primitive_setup.small_triangle_coverage_mask)
+                    continue;
+                if(!fragment_inputs.empty()
+                   && !setup_triangle_varying_planes(
+                          buffers, primitive_setup, small_triangle_primitive_indexes[i]))
+                    continue;
+                bin_primitive(buffers, primitive_setup);
+            }
+            small_triangle_count = 0;
+        };
+        std::size_t start_batch_index = partition_index * vertex_batch_count / partition_count;
+        std::size_t end_batch_index = (partition_index + 1) * vertex_batch_count / partition_count;
+        std::uint32_t segment_start_index = vertex_start_index;
+        for(std::size_t batch_index = start_batch_index; batch_index < end_batch_index;
+            batch_index++)
+        {
+            std::size_t instance_group_index = batch_index / instance_vertex_batch_count;
+            std::size_t instance_batch_index = batch_index % instance_vertex_batch_count;
+            std::uint32_t batch_instance_start_index =
+                instance_start_index + instance_group_index * instance_group_size;
+            std::uint32_t batch_instance_end_index = instance_end_index;
+            if(instance_end_index - batch_instance_start_index > instance_group_size)
+                batch_instance_end_index = batch_instance_start_index + instance_group_size;
+            std::uint32_t batch_start_index =
+                vertex_start_index + instance_batch_index * vertex_batch_size;
+            std::uint32_t batch_size = vertex_end_index - batch_start_index;
+            if(batch_size > vertex_batch_size)
+                batch_size = vertex_batch_size;
+            // each instance starts a new segment
+            if(batch_index == start_batch_index || instance_batch_index == 0)
+                segment_start_index = find_segment_start_index(batch_start_index);
+            assemble_vertex_batch(buffers,
+                                  batch_start_index,
+                                  batch_start_index + batch_size,
+                                  batch_instance_start_index,
+                                  batch_instance_end_index,
+                                  segment_start_index);
+            auto &primitive_vertex_buffer_indexes = buffers.primitive_vertex_buffer_indexes;
+            if(primitive_vertex_count == 1)
             {
-                float x1_float = framebuffer_coordinates[start_vertex_index].x;
-                float y1_float = framebuffer_coordinates[start_vertex_index].y;
-                float x2_float = framebuffer_coordinates[end_vertex_index].x;
-                float y2_float = framebuffer_coordinates[end_vertex_index].y;
-                [[gnu::unused]] float x3_float = framebuffer_coordinates[other_vertex_index].x;
-                [[gnu::unused]] float y3_float = framebuffer_coordinates[other_vertex_index].y;
-                auto x1_fixed = static_cast<Edge_equation_integer_type>(x1_float * scale);
-                auto y1_fixed = static_cast<Edge_equation_integer_type>(y1_float * scale);
-                auto x2_fixed = static_cast<Edge_equation_integer_type>(x2_float * scale);
-                auto y2_fixed = static_cast<Edge_equation_integer_type>(y2_float * scale);
-                [[gnu::unused]] auto x3_fixed =
-                    static_cast<Edge_equation_integer_type>(x3_float * scale);
-                [[gnu::unused]] auto y3_fixed =
-                    static_cast<Edge_equation_integer_type>(y3_float * scale);
-                Edge_equation_integer_type a;
-                Edge_equation_integer_type b;
-                Edge_equation_integer_type c;
+                for(auto vertex_buffer_index : primitive_vertex_buffer_indexes)
+                    setup_point(buffers, vertex_buffer_index);
+                continue;
+            }
+            if(primitive_vertex_count == line_vertex_count)
+            {
+                // the first vertex is the provoking vertex
+                for(std::size_t i = 0; i < primitive_vertex_buffer_indexes.size();
+                    i += line_vertex_count)
+                    setup_line(buffers,
+                               primitive_vertex_buffer_indexes[i],
+                               primitive_vertex_buffer_indexes[i + 1],
+                               primitive_vertex_buffer_indexes[i]);
+                continue;
+            }
+            buffers.triangles.clear();
+            buffers.triangles_to_clip.clear();
+            std::uint32_t batch_clip_outcodes = 0;
+            for(std::size_t i = 0; i < primitive_vertex_buffer_indexes.size();
+                i += triangle_vertex_count)
+            {
+                Triangle triangle;
+                triangle.primitive_index = i / triangle_vertex_count;
+                for(std::size_t j = 0; j < triangle_vertex_count; j++)
+                    triangle.vertexes[j] = *reinterpret_cast<const Vec4 *>(
+                        buffers.vertex_buffer.data() + vertex_shader_position_output_offset
+                        + primitive_vertex_buffer_indexes[i + j]
+                              * vertex_shader_output_struct_size);
+                if(is_culled_before_clipping(triangle))
+                    continue;
+                if(rasterization_state.polygon_mode != VK_POLYGON_MODE_FILL)
                 {
-                    // solve a * x1 + b * y1 + c == 0 &&
-                    // a * x2 + b * y2 + c == 0 &&
-                    // a * x3 + b * y3 + c >= 0
-                    if(x1_fixed == x2_fixed && y1_fixed == y2_fixed)
+#warning cull triangles that cross w = 0 in the line and point polygon modes
+                    // draw the triangle's edges or vertexes with the line or point rasterizer
+                    auto *vertex_buffer_indexes = &primitive_vertex_buffer_indexes[i];
+                    for(std::size_t j = 0; j < triangle_vertex_count; j++)
                     {
-                        // rounded to a zero-area triangle
-                        skip_triangle = true;
-                        break;
+                        if(rasterization_state.polygon_mode == VK_POLYGON_MODE_POINT)
+                            setup_point(buffers, vertex_buffer_indexes[j]);
+                        else
+                            setup_line(buffers,
+                                       vertex_buffer_indexes[j],
+                                       vertex_buffer_indexes[(j + 1) % triangle_vertex_count],
+                                       vertex_buffer_indexes[0]);
                     }
-                    Edge_equation_integer_type a_fixed = (y1_fixed - y2_fixed) * scale;
-                    Edge_equation_integer_type b_fixed = (x2_fixed - x1_fixed) * scale;
-                    Edge_equation_integer_type c_fixed =
-                        (x1_fixed * y2_fixed - x2_fixed * y1_fixed);
+                    continue;
+                }
+                std::uint32_t view_volume_outcodes_and = -1;
+                std::uint32_t clip_outcodes_or = 0;
+                for(auto &vertex : triangle.vertexes)
+                {
+                    view_volume_outcodes_and &= get_view_volume_outcodes(vertex);
+                    clip_outcodes_or |= get_clip_outcodes(vertex);
+                }
+                if(view_volume_outcodes_and != 0)
+                    continue; // all the vertexes are outside the same plane: trivial reject
+                if(clip_outcodes_or == 0)
+                    buffers.triangles.push_back(triangle); // trivial accept
+                else
+                    buffers.triangles_to_clip.push_back(triangle);
+                batch_clip_outcodes |= clip_outcodes_or;
+            }
+            // only run the clipping passes for planes that some triangle crosses
+            if(batch_clip_outcodes & outcode_near)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [](const Vec4 &vertex) noexcept->float
+                               {
+                                   return vertex.z;
+                               });
+            if(batch_clip_outcodes & outcode_far)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [](const Vec4 &vertex) noexcept->float
+                               {
+                                   return vertex.w - vertex.z;
+                               });
+            if(batch_clip_outcodes & outcode_left)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [&](const Vec4 &vertex) noexcept->float
+                               {
+                                   return vertex.x - guard_band_x_min * vertex.w;
+                               });
+            if(batch_clip_outcodes & outcode_right)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [&](const Vec4 &vertex) noexcept->float
+                               {
+                                   return guard_band_x_max * vertex.w - vertex.x;
+                               });
+            if(batch_clip_outcodes & outcode_top)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [&](const Vec4 &vertex) noexcept->float
+                               {
+                                   return vertex.y - guard_band_y_min * vertex.w;
+                               });
+            if(batch_clip_outcodes & outcode_bottom)
+                clip_triangles(buffers.triangles_to_clip,
+                               buffers.temp_triangles,
+                               [&](const Vec4 &vertex) noexcept->float
+                               {
+                                   return guard_band_y_max * vertex.w - vertex.y;
+                               });
+            buffers.triangles.insert(buffers.triangles.end(),
+                                     buffers.triangles_to_clip.begin(),
+                                     buffers.triangles_to_clip.end());
+            for(auto &triangle_ref : buffers.triangles)
+            {
+                Triangle triangle = triangle_ref; // copy to enable compiler optimizations
+                Vec4 projected_triangle_and_inv_w[triangle_vertex_count];
+                Vec4 framebuffer_coordinates[triangle_vertex_count];
+                for(std::size_t i = 0; i < triangle_vertex_count; i++)
+                {
+                    projected_triangle_and_inv_w[i].w = 1.0f / triangle.vertexes[i].w;
+                    projected_triangle_and_inv_w[i].x =
+                        triangle.vertexes[i].x * projected_triangle_and_inv_w[i].w;
+                    projected_triangle_and_inv_w[i].y =
+                        triangle.vertexes[i].y * projected_triangle_and_inv_w[i].w;
+                    projected_triangle_and_inv_w[i].z =
+                        triangle.vertexes[i].z * projected_triangle_and_inv_w[i].w;
+                    auto &projected = projected_triangle_and_inv_w[i];
+                    framebuffer_coordinates[i] =
+                        Vec4(projected.x * viewport_x_scale + viewport_x_offset,
+                             projected.y * viewport_y_scale + viewport_y_offset,
+                             projected.z * viewport_z_scale + viewport_z_offset,
+                             0);
+                }
+                float orientation = 0;
+                for(std::size_t start_vertex_index = 0, end_vertex_index = 1;
+                    start_vertex_index < triangle_vertex_count;
+                    start_vertex_index++)
+                {
+                    float x1 = framebuffer_coordinates[start_vertex_index].x;
+                    float y1 = framebuffer_coordinates[start_vertex_index].y;
+                    float x2 = framebuffer_coordinates[end_vertex_index].x;
+                    float y2 = framebuffer_coordinates[end_vertex_index].y;
+                    orientation += x2 * y1 - x1 * y2;
+                    if(++end_vertex_index >= triangle_vertex_count)
+                        end_vertex_index = 0;
+                }
+                if(!(orientation < 0)
+                   && !(orientation > 0)) // zero area triangle or triangle coordinate is NaN
+                    continue;
+                // orientation > 0 for counter-clockwise triangle
+                // orientation < 0 for clockwise triangle
+                // this catches the buffers.triangles that couldn't be culled before clipping
+                if(is_face_culled(orientation > 0))
+                    continue;
+                std::int32_t min_x, end_x, min_y, end_y;
+                bool first = true;
+                for(std::size_t i = 0; i < triangle_vertex_count; i++)
+                {
+                    // x and y can be negative inside the guard band; truncating instead of
+                    // flooring only changes the minimum when it's negative, where it's clamped
+                    // to the scissor anyway, and can only grow the end by a pixel, which the
+                    // edge tests handle
+                    auto current_min_x = static_cast<std::int32_t>(framebuffer_coordinates[i].x);
+                    auto current_min_y = static_cast<std::int32_t>(framebuffer_coordinates[i].y);
+                    std::int32_t current_end_x = current_min_x + 1;
+                    std::int32_t current_end_y = current_min_y + 1;
+                    if(first || current_min_x < min_x)
+                        min_x = current_min_x;
+                    if(first || current_end_x > end_x)
+                        end_x = current_end_x;
+                    if(first || current_min_y < min_y)
+                        min_y = current_min_y;
+                    if(first || current_end_y > end_y)
+                        end_y = current_end_y;
+                    first = false;
+                }
+                // checked before clamping to the scissor rectangle, so the edge equations of small
+                // triangles have small a and b
+                bool is_small =
+                    end_x - min_x <= small_triangle_size && end_y - min_y <= small_triangle_size;
+                if(min_x < clipped_scissor_rect_min.x)
+                    min_x = clipped_scissor_rect_min.x;
+                if(end_x > clipped_scissor_rect_end.x)
+                    end_x = clipped_scissor_rect_end.x;
+                if(min_y < clipped_scissor_rect_min.y)
+                    min_y = clipped_scissor_rect_min.y;
+                if(end_y > clipped_scissor_rect_end.y)
+                    end_y = clipped_scissor_rect_end.y;
+                if(min_x >= end_x || min_y >= end_y)
+                    continue;
+                Primitive_setup primitive_setup;
+                bool skip_triangle = false;
+                for(std::size_t start_vertex_index = 0,
+                                end_vertex_index = 1,
+                                other_vertex_index = 2;
+                    start_vertex_index < triangle_vertex_count;
+                    start_vertex_index++)
+                {
+                    float x1_float = framebuffer_coordinates[start_vertex_index].x;
+                    float y1_float = framebuffer_coordinates[start_vertex_index].y;
+                    float x2_float = framebuffer_coordinates[end_vertex_index].x;
+                    float y2_float = framebuffer_coordinates[end_vertex_index].y;
+                    [[gnu::unused]] float x3_float = framebuffer_coordinates[other_vertex_index].x;
+                    [[gnu::unused]] float y3_float = framebuffer_coordinates[other_vertex_index].y;
+                    auto x1_fixed = snap_to_subpixel(x1_float);
+                    auto y1_fixed = snap_to_subpixel(y1_float);
+                    auto x2_fixed = snap_to_subpixel(x2_float);
+                    auto y2_fixed = snap_to_subpixel(y2_float);
+                    [[gnu::unused]] auto x3_fixed = snap_to_subpixel(x3_float);
+                    [[gnu::unused]] auto y3_fixed = snap_to_subpixel(y3_float);
+                    Edge_equation_integer_type a;
+                    Edge_equation_integer_type b;
+                    Edge_equation_integer_type c;
+                    {
+                        // solve a * x1 + b * y1 + c == 0 &&
+                        // a * x2 + b * y2 + c == 0 &&
+                        // a * x3 + b * y3 + c >= 0
+                        if(x1_fixed == x2_fixed && y1_fixed == y2_fixed)
+                        {
+                            // rounded to a zero-area triangle
+                            skip_triangle = true;
+                            break;
+                        }
+                        Edge_equation_integer_type a_fixed = (y1_fixed - y2_fixed) * scale;
+                        Edge_equation_integer_type b_fixed = (x2_fixed - x1_fixed) * scale;
+                        Edge_equation_integer_type c_fixed =
+                            (x1_fixed * y2_fixed - x2_fixed * y1_fixed);
 
-                    // offset to end up checking at pixel center instead of top-left pixel corner
-                    c_fixed += (a_fixed + b_fixed) / 2;
+                        // offset to end up checking at pixel center instead of top-left pixel
+                        // corner
+                        c_fixed += (a_fixed + b_fixed) / 2;
 
-                    a = a_fixed;
-                    b = b_fixed;
-                    c = c_fixed;
-                    if(orientation > 0)
+                        a = a_fixed;
+                        b = b_fixed;
+                        c = c_fixed;
+                        if(orientation > 0)
+                        {
+                            // fix sign
+                            a = -a;
+                            b = -b;
+                            c = -c;
+                        }
+                    }
+                    // handle top-left fill rule
+                    if(a < 0 || (a == 0 && b < 0))
                     {
-                        // fix sign
-                        a = -a;
-                        b = -b;
-                        c = -c;
+                        // not a top-left edge, fixup c
+                        // effectively changes the '>=' to '>' in Edge_equation::inside
+                        c--;
                     }
+
+                    primitive_setup.edge_equations[start_vertex_index] = Edge_equation(a, b, c);
+                    if(++end_vertex_index >= triangle_vertex_count)
+                        end_vertex_index = 0;
+                    if(++other_vertex_index >= triangle_vertex_count)
+                        other_vertex_index = 0;
                 }
-                // handle top-left fill rule
-                if(a < 0 || (a == 0 && b < 0))
+                if(skip_triangle)
+                    continue;
+                // framebuffer z is linear in screen space, so it doesn't need perspective
+                // correction
+                primitive_setup.depth_plane = Plane_equation::solve(framebuffer_coordinates[0].x,
+                                                                    framebuffer_coordinates[0].y,
+                                                                    framebuffer_coordinates[0].z,
+                                                                    framebuffer_coordinates[1].x,
+                                                                    framebuffer_coordinates[1].y,
+                                                                    framebuffer_coordinates[1].z,
+                                                                    framebuffer_coordinates[2].x,
+                                                                    framebuffer_coordinates[2].y,
+                                                                    framebuffer_coordinates[2].z);
+                primitive_setup.min_x = min_x;
+                primitive_setup.end_x = end_x;
+                primitive_setup.min_y = min_y;
+                primitive_setup.end_y = end_y;
+                primitive_setup.is_small = is_small;
+                if(is_small)
                 {
-                    // not a top-left edge, fixup c
-                    // effectively changes the '>=' to '>' in Edge_equation::inside
-                    c--;
+                    // the triangle's origin is (min_x, min_y), so the kernel only needs to test
+                    // the pixels at (0, 0) through (1, 1)
+                    auto index = small_triangle_count;
+                    for(std::size_t i = 0; i < triangle_edge_count; i++)
+                    {
+                        auto &edge_equation = primitive_setup.edge_equations[i];
+                        small_triangle_batch.a[i][index] = edge_equation.a;
+                        small_triangle_batch.b[i][index] = edge_equation.b;
+                        small_triangle_batch.c[i][index] = edge_equation.evaluate(min_x, min_y);
+                    }
+                    Small_triangle_coverage_mask rectangle_mask = 0;
+                    for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                        for(std::int32_t y = 0; y < end_y - min_y; y++)
+                            for(std::int32_t x = 0; x < end_x - min_x; x++)
+                                rectangle_mask |= 1UL
+                                                  << get_small_triangle_coverage_bit(x, y, sample);
+                    primitive_setup.small_triangle_coverage_mask = rectangle_mask;
+                    small_triangle_setups[index] = primitive_setup;
+                    small_triangle_primitive_indexes[index] = triangle.primitive_index;
+                    if(++small_triangle_count >= small_triangle_batch_size)
+                        flush_small_triangles();
+                    continue;
                 }
-
-                edge_equations[start_vertex_index] = Edge_equation(a, b, c);
-                if(++end_vertex_index >= triangle_vertex_count)
-                    end_vertex_index = 0;
-                if(++other_vertex_index >= triangle_vertex_count)
-                    other_vertex_index = 0;
+                // keeps the triangles in submission order in the tile bins
+                if(small_triangle_count)
+                    flush_small_triangles();
+                if(!fragment_inputs.empty()
+                   && !setup_triangle_varying_planes(
+                          buffers, primitive_setup, triangle.primitive_index))
+                    continue;
+                bin_primitive(buffers, primitive_setup);
             }
-            if(skip_triangle)
-                continue;
-            auto fs = this->fragment_shader_function;
-            for(std::int32_t y = min_y; y < end_y; y++)
+            if(small_triangle_count)
+                flush_small_triangles();
+        }
+    };
+    worker_thread_pool.run_parallel(partition_count, run_front_end);
+    // back end: tiles don't overlap, so each one is rasterized by a single worker thread in the
+    // order its triangles were binned, making the output independent of the thread count
+    std::vector<std::uint32_t> binned_tile_indexes;
+    for(std::size_t tile_index = 0; tile_index < tile_count; tile_index++)
+    {
+        for(std::size_t partition_index = 0; partition_index < partition_count; partition_index++)
+        {
+            if(!front_end_buffers[partition_index].tile_bins[tile_index].empty())
+            {
+                binned_tile_indexes.push_back(tile_index);
+                break;
+            }
+        }
+    }
+    auto fs = this->fragment_shader_function;
+    auto &block_coverage_kernel = Block_coverage_kernel::get();
+    auto &narrow_block_coverage_kernel = Narrow_block_coverage_kernel::get();
+    // the fragment shader shades one row of a block per call
+    constexpr std::int32_t lane_count = fragment_shader_lane_count;
+    static_assert(lane_count == block_size, "");
+    constexpr std::uint32_t all_lanes_mask = (1ULL << lane_count) - 1;
+    // each worker thread gets its own buffer of interpolated fragment shader inputs
+    constexpr std::size_t location_component_count = 4;
+    std::size_t fragment_input_buffer_size =
+        fragment_input_location_count * location_component_count * lane_count;
+    std::vector<float> fragment_input_buffers(fragment_input_buffer_size
+                                              * worker_thread_pool.get_thread_count());
+    // and its own array of the addresses of the current span in the color attachments
+    std::size_t color_attachment_pixels_size = color_attachment_count * sample_count;
+    std::vector<void *> color_attachment_pixel_buffers(
+        color_attachment_pixels_size * worker_thread_pool.get_thread_count(), nullptr);
+    // the span's pixels are in the same row of a micro-tile of tiled attachments, so they are
+    // contiguous in both image layouts; each tile is a macro-tile, so it's contiguous too
+    static_assert(vulkan::Vulkan_image_descriptor::micro_tile_size % lane_count == 0, "");
+    static_assert(vulkan::Vulkan_image_descriptor::macro_tile_size == tile_size, "");
+    // shades the pixels (x + lane, y) for every lane set in any of the sample_count masks in
+    // sample_lane_masks, which has the covered samples; x is block aligned. The pixels are
+    // shaded once, and the color is stored to each covered sample.
+    // runs the depth test before the fragment shader (early-z), so occluded fragments are never
+    // shaded
+#warning move the depth test after the fragment shader for shaders that write FragDepth or discard
+    auto shade_span = [&](const Primitive_setup &primitive_setup,
+                          const Plane_equation *varying_planes,
+                          std::int32_t x,
+                          std::int32_t y,
+                          std::uint32_t *sample_lane_masks,
+                          float *fragment_input_buffer,
+                          void **color_attachment_pixels) noexcept
+    {
+        std::uint32_t lane_mask = 0;
+        if(depth_attachment_memory)
+        {
+            std::size_t depth_offset = depth_attachment_subimage.get_pixel_offset(x, y);
+            for(std::uint32_t sample = 0; sample < sample_count; sample++)
             {
-                for(std::int32_t x = min_x; x < end_x; x++)
+                auto *attachment_depths = reinterpret_cast<float *>(
+                    depth_attachment_memory + sample * depth_attachment_subimage.sample_plane_size
+                    + depth_offset);
+                // zero for the single sample at the pixel center
+                float sample_depth_offset =
+                    primitive_setup.depth_plane.get_sample_offset(sample_positions[sample]);
+                for(std::uint32_t lanes = sample_lane_masks[sample]; lanes; lanes &= lanes - 1)
                 {
-                    bool inside = true;
-                    for(auto &edge_equation : edge_equations)
+                    auto lane = static_cast<std::int32_t>(util::ctz32(lanes));
+                    float fragment_depth =
+                        primitive_setup.depth_plane.evaluate(x + lane, y) + sample_depth_offset;
+                    if(!compare_depth(
+                           depth_state.compare_op, fragment_depth, attachment_depths[lane]))
+                        sample_lane_masks[sample] &= ~(1UL << lane);
+                    else if(depth_state.write_enable)
+                        attachment_depths[lane] = fragment_depth;
+                }
+                lane_mask |= sample_lane_masks[sample];
+            }
+        }
+        else
+        {
+            for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                lane_mask |= sample_lane_masks[sample];
+        }
+        if(!lane_mask)
+            return;
+        if(!compressed_color_attachments.empty())
+        {
+            // a pixel that's covered at every sample gets the same color in every sample, so it
+            // only needs to be stored to sample 0 if it can be left compressed in every
+            // attachment: attachments that use the old color need it to be compressed already,
+            // since otherwise the samples' old colors can differ
+            std::uint32_t fully_covered_lanes = lane_mask;
+            for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                fully_covered_lanes &= sample_lane_masks[sample];
+            std::uint32_t compressed_lanes = fully_covered_lanes;
+            for(auto &attachment : compressed_color_attachments)
+                if(attachment.write_kind == Color_attachment_write_kind::Read_modify_write)
+                    compressed_lanes &= attachment.image->get_sample_compression_mask(x, y);
+            for(auto &attachment : compressed_color_attachments)
+            {
+                auto &compression_mask = attachment.image->get_sample_compression_mask(x, y);
+                std::uint32_t decompressed_lanes = lane_mask & ~compressed_lanes;
+                if(attachment.write_kind == Color_attachment_write_kind::Overwrite)
+                {
+                    // every sample of a fully covered pixel is overwritten, so the old color
+                    // doesn't need to be copied
+                    decompressed_lanes &= ~fully_covered_lanes;
+                    compression_mask &= ~(fully_covered_lanes & ~compressed_lanes);
+                    compression_mask |= compressed_lanes;
+                }
+                attachment.image->decompress_samples(x, y, decompressed_lanes);
+            }
+            for(std::uint32_t sample = 1; sample < sample_count; sample++)
+                sample_lane_masks[sample] &= ~compressed_lanes;
+        }
+        if(!fragment_inputs.empty())
+        {
+            // inactive lanes are interpolated too, so these loops can be vectorized
+            float w[lane_count];
+            for(std::int32_t lane = 0; lane < lane_count; lane++)
+                w[lane] = 1.0f / primitive_setup.inverse_w_plane.evaluate(x + lane, y);
+            auto *plane = varying_planes;
+            for(auto &fragment_input : fragment_inputs)
+            {
+                float *components = fragment_input_buffer
+                                    + fragment_input.location * location_component_count
+                                          * lane_count;
+                for(std::size_t component = 0; component < fragment_input.component_count;
+                    component++, plane++, components += lane_count)
+                {
+                    switch(fragment_input.interpolation_kind)
                     {
-                        inside &= edge_equation.inside(x, y);
+                    case Interpolation_kind::Perspective:
+                        for(std::int32_t lane = 0; lane < lane_count; lane++)
+                            components[lane] = plane->evaluate(x + lane, y) * w[lane];
+                        break;
+                    case Interpolation_kind::Linear:
+                        for(std::int32_t lane = 0; lane < lane_count; lane++)
+                            components[lane] = plane->evaluate(x + lane, y);
+                        break;
+                    case Interpolation_kind::Flat:
+                        for(std::int32_t lane = 0; lane < lane_count; lane++)
+                            std::memcpy(&components[lane], &plane->c, sizeof(float));
+                        break;
                     }
-                    if(inside)
+                }
+            }
+        }
+        for(std::size_t i = 0; i < color_attachment_count; i++)
+        {
+            if(!color_attachment_memory[i * sample_count])
+                continue;
+            std::size_t offset = color_attachment_subimages[i].get_pixel_offset(x, y);
+            for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                color_attachment_pixels[i * sample_count + sample] =
+                    color_attachment_memory[i * sample_count + sample] + offset;
+        }
+        fs(x,
+           y,
+           lane_mask,
+           sample_lane_masks,
+           fragment_input_buffer,
+           uniforms,
+           color_attachment_pixels);
+    };
+    // shades every sample in the sample mask of every pixel in [min_x, end_x) by [min_y, end_y)
+    // without any edge tests
+    auto fill_rectangle = [&](const Primitive_setup &primitive_setup,
+                              const Plane_equation *varying_planes,
+                              std::int32_t min_x,
+                              std::int32_t min_y,
+                              std::int32_t end_x,
+                              std::int32_t end_y,
+                              float *fragment_input_buffer,
+                              void **color_attachment_pixels) noexcept
+    {
+        for(std::int32_t y = min_y; y < end_y; y++)
+        {
+            for(std::int32_t x = min_x & ~(lane_count - 1); x < end_x; x += lane_count)
+            {
+                std::uint32_t lane_mask = all_lanes_mask;
+                if(x < min_x)
+                    lane_mask &= all_lanes_mask << (min_x - x);
+                if(x + lane_count > end_x)
+                    lane_mask &= all_lanes_mask >> (x + lane_count - end_x);
+                std::uint32_t sample_lane_masks[max_sample_count];
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                    sample_lane_masks[sample] =
+                        (multisample_state.sample_mask >> sample) & 1 ? lane_mask : 0;
+                shade_span(primitive_setup,
+                           varying_planes,
+                           x,
+                           y,
+                           sample_lane_masks,
+                           fragment_input_buffer,
+                           color_attachment_pixels);
+            }
+        }
+    };
+    // classifies a square against the triangle at each sample in the sample mask: the square is
+    // only Inside or Outside when it is at all of the samples
+    auto classify_square_samples = [&](const Edge_equation(*sample_edge_equations)
+                                           [triangle_edge_count],
+                                       std::int32_t x,
+                                       std::int32_t y,
+                                       std::int32_t size) noexcept->Coverage_classification
+    {
+        util::optional<Coverage_classification> retval;
+        for(std::uint32_t samples = multisample_state.sample_mask; samples; samples &= samples - 1)
+        {
+            auto classification =
+                classify_square(sample_edge_equations[util::ctz32(samples)], x, y, size);
+            if(retval && *retval != classification)
+                return Coverage_classification::Partial;
+            retval = classification;
+        }
+        assert(retval);
+        return *retval;
+    };
+    // shades the covered samples of a small triangle in [min_x, end_x) by [min_y, end_y), which is
+    // inside the triangle's bounding box
+    auto rasterize_small_triangle = [&](const Primitive_setup &primitive_setup,
+                                        const Plane_equation *varying_planes,
+                                        std::int32_t min_x,
+                                        std::int32_t min_y,
+                                        std::int32_t end_x,
+                                        std::int32_t end_y,
+                                        float *fragment_input_buffer,
+                                        void **color_attachment_pixels) noexcept
+    {
+        for(std::int32_t y = min_y; y < end_y; y++)
+        {
+            // the pixels can be in two blocks
+            for(std::int32_t span_x = min_x & ~(lane_count - 1); span_x < end_x;
+                span_x += lane_count)
+            {
+                std::int32_t span_min_x = std::max(min_x, span_x);
+                std::int32_t span_end_x = std::min(end_x, span_x + lane_count);
+                std::uint32_t sample_lane_masks[max_sample_count];
+                std::uint32_t lane_mask = 0;
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                {
+                    sample_lane_masks[sample] = 0;
+                    for(std::int32_t x = span_min_x; x < span_end_x; x++)
+                        if((primitive_setup.small_triangle_coverage_mask
+                            >> get_small_triangle_coverage_bit(
+                                   x - primitive_setup.min_x, y - primitive_setup.min_y, sample))
+                           & 1)
+                            sample_lane_masks[sample] |= 1UL << (x - span_x);
+                    lane_mask |= sample_lane_masks[sample];
+                }
+                if(lane_mask)
+                    shade_span(primitive_setup,
+                               varying_planes,
+                               span_x,
+                               y,
+                               sample_lane_masks,
+                               fragment_input_buffer,
+                               color_attachment_pixels);
+            }
+        }
+    };
+    auto rasterize_tile = [&](std::size_t task_index, std::size_t thread_index) noexcept
+    {
+        float *fragment_input_buffer =
+            fragment_input_buffers.data() + thread_index * fragment_input_buffer_size;
+        void **color_attachment_pixels =
+            color_attachment_pixel_buffers.data() + thread_index * color_attachment_pixels_size;
+        auto tile_index = binned_tile_indexes[task_index];
+        std::int32_t tile_x = tile_index % tile_count_x;
+        std::int32_t tile_y = tile_index / tile_count_x;
+        std::int32_t tile_min_x = tile_x << log2_tile_size;
+        std::int32_t tile_min_y = tile_y << log2_tile_size;
+        std::int32_t tile_end_x = tile_min_x + tile_size;
+        std::int32_t tile_end_y = tile_min_y + tile_size;
+        // the tile is a macro-tile of the tiled attachments
+        for(auto *attachment : lazily_cleared_attachments)
+            attachment->fill_cleared_tile(tile_x, tile_y);
+        for(std::size_t partition_index = 0; partition_index < partition_count; partition_index++)
+        {
+            auto &buffers = front_end_buffers[partition_index];
+            for(auto primitive_setup_index : buffers.tile_bins[tile_index])
+            {
+                auto &primitive_setup = buffers.primitive_setups[primitive_setup_index];
+                const Plane_equation *varying_planes = nullptr;
+                if(!fragment_inputs.empty())
+                    varying_planes =
+                        buffers.varying_planes.data() + primitive_setup.varying_plane_start;
+                std::int32_t min_x = std::max(primitive_setup.min_x, tile_min_x);
+                std::int32_t end_x = std::min(primitive_setup.end_x, tile_end_x);
+                std::int32_t min_y = std::max(primitive_setup.min_y, tile_min_y);
+                std::int32_t end_y = std::min(primitive_setup.end_y, tile_end_y);
+                if(primitive_setup.is_small)
+                {
+                    // the front end already computed the coverage
+                    rasterize_small_triangle(primitive_setup,
+                                             varying_planes,
+                                             min_x,
+                                             min_y,
+                                             end_x,
+                                             end_y,
+                                             fragment_input_buffer,
+                                             color_attachment_pixels);
+                    continue;
+                }
+                // the edge equations moved to each sample position; the single sample of a
+                // pixel that isn't multisampled is at the center, so they don't change
+                Edge_equation sample_edge_equations[max_sample_count][triangle_edge_count];
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                    for(std::size_t i = 0; i < triangle_edge_count; i++)
+                        sample_edge_equations[sample][i] =
+                            primitive_setup.edge_equations[i].get_sample_equation(
+                                sample_positions[sample]);
+                // primitives with edges that are too steep to narrow, including all the
+                // primitives when use_narrow_scale is false, use the 64-bit coverage kernel
+                bool use_narrow_edge_equations = true;
+                for(auto &edge_equation : primitive_setup.edge_equations)
+                    use_narrow_edge_equations &= can_narrow_edge_equation(edge_equation);
+                // hierarchical coverage: classify the whole tile first, then each block, and only
+                // run the per-pixel coverage kernel on blocks that are partially covered
+                switch(classify_square_samples(
+                    sample_edge_equations, tile_min_x, tile_min_y, tile_size))
+                {
+                case Coverage_classification::Outside:
+                    continue;
+                case Coverage_classification::Inside:
+                    fill_rectangle(primitive_setup,
+                                   varying_planes,
+                                   min_x,
+                                   min_y,
+                                   end_x,
+                                   end_y,
+                                   fragment_input_buffer,
+                                   color_attachment_pixels);
+                    continue;
+                case Coverage_classification::Partial:
+                    break;
+                }
+                // tiles are a multiple of the block size, so blocks never cross tile boundaries
+                for(std::int32_t block_y = min_y & ~(block_size - 1); block_y < end_y;
+                    block_y += block_size)
+                {
+                    for(std::int32_t block_x = min_x & ~(block_size - 1); block_x < end_x;
+                        block_x += block_size)
                     {
-                        auto *pixel = reinterpret_cast<Pixel_type *>(
-                            static_cast<unsigned char *>(color_attachment_memory)
-                            + (static_cast<std::size_t>(x) * color_attachment_pixel_size
-                               + static_cast<std::size_t>(y) * color_attachment_stride));
-                        fs(pixel, uniforms);
+                        switch(classify_square_samples(
+                            sample_edge_equations, block_x, block_y, block_size))
+                        {
+                        case Coverage_classification::Outside:
+                            continue;
+                        case Coverage_classification::Inside:
+                            fill_rectangle(primitive_setup,
+                                           varying_planes,
+                                           std::max(min_x, block_x),
+                                           std::max(min_y, block_y),
+                                           std::min(end_x, block_x + block_size),
+                                           std::min(end_y, block_y + block_size),
+                                           fragment_input_buffer,
+                                           color_attachment_pixels);
+                            continue;
+                        case Coverage_classification::Partial:
+                            break;
+                        }
+                        auto rectangle_mask = get_block_rectangle_mask(min_x - block_x,
+                                                                       min_y - block_y,
+                                                                       end_x - block_x,
+                                                                       end_y - block_y);
+                        Block_coverage_mask sample_coverage_masks[max_sample_count];
+                        Block_coverage_mask any_coverage_mask = 0;
+                        for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                        {
+                            sample_coverage_masks[sample] = 0;
+                            if(!((multisample_state.sample_mask >> sample) & 1))
+                                continue;
+                            if(use_narrow_edge_equations)
+                            {
+                                Narrow_edge_equation narrow_edge_equations[triangle_edge_count];
+                                bool is_outside = false;
+                                for(std::size_t i = 0; i < triangle_edge_count; i++)
+                                    is_outside |=
+                                        !narrow_edge_equation(sample_edge_equations[sample][i],
+                                                              block_x,
+                                                              block_y,
+                                                              narrow_edge_equations[i]);
+                                if(!is_outside)
+                                    sample_coverage_masks[sample] =
+                                        narrow_block_coverage_kernel.function(
+                                            narrow_edge_equations)
+                                        & rectangle_mask;
+                            }
+                            else
+                            {
+                                sample_coverage_masks[sample] =
+                                    block_coverage_kernel.function(
+                                        sample_edge_equations[sample], block_x, block_y)
+                                    & rectangle_mask;
+                            }
+                            any_coverage_mask |= sample_coverage_masks[sample];
+                        }
+                        // each byte of a coverage mask is the lane mask for one row of the block
+                        for(std::int32_t row = 0; any_coverage_mask;
+                            row++, any_coverage_mask >>= block_size)
+                        {
+                            if(!(any_coverage_mask & all_lanes_mask))
+                                continue;
+                            std::uint32_t sample_lane_masks[max_sample_count];
+                            for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                                sample_lane_masks[sample] =
+                                    (sample_coverage_masks[sample] >> (row * block_size))
+                                    & all_lanes_mask;
+                            shade_span(primitive_setup,
+                                       varying_planes,
+                                       block_x,
+                                       block_y + row,
+                                       sample_lane_masks,
+                                       fragment_input_buffer,
+                                       color_attachment_pixels);
+                        }
                     }
                 }
             }
-        };
-    }
+        }
+    };
+    worker_thread_pool.run_parallel(binned_tile_indexes.size(), rasterize_tile);
 }
 
 std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
-    vulkan::Vulkan_device &,
+    vulkan::Vulkan_device &device,
     Pipeline_cache *pipeline_cache,
     const VkGraphicsPipelineCreateInfo &create_info)
 {
@@ -966,6 +2607,95 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
     implementation->data_layout = llvm_target_machine.create_target_data_layout();
     implementation->instantiated_pipeline_layout = std::make_unique<Instantiated_pipeline_layout>(
         *pipeline_layout, implementation->llvm_context.get(), implementation->data_layout.get());
+    // the fragment shader writes every color attachment of the subpass in the same call
+    std::vector<VkFormat> color_attachment_formats;
+    color_attachment_formats.reserve(render_pass->color_attachment_indexes.size());
+    for(auto color_attachment_index : render_pass->color_attachment_indexes)
+    {
+        if(color_attachment_index == VK_ATTACHMENT_UNUSED)
+        {
+            color_attachment_formats.push_back(VK_FORMAT_UNDEFINED);
+            continue;
+        }
+        auto format = render_pass->attachments[color_attachment_index].format;
+        if(!vulkan::Color_format_layout::get(format))
+            throw std::runtime_error("unimplemented color attachment format");
+        color_attachment_formats.push_back(format);
+    }
+    // pMultisampleState and pColorBlendState are ignored when rasterization is disabled
+    const VkPipelineMultisampleStateCreateInfo *multisample_state_create_info = nullptr;
+    const VkPipelineColorBlendStateCreateInfo *color_blend_state = nullptr;
+    Multisample_state multisample_state = {
+        .sample_count = 1, .sample_mask = 1,
+    };
+    if(create_info.pRasterizationState
+       && !create_info.pRasterizationState->rasterizerDiscardEnable)
+    {
+        if(!create_info.pMultisampleState)
+            throw std::runtime_error("missing multisample state");
+        multisample_state_create_info = create_info.pMultisampleState;
+        assert(multisample_state_create_info->sType
+               == VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO);
+        multisample_state.sample_count = multisample_state_create_info->rasterizationSamples;
+        if(multisample_state.sample_count > max_sample_count)
+            throw std::runtime_error("unsupported sample count");
+        // the subpass's attachments all have the same sample count as the pipeline
+        auto subpass_attachment_indexes = render_pass->color_attachment_indexes;
+        if(render_pass->depth_stencil_attachment_index)
+            subpass_attachment_indexes.push_back(*render_pass->depth_stencil_attachment_index);
+        for(auto attachment_index : subpass_attachment_indexes)
+            if(attachment_index != VK_ATTACHMENT_UNUSED
+               && render_pass->attachments[attachment_index].samples
+                      != multisample_state_create_info->rasterizationSamples)
+                throw std::runtime_error(
+                    "attachment sample count doesn't match rasterization sample count");
+        multisample_state.sample_mask = (1ULL << multisample_state.sample_count) - 1;
+        if(multisample_state_create_info->pSampleMask)
+            multisample_state.sample_mask &= multisample_state_create_info->pSampleMask[0];
+        if(multisample_state_create_info->sampleShadingEnable)
+#warning implement sample shading
+            throw std::runtime_error("sample shading is not implemented");
+        if(multisample_state_create_info->alphaToCoverageEnable)
+#warning implement alpha to coverage
+            throw std::runtime_error("alpha to coverage is not implemented");
+        if(multisample_state_create_info->alphaToOneEnable)
+#warning implement alpha to one
+            throw std::runtime_error("alpha to one is not implemented");
+        if(!create_info.pColorBlendState)
+            throw std::runtime_error("missing color blend state");
+        color_blend_state = create_info.pColorBlendState;
+        assert(color_blend_state->sType
+               == VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO);
+        if(color_blend_state->attachmentCount != color_attachment_formats.size())
+            throw std::runtime_error(
+                "color blend attachment count doesn't match the subpass color attachment count");
+        for(std::uint32_t i = 0; i < color_blend_state->attachmentCount; i++)
+        {
+            auto &attachment_state = color_blend_state->pAttachments[i];
+            // blendEnable is ignored when the logic op is enabled
+            if(color_blend_state->logicOpEnable || !attachment_state.blendEnable)
+                continue;
+            for(auto blend_factor : {attachment_state.srcColorBlendFactor,
+                                     attachment_state.dstColorBlendFactor,
+                                     attachment_state.srcAlphaBlendFactor,
+                                     attachment_state.dstAlphaBlendFactor})
+                if(blend_factor >= VK_BLEND_FACTOR_SRC1_COLOR)
+#warning implement dual source blending
+                    throw std::runtime_error("dual source blending is not implemented");
+            for(auto blend_op : {attachment_state.colorBlendOp, attachment_state.alphaBlendOp})
+                if(blend_op > VK_BLEND_OP_MAX)
+#warning implement advanced blend operations
+                    throw std::runtime_error("advanced blend operations are not implemented");
+        }
+        if(create_info.pDynamicState)
+        {
+            for(std::uint32_t i = 0; i < create_info.pDynamicState->dynamicStateCount; i++)
+                if(create_info.pDynamicState->pDynamicStates[i]
+                   == VK_DYNAMIC_STATE_BLEND_CONSTANTS)
+#warning implement dynamic blend constants
+                    throw std::runtime_error("dynamic blend constants are not implemented");
+        }
+    }
     implementation->compiled_shaders.reserve(create_info.stageCount);
     util::Enum_set<spirv::Execution_model> found_shader_stages;
     for(std::size_t i = 0; i < create_info.stageCount; i++)
@@ -1006,6 +2736,9 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
                                          execution_model,
                                          stage_info.pName,
                                          create_info.pVertexInputState,
+                                         multisample_state_create_info,
+                                         color_blend_state,
+                                         color_attachment_formats,
                                          *implementation->instantiated_pipeline_layout);
         std::cerr << "Translation to LLVM succeeded." << std::endl;
         ::LLVMDumpModule(compiled_shader.module.get());
@@ -1020,7 +2753,10 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
     Vertex_shader_function vertex_shader_function = nullptr;
     std::size_t vertex_shader_output_struct_size = 0;
     util::optional<std::size_t> vertex_shader_position_output_offset;
+    util::optional<std::size_t> vertex_shader_point_size_output_offset;
     Fragment_shader_function fragment_shader_function = nullptr;
+    std::shared_ptr<spirv_to_llvm::Struct_type_descriptor> fragment_shader_input_struct;
+    std::shared_ptr<spirv_to_llvm::Struct_type_descriptor> fragment_shader_output_struct;
     for(auto &compiled_shader : implementation->compiled_shaders)
     {
         implementation->jit_stack.add_eagerly_compiled_ir(
@@ -1037,6 +2773,8 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
         case spirv::Execution_model::fragment:
             fragment_shader_function =
                 reinterpret_cast<Fragment_shader_function>(shader_entry_point_address);
+            fragment_shader_input_struct = compiled_shader.inputs_struct;
+            fragment_shader_output_struct = compiled_shader.outputs_struct;
 #warning finish implementing Graphics_pipeline::make
             continue;
         case spirv::Execution_model::geometry:
@@ -1058,60 +2796,49 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
                 implementation->vertex_shader_output_struct->get_or_make_type().type;
             vertex_shader_output_struct_size = ::LLVMABISizeOfType(
                 implementation->data_layout.get(), llvm_vertex_shader_output_struct);
-            for(auto &member : implementation->vertex_shader_output_struct->get_members(true))
+            // returns the offset of the output variable decorated with built_in, which is either
+            // a member of the output struct or a member of a member struct (gl_PerVertex)
+            auto find_built_in_output_offset = [&](spirv::Built_in built_in)
+                -> util::optional<std::size_t>
             {
-                for(auto &decoration : member.decorations)
+                auto is_built_in =
+                    [built_in](const spirv_to_llvm::Struct_type_descriptor::Member &member)
                 {
-                    if(decoration.value == spirv::Decoration::built_in)
-                    {
-                        auto &builtin =
-                            util::get<spirv::Decoration_built_in_parameters>(decoration.parameters);
-                        if(builtin.built_in == spirv::Built_in::position)
-                        {
-                            vertex_shader_position_output_offset =
-                                ::LLVMOffsetOfElement(implementation->data_layout.get(),
-                                                      llvm_vertex_shader_output_struct,
-                                                      member.llvm_member_index);
-                            break;
-                        }
-                    }
-                }
-                if(vertex_shader_position_output_offset)
-                    break;
-                if(auto *struct_type =
-                       dynamic_cast<spirv_to_llvm::Struct_type_descriptor *>(member.type.get()))
+                    for(auto &decoration : member.decorations)
+                        if(decoration.value == spirv::Decoration::built_in
+                           && util::get<spirv::Decoration_built_in_parameters>(
+                                  decoration.parameters)
+                                      .built_in
+                                  == built_in)
+                            return true;
+                    return false;
+                };
+                for(auto &member : implementation->vertex_shader_output_struct->get_members(true))
                 {
-                    std::size_t struct_offset =
+                    std::size_t member_offset =
                         ::LLVMOffsetOfElement(implementation->data_layout.get(),
                                               llvm_vertex_shader_output_struct,
                                               member.llvm_member_index);
+                    if(is_built_in(member))
+                        return member_offset;
+                    auto *struct_type =
+                        dynamic_cast<spirv_to_llvm::Struct_type_descriptor *>(member.type.get());
+                    if(!struct_type)
+                        continue;
                     auto llvm_struct_type = struct_type->get_or_make_type().type;
                     for(auto &submember : struct_type->get_members(true))
-                    {
-                        for(auto &decoration : submember.decorations)
-                        {
-                            if(decoration.value == spirv::Decoration::built_in)
-                            {
-                                auto &builtin = util::get<spirv::Decoration_built_in_parameters>(
-                                    decoration.parameters);
-                                if(builtin.built_in == spirv::Built_in::position)
-                                {
-                                    vertex_shader_position_output_offset =
-                                        struct_offset
-                                        + ::LLVMOffsetOfElement(implementation->data_layout.get(),
-                                                                llvm_struct_type,
-                                                                submember.llvm_member_index);
-                                    break;
-                                }
-                            }
-                        }
-                        if(vertex_shader_position_output_offset)
-                            break;
-                    }
+                        if(is_built_in(submember))
+                            return member_offset
+                                   + ::LLVMOffsetOfElement(implementation->data_layout.get(),
+                                                           llvm_struct_type,
+                                                           submember.llvm_member_index);
                 }
-                if(vertex_shader_position_output_offset)
-                    break;
-            }
+                return {};
+            };
+            vertex_shader_position_output_offset =
+                find_built_in_output_offset(spirv::Built_in::position);
+            vertex_shader_point_size_output_offset =
+                find_built_in_output_offset(spirv::Built_in::point_size);
             if(!vertex_shader_position_output_offset)
                 throw std::runtime_error("can't find vertex shader Position output");
 #warning finish implementing Graphics_pipeline::make
@@ -1132,14 +2859,223 @@ std::unique_ptr<Graphics_pipeline> Graphics_pipeline::create(
     if(!create_info.pViewportState->pScissors)
         throw std::runtime_error("missing scissor rectangle list");
     assert(vertex_shader_position_output_offset);
+    auto get_location = [](const spirv_to_llvm::Struct_type_descriptor::Member &member)
+        -> util::optional<std::uint32_t>
+    {
+        for(auto &decoration : member.decorations)
+            if(decoration.value == spirv::Decoration::location)
+                return util::get<spirv::Decoration_location_parameters>(decoration.parameters)
+                    .location;
+        return {};
+    };
+    std::vector<Fragment_input> fragment_inputs;
+    std::size_t fragment_input_location_count = 0;
+    if(fragment_shader_input_struct)
+    {
+        // returns the number of 32-bit components or 0 if the type isn't supported
+        auto get_component_count = [](::LLVMTypeRef type) -> std::size_t
+        {
+            std::size_t component_count = 1;
+            if(::LLVMGetTypeKind(type) == ::LLVMVectorTypeKind)
+            {
+                component_count = ::LLVMGetVectorSize(type);
+                type = ::LLVMGetElementType(type);
+            }
+            if(::LLVMGetTypeKind(type) == ::LLVMFloatTypeKind)
+                return component_count;
+            if(::LLVMGetTypeKind(type) == ::LLVMIntegerTypeKind
+               && ::LLVMGetIntTypeWidth(type) == 32)
+                return component_count;
+            return 0;
+        };
+        auto is_integer = [](::LLVMTypeRef type) -> bool
+        {
+            if(::LLVMGetTypeKind(type) == ::LLVMVectorTypeKind)
+                type = ::LLVMGetElementType(type);
+            return ::LLVMGetTypeKind(type) == ::LLVMIntegerTypeKind;
+        };
+        auto llvm_vertex_shader_output_struct =
+            implementation->vertex_shader_output_struct->get_or_make_type().type;
+        for(auto &member : fragment_shader_input_struct->get_members(true))
+        {
+            auto location = get_location(member);
+            if(!location)
+                continue; // built-in variable
+            auto llvm_type = member.type->get_or_make_type().type;
+            Fragment_input fragment_input = {
+                .location = *location,
+                .component_count = get_component_count(llvm_type),
+                .interpolation_kind = Interpolation_kind::Perspective,
+                .vertex_shader_output_offset = 0,
+            };
+            if(fragment_input.component_count == 0)
+                throw std::runtime_error("fragment shader input variable type is not implemented");
+            if(is_integer(llvm_type))
+                fragment_input.interpolation_kind = Interpolation_kind::Flat;
+            for(auto &decoration : member.decorations)
+            {
+                if(decoration.value == spirv::Decoration::flat)
+                    fragment_input.interpolation_kind = Interpolation_kind::Flat;
+                else if(decoration.value == spirv::Decoration::no_perspective
+                        && fragment_input.interpolation_kind != Interpolation_kind::Flat)
+                    fragment_input.interpolation_kind = Interpolation_kind::Linear;
+            }
+            bool found_vertex_shader_output = false;
+            for(auto &vertex_shader_output_member :
+                implementation->vertex_shader_output_struct->get_members(true))
+            {
+                auto vertex_shader_output_location = get_location(vertex_shader_output_member);
+                if(!vertex_shader_output_location || *vertex_shader_output_location != *location)
+                    continue;
+                auto vertex_shader_output_component_count = get_component_count(
+                    vertex_shader_output_member.type->get_or_make_type().type);
+                if(vertex_shader_output_component_count < fragment_input.component_count)
+                    throw std::runtime_error(
+                        "vertex shader output has fewer components than fragment shader input");
+                fragment_input.vertex_shader_output_offset =
+                    ::LLVMOffsetOfElement(implementation->data_layout.get(),
+                                          llvm_vertex_shader_output_struct,
+                                          vertex_shader_output_member.llvm_member_index);
+                found_vertex_shader_output = true;
+                break;
+            }
+            if(!found_vertex_shader_output)
+                throw std::runtime_error(
+                    "fragment shader input variable has no matching vertex shader output");
+            if(fragment_input_location_count <= fragment_input.location)
+                fragment_input_location_count = fragment_input.location + 1;
+            fragment_inputs.push_back(fragment_input);
+        }
+    }
+    // the same rules as the fragment shader entry point: output variables are written to the
+    // color attachment with the same Location
+    std::vector<Color_attachment_write_kind> color_attachment_write_kinds(
+        color_attachment_formats.size(), Color_attachment_write_kind::Not_written);
+    if(fragment_shader_output_struct && color_blend_state)
+    {
+        constexpr VkColorComponentFlags all_color_components =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+        for(auto &member : fragment_shader_output_struct->get_members(true))
+        {
+            auto location = get_location(member);
+            if(!location || *location >= color_attachment_formats.size()
+               || color_attachment_formats[*location] == VK_FORMAT_UNDEFINED)
+                continue;
+            auto &attachment_state = color_blend_state->pAttachments[*location];
+            bool reads_old_color =
+                (attachment_state.colorWriteMask & all_color_components) != all_color_components;
+            if(color_blend_state->logicOpEnable
+               && vulkan::Color_format_layout::get(color_attachment_formats[*location])
+                      ->supports_logic_op())
+                reads_old_color |= color_blend_state->logicOp != VK_LOGIC_OP_COPY;
+            else
+                reads_old_color |= attachment_state.blendEnable;
+            color_attachment_write_kinds[*location] =
+                reads_old_color ? Color_attachment_write_kind::Read_modify_write :
+                                  Color_attachment_write_kind::Overwrite;
+        }
+    }
+    if(!create_info.pInputAssemblyState)
+        throw std::runtime_error("missing input assembly state");
+    assert(create_info.pInputAssemblyState->sType
+           == VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO);
+    Input_assembly_state input_assembly_state = {
+        .topology = create_info.pInputAssemblyState->topology,
+        .primitive_restart_enable = create_info.pInputAssemblyState->primitiveRestartEnable != 0,
+    };
+    switch(input_assembly_state.topology)
+    {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+        break;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY:
+#warning implement geometry shaders
+        throw std::runtime_error("primitive topologies with adjacency are not implemented");
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+#warning implement tessellation shaders
+        throw std::runtime_error("patch list primitive topology is not implemented");
+    case VK_PRIMITIVE_TOPOLOGY_RANGE_SIZE:
+    case VK_PRIMITIVE_TOPOLOGY_MAX_ENUM:
+        throw std::runtime_error("invalid primitive topology");
+    }
+    if(!create_info.pRasterizationState)
+        throw std::runtime_error("missing rasterization state");
+    assert(create_info.pRasterizationState->sType
+           == VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO);
+    Rasterization_state rasterization_state = {
+        .cull_mode = create_info.pRasterizationState->cullMode,
+        .front_face = create_info.pRasterizationState->frontFace,
+        .polygon_mode = create_info.pRasterizationState->polygonMode,
+        .line_width = create_info.pRasterizationState->lineWidth,
+        .dynamic_line_width = false,
+    };
+    switch(rasterization_state.polygon_mode)
+    {
+    case VK_POLYGON_MODE_FILL:
+    case VK_POLYGON_MODE_LINE:
+    case VK_POLYGON_MODE_POINT:
+        break;
+    case VK_POLYGON_MODE_FILL_RECTANGLE_NV:
+    case VK_POLYGON_MODE_RANGE_SIZE:
+    case VK_POLYGON_MODE_MAX_ENUM:
+        throw std::runtime_error("unimplemented polygon mode");
+    }
+    if(create_info.pDynamicState)
+    {
+        for(std::uint32_t i = 0; i < create_info.pDynamicState->dynamicStateCount; i++)
+            if(create_info.pDynamicState->pDynamicStates[i] == VK_DYNAMIC_STATE_LINE_WIDTH)
+                rasterization_state.dynamic_line_width = true;
+    }
+    Depth_state depth_state = {
+        .test_enable = false, .write_enable = false, .compare_op = VK_COMPARE_OP_ALWAYS,
+    };
+    // pDepthStencilState is ignored when the subpass doesn't use a depth attachment
+    if(render_pass->depth_stencil_attachment_index)
+    {
+        if(!create_info.pDepthStencilState)
+            throw std::runtime_error("missing depth stencil state");
+        auto &depth_stencil_state = *create_info.pDepthStencilState;
+        assert(depth_stencil_state.sType
+               == VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO);
+        if(depth_stencil_state.depthBoundsTestEnable)
+#warning implement the depth bounds test
+            throw std::runtime_error("depth bounds test is not implemented");
+        if(depth_stencil_state.stencilTestEnable)
+#warning implement the stencil test
+            throw std::runtime_error("stencil test is not implemented");
+        if(depth_stencil_state.depthTestEnable)
+        {
+            depth_state.test_enable = true;
+            depth_state.write_enable = depth_stencil_state.depthWriteEnable;
+            depth_state.compare_op = depth_stencil_state.depthCompareOp;
+        }
+    }
     return std::unique_ptr<Graphics_pipeline>(
         new Graphics_pipeline(std::move(implementation),
                               vertex_shader_function,
                               vertex_shader_output_struct_size,
                               *vertex_shader_position_output_offset,
+                              vertex_shader_point_size_output_offset,
                               fragment_shader_function,
+                              std::move(fragment_inputs),
+                              fragment_input_location_count,
+                              color_attachment_formats.size(),
+                              std::move(color_attachment_write_kinds),
                               create_info.pViewportState->pViewports[0],
-                              create_info.pViewportState->pScissors[0]));
+                              create_info.pViewportState->pScissors[0],
+                              input_assembly_state,
+                              rasterization_state,
+                              multisample_state,
+                              depth_state,
+                              device.worker_thread_pool));
 }
 }
 }
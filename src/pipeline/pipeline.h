@@ -28,12 +28,15 @@
 #include <utility>
 #include <cassert>
 #include <cstring>
+#include <vector>
 #include "llvm_wrapper/llvm_wrapper.h"
 #include "vulkan/vulkan.h"
 #include "vulkan/remove_xlib_macros.h"
 #include "spirv/spirv.h"
 #include "vulkan/api_objects.h"
 #include "spirv_to_llvm/spirv_to_llvm.h"
+#include "util/thread_pool.h"
+#include "util/optional.h"
 
 namespace kazan
 {
@@ -157,25 +160,113 @@ private:
 
 public:
 #warning finish adding draw function parameters
+    /** shades every vertex from vertex_start_index to vertex_end_index for every instance from
+     * instance_start_index to instance_end_index, writing the outputs for all the instances of a
+     * vertex before the outputs for the next vertex. vertex_end_index is 64 bits so the ranges
+     * that include vertex index 0xFFFFFFFF can be represented. */
     typedef void (*Vertex_shader_function)(std::uint32_t vertex_start_index,
-                                           std::uint32_t vertex_end_index,
-                                           std::uint32_t instance_id,
+                                           std::uint64_t vertex_end_index,
+                                           std::uint32_t instance_start_index,
+                                           std::uint32_t instance_end_index,
                                            void *output_buffer,
                                            void *const *input_bindings,
                                            void *uniforms);
-    typedef void (*Fragment_shader_function)(std::uint32_t *color_attachment_pixel, void *uniforms);
+    /** the number of horizontally adjacent pixels shaded by each call to the fragment shader */
+    static constexpr std::size_t fragment_shader_lane_count = 8;
+    /** shades the pixels from (x, y) to (x + fragment_shader_lane_count - 1, y) that have their
+     * bit set in lane_mask; the other pixels aren't accessed. color_attachment_pixels has the
+     * address of pixel (x, y) in each color attachment of the subpass, so all the color
+     * attachments are written by the same call; x is a multiple of fragment_shader_lane_count,
+     * so the span's pixels are contiguous in every image layout. The colors are converted to
+     * each color attachment's format by the fragment shader.
+     * When multisampling, each pixel is shaded once and its color is stored to the samples with
+     * their lane's bit set in sample_lane_masks, which has one mask per sample;
+     * color_attachment_pixels then has an element for each sample plane of each color
+     * attachment, at color_attachment_index * sample_count + sample_index. sample_lane_masks is
+     * ignored when not multisampling. */
+    typedef void (*Fragment_shader_function)(std::uint32_t x,
+                                             std::uint32_t y,
+                                             std::uint32_t lane_mask,
+                                             const std::uint32_t *sample_lane_masks,
+                                             const void *inputs,
+                                             void *uniforms,
+                                             void *const *color_attachment_pixels);
+    enum class Interpolation_kind
+    {
+        Perspective,
+        Linear,
+        Flat,
+    };
+    /** a fragment shader input variable; the interpolated values are passed to the fragment
+     * shader as 4 32-bit components per Location, with fragment_shader_lane_count values (one
+     * per lane) for each component */
+    struct Fragment_input
+    {
+        std::uint32_t location;
+        std::size_t component_count;
+        Interpolation_kind interpolation_kind;
+        std::size_t vertex_shader_output_offset;
+    };
+    struct Depth_state
+    {
+        bool test_enable;
+        bool write_enable;
+        VkCompareOp compare_op;
+    };
+    struct Input_assembly_state
+    {
+        VkPrimitiveTopology topology;
+        bool primitive_restart_enable;
+    };
+    struct Rasterization_state
+    {
+        VkCullModeFlags cull_mode;
+        VkFrontFace front_face;
+        VkPolygonMode polygon_mode;
+        float line_width;
+        /** the line width is passed to run instead of using line_width */
+        bool dynamic_line_width;
+    };
+    struct Multisample_state
+    {
+        /** 1, 2, 4, or 8 */
+        std::uint32_t sample_count;
+        /** only has bits for the samples that exist */
+        std::uint32_t sample_mask;
+    };
+    /** how the fragment shader writes a color attachment; pixels of multisample attachments
+     * that are Overwritten at every sample stay compressed */
+    enum class Color_attachment_write_kind
+    {
+        Not_written,
+        /** the output color replaces the old color */
+        Overwrite,
+        /** blending, the logic op, or the write mask use the old color */
+        Read_modify_write,
+    };
+    /** the index buffer of an indexed draw */
+    struct Index_buffer
+    {
+        /** points to index 0 */
+        const void *indexes;
+        VkIndexType index_type;
+        /** added to each index to get the vertex index */
+        std::int32_t vertex_offset;
+    };
 
 public:
     void run_vertex_shader(std::uint32_t vertex_start_index,
-                           std::uint32_t vertex_end_index,
-                           std::uint32_t instance_id,
+                           std::uint64_t vertex_end_index,
+                           std::uint32_t instance_start_index,
+                           std::uint32_t instance_end_index,
                            void *output_buffer,
                            void *const *input_bindings,
                            void *uniforms) const noexcept
     {
         vertex_shader_function(vertex_start_index,
                                vertex_end_index,
-                               instance_id,
+                               instance_start_index,
+                               instance_end_index,
                                output_buffer,
                                input_bindings,
                                uniforms);
@@ -185,16 +276,43 @@ public:
         return vertex_shader_output_struct_size;
     }
     void dump_vertex_shader_output_struct(const void *output_struct) const;
-    void run_fragment_shader(std::uint32_t *color_attachment_pixel, void *uniforms) const noexcept
+    void run_fragment_shader(std::uint32_t x,
+                             std::uint32_t y,
+                             std::uint32_t lane_mask,
+                             const std::uint32_t *sample_lane_masks,
+                             const void *inputs,
+                             void *uniforms,
+                             void *const *color_attachment_pixels) const noexcept
+    {
+        fragment_shader_function(x,
+                                 y,
+                                 lane_mask,
+                                 sample_lane_masks,
+                                 inputs,
+                                 uniforms,
+                                 color_attachment_pixels);
+    }
+    /** the number of color attachments in the subpass, including unused attachments */
+    std::size_t get_color_attachment_count() const noexcept
     {
-        fragment_shader_function(color_attachment_pixel, uniforms);
+        return color_attachment_count;
     }
+    /** draws the vertexes from vertex_start_index to vertex_end_index for each instance from
+     * instance_start_index to instance_end_index. If index_buffer isn't null,
+     * vertex_start_index and vertex_end_index are the range of indexes to use instead.
+     * color_attachments has get_color_attachment_count() elements, null for unused attachments.
+     * dynamic_line_width is the line width set by vkCmdSetLineWidth, and is only used when the
+     * pipeline's line width is dynamic. */
     void run(std::uint32_t vertex_start_index,
              std::uint32_t vertex_end_index,
-             std::uint32_t instance_id,
-             const vulkan::Vulkan_image &color_attachment,
+             std::uint32_t instance_start_index,
+             std::uint32_t instance_end_index,
+             const Index_buffer *index_buffer,
+             const vulkan::Vulkan_image *const *color_attachments,
+             const vulkan::Vulkan_image *depth_attachment,
              void *const *input_bindings,
-             void *uniforms);
+             void *uniforms,
+             float dynamic_line_width);
     static std::unique_ptr<Graphics_pipeline> create(
         vulkan::Vulkan_device &,
         Pipeline_cache *pipeline_cache,
@@ -215,16 +333,36 @@ private:
                       Vertex_shader_function vertex_shader_function,
                       std::size_t vertex_shader_output_struct_size,
                       std::size_t vertex_shader_position_output_offset,
+                      util::optional<std::size_t> vertex_shader_point_size_output_offset,
                       Fragment_shader_function fragment_shader_function,
+                      std::vector<Fragment_input> fragment_inputs,
+                      std::size_t fragment_input_location_count,
+                      std::size_t color_attachment_count,
+                      std::vector<Color_attachment_write_kind> color_attachment_write_kinds,
                       VkViewport viewport,
-                      VkRect2D scissor_rect) noexcept
+                      VkRect2D scissor_rect,
+                      Input_assembly_state input_assembly_state,
+                      Rasterization_state rasterization_state,
+                      Multisample_state multisample_state,
+                      Depth_state depth_state,
+                      util::Thread_pool &worker_thread_pool) noexcept
         : implementation(std::move(implementation)),
           vertex_shader_function(vertex_shader_function),
           vertex_shader_output_struct_size(vertex_shader_output_struct_size),
           vertex_shader_position_output_offset(vertex_shader_position_output_offset),
+          vertex_shader_point_size_output_offset(vertex_shader_point_size_output_offset),
           fragment_shader_function(fragment_shader_function),
+          fragment_inputs(std::move(fragment_inputs)),
+          fragment_input_location_count(fragment_input_location_count),
+          color_attachment_count(color_attachment_count),
+          color_attachment_write_kinds(std::move(color_attachment_write_kinds)),
           viewport(viewport),
-          scissor_rect(scissor_rect)
+          scissor_rect(scissor_rect),
+          input_assembly_state(input_assembly_state),
+          rasterization_state(rasterization_state),
+          multisample_state(multisample_state),
+          depth_state(depth_state),
+          worker_thread_pool(worker_thread_pool)
     {
     }
 
@@ -233,9 +371,20 @@ private:
     Vertex_shader_function vertex_shader_function;
     std::size_t vertex_shader_output_struct_size;
     std::size_t vertex_shader_position_output_offset;
+    /** empty when the vertex shader doesn't write PointSize */
+    util::optional<std::size_t> vertex_shader_point_size_output_offset;
     Fragment_shader_function fragment_shader_function;
+    std::vector<Fragment_input> fragment_inputs;
+    std::size_t fragment_input_location_count;
+    std::size_t color_attachment_count;
+    std::vector<Color_attachment_write_kind> color_attachment_write_kinds;
     VkViewport viewport;
     VkRect2D scissor_rect;
+    Input_assembly_state input_assembly_state;
+    Rasterization_state rasterization_state;
+    Multisample_state multisample_state;
+    Depth_state depth_state;
+    util::Thread_pool &worker_thread_pool;
 };
 
 using vulkan::move_to_handle;
@@ -0,0 +1,564 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "rasterizer.h"
+#include "util/bit_intrinsics.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIPELINE_RASTERIZER_HAS_X86_KERNELS 1
+#else
+#define PIPELINE_RASTERIZER_HAS_X86_KERNELS 0
+#endif
+
+namespace kazan
+{
+namespace pipeline
+{
+namespace
+{
+Block_coverage_mask compute_block_coverage_generic(const Edge_equation *edge_equations,
+                                                   std::int32_t block_x,
+                                                   std::int32_t block_y)
+{
+    Block_coverage_mask retval = 0;
+    Edge_equation::Integer_type row_values[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+        row_values[i] = edge_equations[i].evaluate(block_x, block_y);
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        for(std::int32_t x = 0; x < block_size; x++)
+        {
+            bool inside = true;
+            for(std::size_t i = 0; i < triangle_edge_count; i++)
+                inside &= row_values[i] + edge_equations[i].a * x >= 0;
+            if(inside)
+                retval |= 1ULL << (x + y * block_size);
+        }
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            row_values[i] += edge_equations[i].b;
+    }
+    return retval;
+}
+
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+// The x86 kernels OR the edge values of all the edges together: the sign bit of the result is
+// set when any of the edges has a negative value, meaning the pixel is outside.
+
+__attribute__((target("sse2"))) Block_coverage_mask compute_block_coverage_sse2(
+    const Edge_equation *edge_equations, std::int32_t block_x, std::int32_t block_y)
+{
+    constexpr std::size_t lane_count = 2;
+    constexpr std::size_t vector_count = block_size / lane_count;
+    __m128i values[triangle_edge_count][vector_count];
+    __m128i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        auto a = edge_equations[i].a;
+        auto value = edge_equations[i].evaluate(block_x, block_y);
+        for(std::size_t j = 0; j < vector_count; j++)
+            values[i][j] = _mm_set_epi64x(value + a * static_cast<std::int64_t>(j * lane_count + 1),
+                                          value + a * static_cast<std::int64_t>(j * lane_count));
+        row_steps[i] = _mm_set1_epi64x(edge_equations[i].b);
+    }
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        unsigned outside_mask = 0;
+        for(std::size_t j = 0; j < vector_count; j++)
+        {
+            __m128i combined = _mm_or_si128(_mm_or_si128(values[0][j], values[1][j]), values[2][j]);
+            outside_mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(combined)))
+                            << (j * lane_count);
+        }
+        retval |= static_cast<Block_coverage_mask>(~outside_mask & 0xFFU) << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            for(std::size_t j = 0; j < vector_count; j++)
+                values[i][j] = _mm_add_epi64(values[i][j], row_steps[i]);
+    }
+    return retval;
+}
+
+__attribute__((target("avx2"))) Block_coverage_mask compute_block_coverage_avx2(
+    const Edge_equation *edge_equations, std::int32_t block_x, std::int32_t block_y)
+{
+    constexpr std::size_t lane_count = 4;
+    constexpr std::size_t vector_count = block_size / lane_count;
+    __m256i values[triangle_edge_count][vector_count];
+    __m256i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        auto a = edge_equations[i].a;
+        auto value = edge_equations[i].evaluate(block_x, block_y);
+        for(std::size_t j = 0; j < vector_count; j++)
+        {
+            auto lane_0_value = value + a * static_cast<std::int64_t>(j * lane_count);
+            values[i][j] = _mm256_set_epi64x(
+                lane_0_value + 3 * a, lane_0_value + 2 * a, lane_0_value + a, lane_0_value);
+        }
+        row_steps[i] = _mm256_set1_epi64x(edge_equations[i].b);
+    }
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        unsigned outside_mask = 0;
+        for(std::size_t j = 0; j < vector_count; j++)
+        {
+            __m256i combined =
+                _mm256_or_si256(_mm256_or_si256(values[0][j], values[1][j]), values[2][j]);
+            outside_mask |=
+                static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(combined)))
+                << (j * lane_count);
+        }
+        retval |= static_cast<Block_coverage_mask>(~outside_mask & 0xFFU) << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            for(std::size_t j = 0; j < vector_count; j++)
+                values[i][j] = _mm256_add_epi64(values[i][j], row_steps[i]);
+    }
+    return retval;
+}
+
+__attribute__((target("avx512f"))) Block_coverage_mask compute_block_coverage_avx512f(
+    const Edge_equation *edge_equations, std::int32_t block_x, std::int32_t block_y)
+{
+    static_assert(block_size == 8, "one 8-lane vector per row");
+    __m512i values[triangle_edge_count];
+    __m512i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        auto a = edge_equations[i].a;
+        auto value = edge_equations[i].evaluate(block_x, block_y);
+        values[i] = _mm512_set_epi64(value + 7 * a,
+                                     value + 6 * a,
+                                     value + 5 * a,
+                                     value + 4 * a,
+                                     value + 3 * a,
+                                     value + 2 * a,
+                                     value + a,
+                                     value);
+        row_steps[i] = _mm512_set1_epi64(edge_equations[i].b);
+    }
+    const __m512i zero = _mm512_setzero_si512();
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        __m512i combined = _mm512_or_si512(_mm512_or_si512(values[0], values[1]), values[2]);
+        retval |= static_cast<Block_coverage_mask>(_mm512_cmpge_epi64_mask(combined, zero))
+                  << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            values[i] = _mm512_add_epi64(values[i], row_steps[i]);
+    }
+    return retval;
+}
+#endif
+
+Block_coverage_mask compute_narrow_block_coverage_generic(
+    const Narrow_edge_equation *edge_equations)
+{
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        for(std::int32_t x = 0; x < block_size; x++)
+        {
+            bool inside = true;
+            for(std::size_t i = 0; i < triangle_edge_count; i++)
+                inside &= edge_equations[i].value
+                              + (edge_equations[i].a * x + edge_equations[i].b * y)
+                          >= 0;
+            if(inside)
+                retval |= 1ULL << (x + y * block_size);
+        }
+    }
+    return retval;
+}
+
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+// The narrow kernels use wrapping 32-bit adds, so stepping past the end of the block doesn't
+// matter.
+
+__attribute__((target("sse2"))) Block_coverage_mask compute_narrow_block_coverage_sse2(
+    const Narrow_edge_equation *edge_equations)
+{
+    constexpr std::size_t lane_count = 4;
+    constexpr std::size_t vector_count = block_size / lane_count;
+    __m128i values[triangle_edge_count][vector_count];
+    __m128i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        auto a = edge_equations[i].a;
+        auto value = edge_equations[i].value;
+        for(std::size_t j = 0; j < vector_count; j++)
+        {
+            auto lane_0_value = value + a * static_cast<std::int32_t>(j * lane_count);
+            values[i][j] = _mm_set_epi32(
+                lane_0_value + 3 * a, lane_0_value + 2 * a, lane_0_value + a, lane_0_value);
+        }
+        row_steps[i] = _mm_set1_epi32(edge_equations[i].b);
+    }
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        unsigned outside_mask = 0;
+        for(std::size_t j = 0; j < vector_count; j++)
+        {
+            __m128i combined = _mm_or_si128(_mm_or_si128(values[0][j], values[1][j]), values[2][j]);
+            outside_mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(combined)))
+                            << (j * lane_count);
+        }
+        retval |= static_cast<Block_coverage_mask>(~outside_mask & 0xFFU) << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            for(std::size_t j = 0; j < vector_count; j++)
+                values[i][j] = _mm_add_epi32(values[i][j], row_steps[i]);
+    }
+    return retval;
+}
+
+__attribute__((target("avx2"))) Block_coverage_mask compute_narrow_block_coverage_avx2(
+    const Narrow_edge_equation *edge_equations)
+{
+    static_assert(block_size == 8, "one 8-lane vector per row");
+    const __m256i lane_x = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i values[triangle_edge_count];
+    __m256i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        values[i] =
+            _mm256_add_epi32(_mm256_set1_epi32(edge_equations[i].value),
+                             _mm256_mullo_epi32(_mm256_set1_epi32(edge_equations[i].a), lane_x));
+        row_steps[i] = _mm256_set1_epi32(edge_equations[i].b);
+    }
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y++)
+    {
+        __m256i combined = _mm256_or_si256(_mm256_or_si256(values[0], values[1]), values[2]);
+        auto outside_mask =
+            static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(combined)));
+        retval |= static_cast<Block_coverage_mask>(~outside_mask & 0xFFU) << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            values[i] = _mm256_add_epi32(values[i], row_steps[i]);
+    }
+    return retval;
+}
+
+__attribute__((target("avx512f"))) Block_coverage_mask compute_narrow_block_coverage_avx512f(
+    const Narrow_edge_equation *edge_equations)
+{
+    static_assert(block_size == 8, "one 16-lane vector per two rows");
+    const __m512i lane_x = _mm512_set_epi32(7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i lane_y = _mm512_set_epi32(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m512i values[triangle_edge_count];
+    __m512i row_steps[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        __m512i b = _mm512_set1_epi32(edge_equations[i].b);
+        values[i] = _mm512_add_epi32(
+            _mm512_set1_epi32(edge_equations[i].value),
+            _mm512_add_epi32(_mm512_mullo_epi32(_mm512_set1_epi32(edge_equations[i].a), lane_x),
+                             _mm512_mullo_epi32(b, lane_y)));
+        row_steps[i] = _mm512_add_epi32(b, b);
+    }
+    const __m512i zero = _mm512_setzero_si512();
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = 0; y < block_size; y += 2)
+    {
+        __m512i combined = _mm512_or_si512(_mm512_or_si512(values[0], values[1]), values[2]);
+        retval |= static_cast<Block_coverage_mask>(_mm512_cmpge_epi32_mask(combined, zero))
+                  << (y * block_size);
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+            values[i] = _mm512_add_epi32(values[i], row_steps[i]);
+    }
+    return retval;
+}
+#endif
+
+void compute_small_triangle_coverage_generic(const Small_triangle_batch &batch,
+                                             std::size_t triangle_count,
+                                             const Sample_position *sample_positions,
+                                             std::uint32_t sample_mask,
+                                             Small_triangle_coverage_mask *coverage_masks)
+{
+    for(std::size_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        Small_triangle_coverage_mask coverage_mask = 0;
+        for(std::uint32_t samples = sample_mask; samples; samples &= samples - 1)
+        {
+            auto sample = util::ctz32(samples);
+            Edge_equation sample_edge_equations[triangle_edge_count];
+            for(std::size_t i = 0; i < triangle_edge_count; i++)
+                sample_edge_equations[i] =
+                    Edge_equation(batch.a[i][triangle], batch.b[i][triangle], batch.c[i][triangle])
+                        .get_sample_equation(sample_positions[sample]);
+            for(std::int32_t y = 0; y < small_triangle_size; y++)
+            {
+                for(std::int32_t x = 0; x < small_triangle_size; x++)
+                {
+                    bool inside = true;
+                    for(std::size_t i = 0; i < triangle_edge_count; i++)
+                        inside &= sample_edge_equations[i].inside(x, y);
+                    if(inside)
+                        coverage_mask |= 1UL << get_small_triangle_coverage_bit(x, y, sample);
+                }
+            }
+        }
+        coverage_masks[triangle] = coverage_mask;
+    }
+}
+
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+// The small triangle kernels compute the same edge of several triangles in each vector. The
+// offset of a sample from the pixel center is (a / sample_position_scale) * sample_x +
+// (b / sample_position_scale) * sample_y; a and b are multiples of sample_position_scale, and
+// the quotients fit in 32 bits, so the offsets can use the 32 by 32 bit signed multiplies.
+static_assert(sample_position_scale == 1 << 4, "");
+static_assert(small_triangle_size == 2, "the kernels test 2 by 2 pixels");
+
+__attribute__((target("avx2"))) void compute_small_triangle_coverage_avx2(
+    const Small_triangle_batch &batch,
+    std::size_t triangle_count,
+    const Sample_position *sample_positions,
+    std::uint32_t sample_mask,
+    Small_triangle_coverage_mask *coverage_masks)
+{
+    constexpr std::size_t lane_count = 4;
+    const __m256i zero = _mm256_setzero_si256();
+    for(std::size_t start = 0; start < triangle_count; start += lane_count)
+    {
+        __m256i a[triangle_edge_count];
+        __m256i b[triangle_edge_count];
+        __m256i c[triangle_edge_count];
+        __m256i scaled_a[triangle_edge_count];
+        __m256i scaled_b[triangle_edge_count];
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+        {
+            a[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&batch.a[i][start]));
+            b[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&batch.b[i][start]));
+            c[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&batch.c[i][start]));
+            // the low 32 bits are the same for logical and arithmetic shifts
+            scaled_a[i] = _mm256_srli_epi64(a[i], 4);
+            scaled_b[i] = _mm256_srli_epi64(b[i], 4);
+        }
+        __m256i coverage = zero;
+        for(std::uint32_t samples = sample_mask; samples; samples &= samples - 1)
+        {
+            auto sample = util::ctz32(samples);
+            __m256i sample_x =
+                _mm256_set1_epi64x(sample_positions[sample].x - sample_position_scale / 2);
+            __m256i sample_y =
+                _mm256_set1_epi64x(sample_positions[sample].y - sample_position_scale / 2);
+            // the edge values of pixels (0, 0), (1, 0), (0, 1), and (1, 1)
+            __m256i combined[small_triangle_size * small_triangle_size] = {zero, zero, zero, zero};
+            for(std::size_t i = 0; i < triangle_edge_count; i++)
+            {
+                __m256i value = _mm256_add_epi64(
+                    c[i],
+                    _mm256_add_epi64(_mm256_mul_epi32(scaled_a[i], sample_x),
+                                     _mm256_mul_epi32(scaled_b[i], sample_y)));
+                combined[0] = _mm256_or_si256(combined[0], value);
+                combined[1] = _mm256_or_si256(combined[1], _mm256_add_epi64(value, a[i]));
+                value = _mm256_add_epi64(value, b[i]);
+                combined[2] = _mm256_or_si256(combined[2], value);
+                combined[3] = _mm256_or_si256(combined[3], _mm256_add_epi64(value, a[i]));
+            }
+            for(std::int32_t pixel = 0; pixel < small_triangle_size * small_triangle_size;
+                pixel++)
+            {
+                __m256i outside = _mm256_cmpgt_epi64(zero, combined[pixel]);
+                __m256i bit = _mm256_set1_epi64x(1LL << get_small_triangle_coverage_bit(
+                                                     pixel % small_triangle_size,
+                                                     pixel / small_triangle_size,
+                                                     sample));
+                coverage = _mm256_or_si256(coverage, _mm256_andnot_si256(outside, bit));
+            }
+        }
+        alignas(__m256i) std::uint64_t lanes[lane_count];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), coverage);
+        for(std::size_t lane = 0; lane < lane_count; lane++)
+            coverage_masks[start + lane] = lanes[lane];
+    }
+}
+
+__attribute__((target("avx512f"))) void compute_small_triangle_coverage_avx512f(
+    const Small_triangle_batch &batch,
+    std::size_t triangle_count,
+    const Sample_position *sample_positions,
+    std::uint32_t sample_mask,
+    Small_triangle_coverage_mask *coverage_masks)
+{
+    static_assert(small_triangle_batch_size == 8, "one 8-lane vector per batch");
+    static_cast<void>(triangle_count);
+    __m512i a[triangle_edge_count];
+    __m512i b[triangle_edge_count];
+    __m512i c[triangle_edge_count];
+    __m512i scaled_a[triangle_edge_count];
+    __m512i scaled_b[triangle_edge_count];
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        a[i] = _mm512_loadu_si512(batch.a[i]);
+        b[i] = _mm512_loadu_si512(batch.b[i]);
+        c[i] = _mm512_loadu_si512(batch.c[i]);
+        scaled_a[i] = _mm512_srai_epi64(a[i], 4);
+        scaled_b[i] = _mm512_srai_epi64(b[i], 4);
+    }
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i coverage = zero;
+    for(std::uint32_t samples = sample_mask; samples; samples &= samples - 1)
+    {
+        auto sample = util::ctz32(samples);
+        __m512i sample_x =
+            _mm512_set1_epi64(sample_positions[sample].x - sample_position_scale / 2);
+        __m512i sample_y =
+            _mm512_set1_epi64(sample_positions[sample].y - sample_position_scale / 2);
+        __m512i combined[small_triangle_size * small_triangle_size] = {zero, zero, zero, zero};
+        for(std::size_t i = 0; i < triangle_edge_count; i++)
+        {
+            __m512i value = _mm512_add_epi64(
+                c[i],
+                _mm512_add_epi64(_mm512_mul_epi32(scaled_a[i], sample_x),
+                                 _mm512_mul_epi32(scaled_b[i], sample_y)));
+            combined[0] = _mm512_or_si512(combined[0], value);
+            combined[1] = _mm512_or_si512(combined[1], _mm512_add_epi64(value, a[i]));
+            value = _mm512_add_epi64(value, b[i]);
+            combined[2] = _mm512_or_si512(combined[2], value);
+            combined[3] = _mm512_or_si512(combined[3], _mm512_add_epi64(value, a[i]));
+        }
+        for(std::int32_t pixel = 0; pixel < small_triangle_size * small_triangle_size; pixel++)
+        {
+            __m512i bit = _mm512_set1_epi64(
+                1LL << get_small_triangle_coverage_bit(
+                    pixel % small_triangle_size, pixel / small_triangle_size, sample));
+            coverage = _mm512_mask_or_epi64(
+                coverage, _mm512_cmpge_epi64_mask(combined[pixel], zero), coverage, bit);
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(coverage_masks),
+                        _mm512_cvtepi64_epi32(coverage));
+}
+#endif
+}
+
+const Sample_position *get_standard_sample_positions(std::uint32_t sample_count) noexcept
+{
+    static constexpr Sample_position sample_positions_1[] = {
+        {8, 8},
+    };
+    static constexpr Sample_position sample_positions_2[] = {
+        {12, 12}, {4, 4},
+    };
+    static constexpr Sample_position sample_positions_4[] = {
+        {6, 2}, {14, 6}, {2, 10}, {10, 14},
+    };
+    static constexpr Sample_position sample_positions_8[] = {
+        {9, 5}, {7, 11}, {13, 9}, {5, 3}, {3, 13}, {1, 7}, {11, 15}, {15, 1},
+    };
+    static_assert(sizeof(sample_positions_8) / sizeof(sample_positions_8[0]) == max_sample_count,
+                  "");
+    switch(sample_count)
+    {
+    case 1:
+        return sample_positions_1;
+    case 2:
+        return sample_positions_2;
+    case 4:
+        return sample_positions_4;
+    case 8:
+        return sample_positions_8;
+    }
+    assert(!"unsupported sample count");
+    return sample_positions_1;
+}
+
+const Block_coverage_kernel &Block_coverage_kernel::get() noexcept
+{
+    static const Block_coverage_kernel retval = []() noexcept->Block_coverage_kernel
+    {
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f"))
+            return Block_coverage_kernel{
+                .function = compute_block_coverage_avx512f, .name = "avx512f",
+            };
+        if(__builtin_cpu_supports("avx2"))
+            return Block_coverage_kernel{
+                .function = compute_block_coverage_avx2, .name = "avx2",
+            };
+        if(__builtin_cpu_supports("sse2"))
+            return Block_coverage_kernel{
+                .function = compute_block_coverage_sse2, .name = "sse2",
+            };
+#endif
+        return Block_coverage_kernel{
+            .function = compute_block_coverage_generic, .name = "generic",
+        };
+    }();
+    return retval;
+}
+
+const Narrow_block_coverage_kernel &Narrow_block_coverage_kernel::get() noexcept
+{
+    static const Narrow_block_coverage_kernel retval = []() noexcept->Narrow_block_coverage_kernel
+    {
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f"))
+            return Narrow_block_coverage_kernel{
+                .function = compute_narrow_block_coverage_avx512f, .name = "avx512f",
+            };
+        if(__builtin_cpu_supports("avx2"))
+            return Narrow_block_coverage_kernel{
+                .function = compute_narrow_block_coverage_avx2, .name = "avx2",
+            };
+        if(__builtin_cpu_supports("sse2"))
+            return Narrow_block_coverage_kernel{
+                .function = compute_narrow_block_coverage_sse2, .name = "sse2",
+            };
+#endif
+        return Narrow_block_coverage_kernel{
+            .function = compute_narrow_block_coverage_generic, .name = "generic",
+        };
+    }();
+    return retval;
+}
+
+const Small_triangle_coverage_kernel &Small_triangle_coverage_kernel::get() noexcept
+{
+    static const Small_triangle_coverage_kernel retval = []() noexcept
+        ->Small_triangle_coverage_kernel
+    {
+#if PIPELINE_RASTERIZER_HAS_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f"))
+            return Small_triangle_coverage_kernel{
+                .function = compute_small_triangle_coverage_avx512f, .name = "avx512f",
+            };
+        if(__builtin_cpu_supports("avx2"))
+            return Small_triangle_coverage_kernel{
+                .function = compute_small_triangle_coverage_avx2, .name = "avx2",
+            };
+#endif
+        return Small_triangle_coverage_kernel{
+            .function = compute_small_triangle_coverage_generic, .name = "generic",
+        };
+    }();
+    return retval;
+}
+}
+}
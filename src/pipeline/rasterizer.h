@@ -0,0 +1,374 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef PIPELINE_RASTERIZER_H_
+#define PIPELINE_RASTERIZER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include "vulkan/vulkan.h"
+#include "vulkan/remove_xlib_macros.h"
+
+namespace kazan
+{
+namespace pipeline
+{
+/** the largest supported number of samples per pixel */
+constexpr std::uint32_t max_sample_count = 8;
+
+/** sample positions are in units of 1 / sample_position_scale pixels */
+constexpr std::int32_t sample_position_scale = 16;
+
+/** the position of a sample relative to the top-left corner of its pixel */
+struct Sample_position
+{
+    std::int32_t x;
+    std::int32_t y;
+};
+
+/** returns the Vulkan standard sample positions for sample_count samples per pixel; sample_count
+ * is 1, 2, 4, or 8 */
+const Sample_position *get_standard_sample_positions(std::uint32_t sample_count) noexcept;
+
+/** the largest point size and line width; the same as the pointSizeRange and lineWidthRange
+ * limits */
+constexpr float max_point_size = 64;
+constexpr float max_line_width = 64;
+
+/** equation for the line at one of the edges of a triangle.
+ * A pixel is inside the edge when a * x + b * y + c >= 0. */
+struct Edge_equation
+{
+    typedef std::int64_t Integer_type;
+    Integer_type a;
+    Integer_type b;
+    Integer_type c;
+    Integer_type padding;
+    constexpr Edge_equation() noexcept : a(), b(), c(), padding()
+    {
+    }
+    constexpr Edge_equation(Integer_type a, Integer_type b, Integer_type c) noexcept : a(a),
+                                                                                       b(b),
+                                                                                       c(c),
+                                                                                       padding()
+    {
+    }
+    constexpr Integer_type evaluate(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return a * x + b * y + c;
+    }
+    constexpr bool inside(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return evaluate(x, y) >= 0;
+    }
+    /** returns the equation that tests the sample at sample_position of each pixel instead of
+     * the pixel center. a and b are multiples of sample_position_scale, since they are set up
+     * from fixed-point coordinates, so the result is exact. */
+    constexpr Edge_equation get_sample_equation(Sample_position sample_position) const noexcept
+    {
+        return Edge_equation(a,
+                             b,
+                             c + a / sample_position_scale
+                                     * (sample_position.x - sample_position_scale / 2)
+                                 + b / sample_position_scale
+                                       * (sample_position.y - sample_position_scale / 2));
+    }
+    /** the equation is linear, so its minimum over a size by size pixel square is at one of the
+     * square's corners */
+    constexpr Integer_type get_square_min(std::int32_t x, std::int32_t y, std::int32_t size) const
+        noexcept
+    {
+        return evaluate(a < 0 ? x + size - 1 : x, b < 0 ? y + size - 1 : y);
+    }
+    constexpr Integer_type get_square_max(std::int32_t x, std::int32_t y, std::int32_t size) const
+        noexcept
+    {
+        return evaluate(a < 0 ? x : x + size - 1, b < 0 ? y : y + size - 1);
+    }
+};
+
+constexpr std::size_t triangle_edge_count = 3;
+
+/** equation for a value that varies linearly in screen space across a triangle.
+ * evaluate(x, y) returns the value at the center of pixel (x, y). */
+struct Plane_equation
+{
+    float a;
+    float b;
+    float c;
+    constexpr Plane_equation() noexcept : a(), b(), c()
+    {
+    }
+    constexpr Plane_equation(float a, float b, float c) noexcept : a(a), b(b), c(c)
+    {
+    }
+    constexpr float evaluate(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return a * x + b * y + c;
+    }
+    /** returns the difference between the value at sample_position of a pixel and the value at
+     * the pixel's center */
+    constexpr float get_sample_offset(Sample_position sample_position) const noexcept
+    {
+        return (a * (sample_position.x - sample_position_scale / 2)
+                + b * (sample_position.y - sample_position_scale / 2))
+               * (1.0f / sample_position_scale);
+    }
+    /** solves for the plane going through (x0, y0, v0), (x1, y1, v1), and (x2, y2, v2); the
+     * vertex positions are in framebuffer coordinates. The triangle must not have zero area. */
+    static Plane_equation solve(float x0,
+                                float y0,
+                                float v0,
+                                float x1,
+                                float y1,
+                                float v1,
+                                float x2,
+                                float y2,
+                                float v2) noexcept
+    {
+        float dx1 = x1 - x0;
+        float dy1 = y1 - y0;
+        float dv1 = v1 - v0;
+        float dx2 = x2 - x0;
+        float dy2 = y2 - y0;
+        float dv2 = v2 - v0;
+        float inverse_area = 1.0f / (dx1 * dy2 - dx2 * dy1);
+        float a = (dv1 * dy2 - dv2 * dy1) * inverse_area;
+        float b = (dv2 * dx1 - dv1 * dx2) * inverse_area;
+        // offset to evaluate at the pixel center
+        float c = v0 - a * (x0 - 0.5f) - b * (y0 - 0.5f);
+        return Plane_equation(a, b, c);
+    }
+};
+
+/** returns the result of the depth test: if a fragment with fragment_depth passes when the depth
+ * attachment contains attachment_depth */
+constexpr bool compare_depth(VkCompareOp compare_op,
+                             float fragment_depth,
+                             float attachment_depth) noexcept
+{
+    switch(compare_op)
+    {
+    case VK_COMPARE_OP_NEVER:
+        return false;
+    case VK_COMPARE_OP_LESS:
+        return fragment_depth < attachment_depth;
+    case VK_COMPARE_OP_EQUAL:
+        return fragment_depth == attachment_depth;
+    case VK_COMPARE_OP_LESS_OR_EQUAL:
+        return fragment_depth <= attachment_depth;
+    case VK_COMPARE_OP_GREATER:
+        return fragment_depth > attachment_depth;
+    case VK_COMPARE_OP_NOT_EQUAL:
+        return fragment_depth != attachment_depth;
+    case VK_COMPARE_OP_GREATER_OR_EQUAL:
+        return fragment_depth >= attachment_depth;
+    case VK_COMPARE_OP_ALWAYS:
+        return true;
+    case VK_COMPARE_OP_RANGE_SIZE:
+    case VK_COMPARE_OP_MAX_ENUM:
+        break;
+    }
+    assert(!"invalid compare op");
+    return false;
+}
+
+enum class Coverage_classification
+{
+    Outside,
+    Partial,
+    Inside,
+};
+
+/** classifies the size by size pixel square at (x, y) against a triangle by testing each edge at
+ * the square's corners, without looking at individual pixels */
+constexpr Coverage_classification classify_square(const Edge_equation *edge_equations,
+                                                  std::int32_t x,
+                                                  std::int32_t y,
+                                                  std::int32_t size) noexcept
+{
+    bool inside = true;
+    for(std::size_t i = 0; i < triangle_edge_count; i++)
+    {
+        if(edge_equations[i].get_square_max(x, y, size) < 0)
+            return Coverage_classification::Outside;
+        if(edge_equations[i].get_square_min(x, y, size) < 0)
+            inside = false;
+    }
+    return inside ? Coverage_classification::Inside : Coverage_classification::Partial;
+}
+
+/** pixel blocks are block_size by block_size pixels, aligned to multiples of block_size.
+ * Bit (x + y * block_size) of a Block_coverage_mask is set when pixel
+ * (block_x + x, block_y + y) is covered. */
+constexpr std::int32_t log2_block_size = 3;
+constexpr std::int32_t block_size = 1 << log2_block_size;
+typedef std::uint64_t Block_coverage_mask;
+static_assert(block_size * block_size == sizeof(Block_coverage_mask) * 8, "");
+
+/** returns the mask of the pixels in the rectangle [min_x, end_x) by [min_y, end_y), with
+ * coordinates relative to the block. The rectangle is clamped to the block. */
+constexpr Block_coverage_mask get_block_rectangle_mask(std::int32_t min_x,
+                                                       std::int32_t min_y,
+                                                       std::int32_t end_x,
+                                                       std::int32_t end_y) noexcept
+{
+    if(min_x < 0)
+        min_x = 0;
+    if(min_y < 0)
+        min_y = 0;
+    if(end_x > block_size)
+        end_x = block_size;
+    if(end_y > block_size)
+        end_y = block_size;
+    if(min_x >= end_x || min_y >= end_y)
+        return 0;
+    Block_coverage_mask row_mask = (1ULL << end_x) - (1ULL << min_x);
+    Block_coverage_mask retval = 0;
+    for(std::int32_t y = min_y; y < end_y; y++)
+        retval |= row_mask << (y * block_size);
+    return retval;
+}
+
+/** computes the coverage mask of the block at (block_x, block_y) for a triangle described by
+ * triangle_edge_count edge equations */
+struct Block_coverage_kernel
+{
+    typedef Block_coverage_mask (*Function)(const Edge_equation *edge_equations,
+                                            std::int32_t block_x,
+                                            std::int32_t block_y);
+    Function function;
+    const char *name;
+    /** returns the fastest kernel that the running cpu supports */
+    static const Block_coverage_kernel &get() noexcept;
+};
+
+/** an edge equation narrowed to 32 bits for one block, so the coverage kernels fit twice as many
+ * pixels in each vector. value is the equation's value at the block's first pixel. */
+struct Narrow_edge_equation
+{
+    std::int32_t a;
+    std::int32_t b;
+    std::int32_t value;
+    std::int32_t padding;
+};
+
+/** an edge with a and b at most max_narrow_edge_coefficient in magnitude can be narrowed for the
+ * blocks it crosses: the values in the block are between the values at the block's corners, one
+ * of which is negative and one not, and those are (block_size - 1) * (|a| + |b|) apart, so they
+ * fit in 32 bits. The vector kernels can step past the block, where the values wrap around, but
+ * those values aren't used. */
+constexpr Edge_equation::Integer_type max_narrow_edge_coefficient = 1LL << 27;
+static_assert(2 * (block_size - 1) * max_narrow_edge_coefficient < 1LL << 31, "");
+
+constexpr bool can_narrow_edge_equation(const Edge_equation &edge_equation) noexcept
+{
+    return edge_equation.a >= -max_narrow_edge_coefficient
+           && edge_equation.a <= max_narrow_edge_coefficient
+           && edge_equation.b >= -max_narrow_edge_coefficient
+           && edge_equation.b <= max_narrow_edge_coefficient;
+}
+
+/** narrows edge_equation, which can_narrow_edge_equation, for the block at (block_x, block_y);
+ * returns false when the block is entirely outside the edge. An edge that the block is entirely
+ * inside is replaced by an equation that is 0 everywhere, so it doesn't need to fit. */
+inline bool narrow_edge_equation(const Edge_equation &edge_equation,
+                                 std::int32_t block_x,
+                                 std::int32_t block_y,
+                                 Narrow_edge_equation &narrow_edge_equation) noexcept
+{
+    assert(can_narrow_edge_equation(edge_equation));
+    narrow_edge_equation = Narrow_edge_equation{
+        .a = 0, .b = 0, .value = 0, .padding = 0,
+    };
+    if(edge_equation.get_square_min(block_x, block_y, block_size) >= 0)
+        return true;
+    if(edge_equation.get_square_max(block_x, block_y, block_size) < 0)
+        return false;
+    narrow_edge_equation.a = static_cast<std::int32_t>(edge_equation.a);
+    narrow_edge_equation.b = static_cast<std::int32_t>(edge_equation.b);
+    narrow_edge_equation.value =
+        static_cast<std::int32_t>(edge_equation.evaluate(block_x, block_y));
+    return true;
+}
+
+/** Block_coverage_kernel for triangle_edge_count narrowed edge equations of the same block */
+struct Narrow_block_coverage_kernel
+{
+    typedef Block_coverage_mask (*Function)(const Narrow_edge_equation *edge_equations);
+    Function function;
+    const char *name;
+    /** returns the fastest kernel that the running cpu supports */
+    static const Narrow_block_coverage_kernel &get() noexcept;
+};
+
+/** triangles with a bounding box of at most small_triangle_size by small_triangle_size pixels
+ * are small triangles: they skip the hierarchical coverage tests, and only the samples of the
+ * candidate pixels in their bounding box are tested, for small_triangle_batch_size triangles at
+ * a time */
+constexpr std::int32_t small_triangle_size = 2;
+constexpr std::size_t small_triangle_batch_size = 8;
+
+/** bit get_small_triangle_coverage_bit(x, y, sample) of a Small_triangle_coverage_mask is set
+ * when sample is covered in pixel (x, y) relative to the small triangle's origin */
+typedef std::uint32_t Small_triangle_coverage_mask;
+constexpr std::uint32_t get_small_triangle_coverage_bit(std::int32_t x,
+                                                        std::int32_t y,
+                                                        std::uint32_t sample) noexcept
+{
+    return x + (y + sample * small_triangle_size) * small_triangle_size;
+}
+static_assert(small_triangle_size * small_triangle_size * max_sample_count
+                  <= sizeof(Small_triangle_coverage_mask) * 8,
+              "");
+
+/** the edge equations of a batch of small triangles, with c moved to each triangle's origin. The
+ * equations are stored by edge, so the kernels can load the same edge of several triangles as
+ * one vector. */
+struct Small_triangle_batch
+{
+    Edge_equation::Integer_type a[triangle_edge_count][small_triangle_batch_size];
+    Edge_equation::Integer_type b[triangle_edge_count][small_triangle_batch_size];
+    Edge_equation::Integer_type c[triangle_edge_count][small_triangle_batch_size];
+};
+
+/** computes the coverage mask of the first triangle_count triangles in batch at the samples in
+ * sample_mask. coverage_masks has room for small_triangle_batch_size masks; the masks after
+ * triangle_count are unspecified. The triangles' a and b divided by sample_position_scale must
+ * fit in 32 bits, which they do for small triangles. */
+struct Small_triangle_coverage_kernel
+{
+    typedef void (*Function)(const Small_triangle_batch &batch,
+                             std::size_t triangle_count,
+                             const Sample_position *sample_positions,
+                             std::uint32_t sample_mask,
+                             Small_triangle_coverage_mask *coverage_masks);
+    Function function;
+    const char *name;
+    /** returns the fastest kernel that the running cpu supports */
+    static const Small_triangle_coverage_kernel &get() noexcept;
+};
+}
+}
+
+#endif // PIPELINE_RASTERIZER_H_
@@ -21,6 +21,9 @@
  *
  */
 #include "spirv_to_llvm_implementation.h"
+#include "vulkan/color_format.h"
+#include <algorithm>
+#include <cmath>
 
 namespace kazan
 {
@@ -31,16 +34,27 @@ using namespace spirv;
 ::LLVMValueRef Spirv_to_llvm::generate_fragment_entry_function(Op_entry_point_state &entry_point,
                                                                ::LLVMValueRef main_function)
 {
-    typedef std::uint32_t Pixel_type;
-    auto llvm_pixel_type = llvm_wrapper::Create_llvm_type<Pixel_type>()(context);
     auto llvm_float_type = llvm_wrapper::Create_llvm_type<float>()(context);
     auto llvm_u8_type = llvm_wrapper::Create_llvm_type<std::uint8_t>()(context);
+    auto llvm_i32_type = llvm_wrapper::Create_llvm_type<std::uint32_t>()(context);
     auto llvm_vec4_type = ::LLVMVectorType(llvm_float_type, 4);
-    auto llvm_u8vec4_type = ::LLVMVectorType(llvm_u8_type, 4);
-    static_cast<void>(llvm_pixel_type);
-    typedef void (*Fragment_shader_function)(Pixel_type *color_attachment_pixel, void *uniforms);
-    constexpr std::size_t arg_color_attachment_pixel = 0;
-    constexpr std::size_t arg_uniforms = 1;
+    // the entry point shades a span of lane_count horizontally adjacent pixels per call
+    constexpr std::size_t lane_count = pipeline::Graphics_pipeline::fragment_shader_lane_count;
+    constexpr std::size_t location_component_count = 4;
+    typedef void (*Fragment_shader_function)(std::uint32_t x,
+                                             std::uint32_t y,
+                                             std::uint32_t lane_mask,
+                                             const std::uint32_t *sample_lane_masks,
+                                             const void *inputs,
+                                             void *uniforms,
+                                             void *const *color_attachment_pixels);
+    constexpr std::size_t arg_x = 0;
+    constexpr std::size_t arg_y = 1;
+    constexpr std::size_t arg_lane_mask = 2;
+    constexpr std::size_t arg_sample_lane_masks = 3;
+    constexpr std::size_t arg_inputs = 4;
+    constexpr std::size_t arg_uniforms = 5;
+    constexpr std::size_t arg_color_attachment_pixels = 6;
     static_assert(std::is_same<Fragment_shader_function,
                                pipeline::Graphics_pipeline::Fragment_shader_function>::value,
                   "vertex shader function signature mismatch");
@@ -48,10 +62,20 @@ using namespace spirv;
     auto entry_function = ::LLVMAddFunction(
         module.get(), get_prefixed_name("fragment_entry_point", true).c_str(), function_type);
     llvm_wrapper::Module::set_function_target_machine(entry_function, target_machine);
-    auto color_attachment_pixel = ::LLVMGetParam(entry_function, arg_color_attachment_pixel);
-    ::LLVMSetValueName(color_attachment_pixel, "color_attachment_pixel");
+    auto x = ::LLVMGetParam(entry_function, arg_x);
+    ::LLVMSetValueName(x, "x");
+    auto y = ::LLVMGetParam(entry_function, arg_y);
+    ::LLVMSetValueName(y, "y");
+    auto lane_mask = ::LLVMGetParam(entry_function, arg_lane_mask);
+    ::LLVMSetValueName(lane_mask, "lane_mask");
+    auto sample_lane_masks = ::LLVMGetParam(entry_function, arg_sample_lane_masks);
+    ::LLVMSetValueName(sample_lane_masks, "sample_lane_masks");
+    auto inputs = ::LLVMGetParam(entry_function, arg_inputs);
+    ::LLVMSetValueName(inputs, "inputs");
     auto uniforms = ::LLVMGetParam(entry_function, arg_uniforms);
     ::LLVMSetValueName(uniforms, "uniforms");
+    auto color_attachment_pixels = ::LLVMGetParam(entry_function, arg_color_attachment_pixels);
+    ::LLVMSetValueName(color_attachment_pixels, "color_attachment_pixels");
     auto entry_block = ::LLVMAppendBasicBlockInContext(context, entry_function, "entry");
     ::LLVMPositionBuilderAtEnd(builder.get(), entry_block);
     auto io_struct_type = io_struct->get_or_make_type();
@@ -75,7 +99,64 @@ using namespace spirv;
                              io_struct->get_members(true)[outputs_member].llvm_member_index,
                              "outputs_pointer");
     ::LLVMBuildStore(builder.get(), outputs_struct_pointer, outputs_pointer);
-    ::LLVMValueRef output_color = nullptr;
+    // the output colors of all the lanes are collected here, one array for each color attachment,
+    // so they can be converted and stored with vector instructions
+    auto color_attachment_count = color_attachment_formats.size();
+    auto llvm_lane_colors_type =
+        ::LLVMArrayType(::LLVMArrayType(llvm_vec4_type, lane_count), color_attachment_count);
+    auto lane_colors_pointer =
+        ::LLVMBuildAlloca(builder.get(), llvm_lane_colors_type, "lane_colors");
+    ::LLVMBuildStore(builder.get(), ::LLVMConstNull(llvm_lane_colors_type), lane_colors_pointer);
+    // run main once for each active lane:
+    // for(lane = 0; lane < lane_count; lane++) if(lane_mask & (1 << lane)) { ... }
+    auto loop_header_block =
+        ::LLVMAppendBasicBlockInContext(context, entry_function, "lane_loop_header");
+    auto lane_active_check_block =
+        ::LLVMAppendBasicBlockInContext(context, entry_function, "lane_active_check");
+    auto lane_body_block = ::LLVMAppendBasicBlockInContext(context, entry_function, "lane_body");
+    auto loop_latch_block =
+        ::LLVMAppendBasicBlockInContext(context, entry_function, "lane_loop_latch");
+    auto exit_block = ::LLVMAppendBasicBlockInContext(context, entry_function, "exit");
+    ::LLVMBuildBr(builder.get(), loop_header_block);
+    ::LLVMPositionBuilderAtEnd(builder.get(), loop_header_block);
+    auto lane = ::LLVMBuildPhi(builder.get(), llvm_i32_type, "lane");
+    ::LLVMBuildCondBr(builder.get(),
+                      ::LLVMBuildICmp(builder.get(),
+                                      ::LLVMIntULT,
+                                      lane,
+                                      ::LLVMConstInt(llvm_i32_type, lane_count, false),
+                                      ""),
+                      lane_active_check_block,
+                      exit_block);
+    ::LLVMPositionBuilderAtEnd(builder.get(), lane_active_check_block);
+    auto lane_is_active = ::LLVMBuildICmp(
+        builder.get(),
+        ::LLVMIntNE,
+        ::LLVMBuildAnd(builder.get(),
+                       ::LLVMBuildLShr(builder.get(), lane_mask, lane, ""),
+                       ::LLVMConstInt(llvm_i32_type, 1, false),
+                       ""),
+        ::LLVMConstNull(llvm_i32_type),
+        "lane_is_active");
+    ::LLVMBuildCondBr(builder.get(), lane_is_active, lane_body_block, loop_latch_block);
+    ::LLVMPositionBuilderAtEnd(builder.get(), loop_latch_block);
+    auto next_lane = ::LLVMBuildAdd(
+        builder.get(), lane, ::LLVMConstInt(llvm_i32_type, 1, false), "next_lane");
+    ::LLVMBuildBr(builder.get(), loop_header_block);
+    {
+        constexpr std::size_t incoming_count = 2;
+        ::LLVMValueRef incoming_values[incoming_count] = {
+            ::LLVMConstNull(llvm_i32_type), next_lane,
+        };
+        ::LLVMBasicBlockRef incoming_blocks[incoming_count] = {
+            entry_block, loop_latch_block,
+        };
+        ::LLVMAddIncoming(lane, incoming_values, incoming_blocks, incoming_count);
+    }
+    ::LLVMPositionBuilderAtEnd(builder.get(), lane_body_block);
+    // the shader's output variables are written to the color attachments with the same Location;
+    // attachments without an output variable are left unchanged
+    std::vector<bool> color_attachment_is_written(color_attachment_count, false);
     std::vector<std::function<void()>> after_call_callbacks;
     auto &&members = io_struct->get_members(true);
     for(std::size_t member_index = 0; member_index < members.size(); member_index++)
@@ -90,6 +171,7 @@ using namespace spirv;
                     builder.get(), inputs_struct_pointer, input_member.llvm_member_index, "input");
                 ::LLVMDumpType(::LLVMTypeOf(input_pointer));
                 util::optional<Built_in> built_in;
+                util::optional<std::uint32_t> location;
                 static_cast<void>(input_pointer);
                 for(auto &decoration : input_member.decorations)
                 {
@@ -136,11 +218,9 @@ using namespace spirv;
                                        .built_in;
                         continue;
                     case Decoration::no_perspective:
-#warning finish implementing Decoration::no_perspective
-                        break;
                     case Decoration::flat:
-#warning finish implementing Decoration::flat
-                        break;
+                        // the rasterizer interpolates the inputs, see Graphics_pipeline::create
+                        continue;
                     case Decoration::patch:
 #warning finish implementing Decoration::patch
                         break;
@@ -184,8 +264,12 @@ using namespace spirv;
 #warning finish implementing Decoration::stream
                         break;
                     case Decoration::location:
-#warning finish implementing Decoration::location
-                        break;
+                        if(location)
+                            throw Parser_error(
+                                0, 0, "multiple Location decorations on the same variable");
+                        location = util::get<Decoration_location_parameters>(decoration.parameters)
+                                       .location;
+                        continue;
                     case Decoration::component:
 #warning finish implementing Decoration::component
                         break;
@@ -256,8 +340,72 @@ using namespace spirv;
                                            + std::string(get_enumerant_name(decoration.value)));
                 }
                 if(!built_in)
-                    throw Parser_error(
-                        0, 0, "non-built-in shader input variables are not implemented");
+                {
+                    if(!location)
+                        throw Parser_error(
+                            0,
+                            0,
+                            "non-built-in shader input variable is missing Location decoration");
+                    // the interpolated inputs are passed in as 4 32-bit components for each
+                    // Location, each component being an array with an element for each lane
+                    auto input_type = input_member.type->get_or_make_type();
+                    auto input_element_type = input_type.type;
+                    std::size_t input_component_count = 1;
+                    if(::LLVMGetTypeKind(input_type.type) == ::LLVMVectorTypeKind)
+                    {
+                        input_element_type = ::LLVMGetElementType(input_type.type);
+                        input_component_count = ::LLVMGetVectorSize(input_type.type);
+                    }
+                    if((input_element_type != llvm_float_type
+                        && input_element_type != ::LLVMInt32TypeInContext(context))
+                       || input_component_count > location_component_count)
+                        throw Parser_error(
+                            0, 0, "fragment shader input variable type is unimplemented");
+                    constexpr unsigned default_address_space = 0;
+                    auto input_elements_pointer = ::LLVMBuildBitCast(
+                        builder.get(),
+                        inputs,
+                        ::LLVMPointerType(input_element_type, default_address_space),
+                        "");
+                    ::LLVMValueRef input_value = ::LLVMGetUndef(input_type.type);
+                    for(std::size_t component = 0; component < input_component_count; component++)
+                    {
+                        constexpr std::size_t index_count = 1;
+                        ::LLVMValueRef indexes[index_count] = {
+                            ::LLVMBuildAdd(
+                                builder.get(),
+                                ::LLVMConstInt(
+                                    llvm_i32_type,
+                                    (*location * location_component_count + component)
+                                        * lane_count,
+                                    false),
+                                lane,
+                                ""),
+                        };
+                        auto component_value = ::LLVMBuildLoad(
+                            builder.get(),
+                            ::LLVMBuildGEP(builder.get(),
+                                           input_elements_pointer,
+                                           indexes,
+                                           index_count,
+                                           ""),
+                            "");
+                        ::LLVMSetAlignment(component_value,
+                                           ::LLVMABIAlignmentOfType(target_data, llvm_float_type));
+                        if(input_type.type == input_element_type)
+                            input_value = component_value;
+                        else
+                            input_value = ::LLVMBuildInsertElement(
+                                builder.get(),
+                                input_value,
+                                component_value,
+                                ::LLVMConstInt(llvm_i32_type, component, false),
+                                "");
+                    }
+                    ::LLVMSetAlignment(::LLVMBuildStore(builder.get(), input_value, input_pointer),
+                                       input_type.alignment);
+                    continue;
+                }
                 do
                 {
                     switch(*built_in)
@@ -615,21 +763,43 @@ using namespace spirv;
                 if(!location)
                     throw Parser_error(
                         0, 0, "fragment shader output variable is missing Location decoration");
-                if(*location != 0)
-                    throw Parser_error(
-                        0,
-                        0,
-                        "nonzero Location for fragment shader output variable is unimplemented");
                 auto llvm_output_member_type = output_member.type->get_or_make_type();
                 if(llvm_output_member_type.type != llvm_vec4_type)
                     throw Parser_error(
                         0, 0, "fragment shader output variable type is unimplemented");
-                auto callback = [llvm_output_member_type, &output_color, this, output_pointer]()
+                // writes to Locations without a color attachment are discarded
+                if(*location >= color_attachment_count)
+                    continue;
+                if(color_attachment_is_written[*location])
+                    throw Parser_error(0, 0, "duplicate fragment shader output variable");
+                color_attachment_is_written[*location] = true;
+                auto callback = [llvm_output_member_type,
+                                 this,
+                                 output_pointer,
+                                 lane_colors_pointer,
+                                 lane,
+                                 llvm_i32_type,
+                                 llvm_vec4_type,
+                                 location]()
                 {
-                    if(output_color)
-                        throw Parser_error(0, 0, "duplicate fragment shader output variable");
-                    output_color = ::LLVMBuildLoad(builder.get(), output_pointer, "output_color");
+                    auto output_color =
+                        ::LLVMBuildLoad(builder.get(), output_pointer, "output_color");
                     ::LLVMSetAlignment(output_color, llvm_output_member_type.alignment);
+                    constexpr std::size_t index_count = 3;
+                    ::LLVMValueRef indexes[index_count] = {
+                        ::LLVMConstNull(llvm_i32_type),
+                        ::LLVMConstInt(llvm_i32_type, *location, false),
+                        lane,
+                    };
+                    ::LLVMSetAlignment(
+                        ::LLVMBuildStore(builder.get(),
+                                         output_color,
+                                         ::LLVMBuildGEP(builder.get(),
+                                                        lane_colors_pointer,
+                                                        indexes,
+                                                        index_count,
+                                                        "")),
+                        ::LLVMABIAlignmentOfType(target_data, llvm_vec4_type));
                 };
                 after_call_callbacks.push_back(std::move(callback));
             }
@@ -660,53 +830,834 @@ using namespace spirv;
     for(auto &fn : after_call_callbacks)
         fn();
     after_call_callbacks.clear();
-    if(!output_color)
-        throw Parser_error(0, 0, "no fragment shader color output variables");
-    auto constant_one = ::LLVMConstReal(llvm_float_type, 1.0);
-    ::LLVMValueRef constant_vec4_of_one;
+    ::LLVMBuildBr(builder.get(), loop_latch_block);
+    ::LLVMPositionBuilderAtEnd(builder.get(), exit_block);
+    // convert and store the colors for all lanes at once
+    constexpr std::size_t lane_colors_vector_length = lane_count * 4;
+    constexpr unsigned default_address_space = 0;
+    auto llvm_lane_colors_vector_type =
+        ::LLVMVectorType(llvm_float_type, lane_colors_vector_length);
+    auto splat = [&](::LLVMValueRef element) -> ::LLVMValueRef
+    {
+        ::LLVMValueRef elements[lane_colors_vector_length];
+        for(auto &i : elements)
+            i = element;
+        return ::LLVMConstVector(elements, lane_colors_vector_length);
+    };
+    auto constant_vector_of_one = splat(::LLVMConstReal(llvm_float_type, 1.0));
+    auto constant_vector_of_zero = ::LLVMConstNull(llvm_lane_colors_vector_type);
+    auto llvm_i1_type = ::LLVMInt1TypeInContext(context);
+    auto llvm_u16_type = llvm_wrapper::Create_llvm_type<std::uint16_t>()(context);
+    auto llvm_lane_i32_vector_type = ::LLVMVectorType(llvm_i32_type, lane_colors_vector_length);
+    auto llvm_lane_bytes_type = ::LLVMVectorType(llvm_u8_type, lane_colors_vector_length);
+    auto llvm_lane_halves_type =
+        ::LLVMVectorType(::LLVMHalfTypeInContext(context), lane_colors_vector_length);
+    auto clamp_colors = [&](::LLVMValueRef colors, const char *name) -> ::LLVMValueRef
+    {
+        auto colors_are_too_small = ::LLVMBuildFCmp(
+            builder.get(), ::LLVMRealULT, colors, constant_vector_of_zero, "colors_are_too_small");
+        auto colors_are_too_large = ::LLVMBuildFCmp(
+            builder.get(), ::LLVMRealOGT, colors, constant_vector_of_one, "colors_are_too_large");
+        return ::LLVMBuildSelect(
+            builder.get(),
+            colors_are_too_small,
+            constant_vector_of_zero,
+            ::LLVMBuildSelect(
+                builder.get(), colors_are_too_large, constant_vector_of_one, colors, ""),
+            name);
+    };
+    // make vectors of lane_colors_vector_length elements from the component index of each element
+    auto make_per_component_integers = [&](::LLVMTypeRef element_type,
+                                           std::function<unsigned long long(std::size_t component)>
+                                               get_value) -> ::LLVMValueRef
+    {
+        ::LLVMValueRef elements[lane_colors_vector_length];
+        for(std::size_t i = 0; i < lane_colors_vector_length; i++)
+            elements[i] = ::LLVMConstInt(element_type, get_value(i % 4), false);
+        return ::LLVMConstVector(elements, lane_colors_vector_length);
+    };
+    auto make_per_component_floats =
+        [&](std::function<double(std::size_t component)> get_value) -> ::LLVMValueRef
+    {
+        ::LLVMValueRef elements[lane_colors_vector_length];
+        for(std::size_t i = 0; i < lane_colors_vector_length; i++)
+            elements[i] = ::LLVMConstReal(llvm_float_type, get_value(i % 4));
+        return ::LLVMConstVector(elements, lane_colors_vector_length);
+    };
+    auto build_shuffle = [&](::LLVMValueRef vector,
+                             std::size_t result_length,
+                             std::function<std::size_t(std::size_t index)> get_source_index,
+                             const char *name) -> ::LLVMValueRef
     {
-        constexpr std::size_t vector_length = 4;
-        ::LLVMValueRef args[vector_length] = {
-            constant_one, constant_one, constant_one, constant_one,
+        std::vector<::LLVMValueRef> shuffle_indexes(result_length);
+        for(std::size_t i = 0; i < result_length; i++)
+            shuffle_indexes[i] = ::LLVMConstInt(llvm_i32_type, get_source_index(i), false);
+        return ::LLVMBuildShuffleVector(builder.get(),
+                                        vector,
+                                        ::LLVMGetUndef(::LLVMTypeOf(vector)),
+                                        ::LLVMConstVector(shuffle_indexes.data(), result_length),
+                                        name);
+    };
+    // returns a vector with the color components from color_value and the alpha components from
+    // alpha_value
+    auto merge_color_and_alpha = [&](::LLVMValueRef color_value,
+                                     ::LLVMValueRef alpha_value,
+                                     const char *name) -> ::LLVMValueRef
+    {
+        if(color_value == alpha_value)
+            return color_value;
+        ::LLVMValueRef shuffle_indexes[lane_colors_vector_length];
+        for(std::size_t i = 0; i < lane_colors_vector_length; i++)
+        {
+            std::size_t index = i;
+            if(i % 4 == 3)
+                index += lane_colors_vector_length;
+            shuffle_indexes[i] = ::LLVMConstInt(llvm_i32_type, index, false);
+        }
+        return ::LLVMBuildShuffleVector(builder.get(),
+                                        color_value,
+                                        alpha_value,
+                                        ::LLVMConstVector(shuffle_indexes,
+                                                          lane_colors_vector_length),
+                                        name);
+    };
+    // reads a table of floats from the module for each element of indexes
+    auto build_table_lookup = [&](const float *table,
+                                  std::size_t table_size,
+                                  const char *table_name,
+                                  ::LLVMValueRef indexes,
+                                  const char *name) -> ::LLVMValueRef
+    {
+        auto llvm_table_type = ::LLVMArrayType(llvm_float_type, table_size);
+        auto table_variable = ::LLVMGetNamedGlobal(module.get(), table_name);
+        if(!table_variable)
+        {
+            std::vector<::LLVMValueRef> elements(table_size);
+            for(std::size_t i = 0; i < table_size; i++)
+                elements[i] = ::LLVMConstReal(llvm_float_type, table[i]);
+            table_variable = ::LLVMAddGlobal(module.get(), llvm_table_type, table_name);
+            ::LLVMSetInitializer(table_variable,
+                                 ::LLVMConstArray(llvm_float_type, elements.data(), table_size));
+            ::LLVMSetGlobalConstant(table_variable, true);
+            ::LLVMSetLinkage(table_variable, ::LLVMInternalLinkage);
+        }
+        constexpr std::size_t index_count = 2;
+        ::LLVMValueRef gep_indexes[index_count] = {
+            ::LLVMConstNull(llvm_i32_type), indexes,
         };
-        constant_vec4_of_one = ::LLVMConstVector(args, vector_length);
-    }
-    auto constant_vec4_of_zero = ::LLVMConstNull(::LLVMTypeOf(constant_vec4_of_one));
-    auto output_color_is_too_small = ::LLVMBuildFCmp(builder.get(),
-                                                     ::LLVMRealULT,
-                                                     output_color,
-                                                     constant_vec4_of_zero,
-                                                     "output_color_is_too_small");
-    auto output_color_is_too_large = ::LLVMBuildFCmp(builder.get(),
-                                                     ::LLVMRealOGT,
-                                                     output_color,
-                                                     constant_vec4_of_one,
-                                                     "output_color_is_too_large");
-    auto clamped_output_color = ::LLVMBuildSelect(
-        builder.get(),
-        output_color_is_too_small,
-        constant_vec4_of_zero,
-        ::LLVMBuildSelect(
-            builder.get(), output_color_is_too_large, constant_vec4_of_one, output_color, ""),
-        "clamped_output_color");
-    float multiplier_value = std::nextafterf(0x100, -1);
-    auto llvm_multiplier = ::LLVMConstReal(llvm_float_type, multiplier_value);
-    ::LLVMValueRef multiplier_vec4;
+        auto element_pointers =
+            ::LLVMBuildGEP(builder.get(), table_variable, gep_indexes, index_count, "");
+        return builder.build_masked_gather(
+            module.get(),
+            element_pointers,
+            ::LLVMABIAlignmentOfType(target_data, llvm_float_type),
+            ::LLVMConstAllOnes(::LLVMVectorType(llvm_i1_type, lane_colors_vector_length)),
+            ::LLVMGetUndef(llvm_lane_colors_vector_type),
+            name);
+    };
+    // multisample color attachments have a sample plane for each sample; the pixels' colors are
+    // stored to each plane with that sample's lane mask, and blending and the logic op use each
+    // sample's old color. The code for each plane of an attachment only differs in the memory
+    // accesses, the rest is merged by the optimizer.
+    std::size_t sample_count = multisample_state ? multisample_state->rasterizationSamples : 1;
+    for(std::size_t sample_plane_index = 0;
+        sample_plane_index < color_attachment_count * sample_count;
+        sample_plane_index++)
     {
-        constexpr std::size_t vector_length = 4;
-        ::LLVMValueRef args[vector_length] = {
-            llvm_multiplier, llvm_multiplier, llvm_multiplier, llvm_multiplier,
+        std::size_t color_attachment_index = sample_plane_index / sample_count;
+        std::size_t sample_index = sample_plane_index % sample_count;
+        if(color_attachment_formats[color_attachment_index] == VK_FORMAT_UNDEFINED
+           || !color_attachment_is_written[color_attachment_index])
+            continue;
+        auto color_format_layout =
+            vulkan::Color_format_layout::get(color_attachment_formats[color_attachment_index]);
+        if(!color_format_layout)
+            throw Parser_error(0, 0, "unimplemented color attachment format");
+        // the blend state is specialized into the code below, so disabled blending with all the
+        // components enabled in the write mask is just a conversion and a store
+        VkPipelineColorBlendAttachmentState attachment_blend_state = {
+            .blendEnable = false,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                              | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        };
+        util::optional<VkLogicOp> logic_op;
+        const float *blend_constants = nullptr;
+        if(color_blend_state)
+        {
+            assert(color_blend_state->attachmentCount == color_attachment_count);
+            attachment_blend_state = color_blend_state->pAttachments[color_attachment_index];
+            // blendEnable is ignored when the logic op is enabled, but the logic op is ignored
+            // for floating-point and sRGB formats
+            if(color_blend_state->logicOpEnable && color_format_layout->supports_logic_op())
+            {
+                logic_op = color_blend_state->logicOp;
+                attachment_blend_state.blendEnable = false;
+            }
+            blend_constants = color_blend_state->blendConstants;
+        }
+        constexpr VkColorComponentFlags all_color_components =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+        auto color_write_mask = attachment_blend_state.colorWriteMask & all_color_components;
+        if(logic_op && *logic_op == VK_LOGIC_OP_COPY)
+            logic_op = util::nullopt;
+        if((logic_op && *logic_op == VK_LOGIC_OP_NO_OP) || color_write_mask == 0)
+        {
+            // nothing is written to the color attachment
+            continue;
+        }
+        constexpr std::size_t lane_colors_index_count = 2;
+        ::LLVMValueRef lane_colors_indexes[lane_colors_index_count] = {
+            ::LLVMConstNull(llvm_i32_type),
+            ::LLVMConstInt(llvm_i32_type, color_attachment_index, false),
+        };
+        auto output_colors = ::LLVMBuildLoad(
+            builder.get(),
+            ::LLVMBuildBitCast(
+                builder.get(),
+                ::LLVMBuildGEP(builder.get(),
+                               lane_colors_pointer,
+                               lane_colors_indexes,
+                               lane_colors_index_count,
+                               ""),
+                ::LLVMPointerType(llvm_lane_colors_vector_type, default_address_space),
+                ""),
+            "output_colors");
+        ::LLVMSetAlignment(output_colors, ::LLVMABIAlignmentOfType(target_data, llvm_vec4_type));
+        // the component at each position in memory; swapping red and blue is its own inverse
+        auto get_memory_component = [&](std::size_t position) -> std::size_t
+        {
+            constexpr std::size_t swapped_components[4] = {2, 1, 0, 3};
+            return color_format_layout->swap_red_and_blue ? swapped_components[position] :
+                                                            position;
+        };
+        // the output colors are converted to a packed vector: 8-bit formats use a vector of
+        // bytes, 10-bit formats use a vector of 32-bit pixels, and floating-point formats use a
+        // vector of the components' bits
+        ::LLVMTypeRef llvm_packed_type = nullptr;
+        // memory is accessed with a vector of pixels or a vector of components, so the lane mask
+        // can be used for the masked load and store
+        ::LLVMTypeRef llvm_memory_element_type = nullptr;
+        std::size_t memory_elements_per_pixel = 1;
+        typedef vulkan::Color_format_layout::Kind Color_format_kind;
+        switch(color_format_layout->kind)
+        {
+        case Color_format_kind::Unorm8:
+        case Color_format_kind::Srgb8:
+            llvm_packed_type = llvm_lane_bytes_type;
+            llvm_memory_element_type = llvm_i32_type;
+            break;
+        case Color_format_kind::Unorm10_10_10_2:
+            llvm_packed_type = ::LLVMVectorType(llvm_i32_type, lane_count);
+            llvm_memory_element_type = llvm_i32_type;
+            break;
+        case Color_format_kind::Float16:
+            llvm_packed_type = ::LLVMVectorType(llvm_u16_type, lane_colors_vector_length);
+            llvm_memory_element_type = llvm_u16_type;
+            memory_elements_per_pixel = 4;
+            break;
+        case Color_format_kind::Float32:
+            llvm_packed_type = llvm_lane_i32_vector_type;
+            llvm_memory_element_type = llvm_i32_type;
+            memory_elements_per_pixel = 4;
+            break;
+        }
+        assert(llvm_packed_type);
+        auto get_unorm_max = [&](std::size_t component) -> unsigned long long
+        {
+            if(color_format_layout->kind != Color_format_kind::Unorm10_10_10_2)
+                return 0xFF;
+            return component == 3 ? 0x3 : 0x3FF;
+        };
+        // the components of 10-bit formats are packed starting at the least significant bit
+        auto unorm10_10_10_2_shifts = make_per_component_integers(
+            llvm_i32_type,
+            [&](std::size_t component) -> unsigned long long
+            {
+                return 10 * component;
+            });
+        auto reorder_components = [&](::LLVMValueRef colors) -> ::LLVMValueRef
+        {
+            return build_shuffle(colors,
+                                 lane_colors_vector_length,
+                                 [&](std::size_t index) -> std::size_t
+                                 {
+                                     return index - index % 4 + get_memory_component(index % 4);
+                                 },
+                                 "reordered_colors");
+        };
+        // converts the colors to the color attachment's format; colors must already be clamped for
+        // normalized formats
+        auto pack_colors = [&](::LLVMValueRef colors, const char *name) -> ::LLVMValueRef
+        {
+            if(color_format_layout->swap_red_and_blue)
+                colors = reorder_components(colors);
+            // converts values in [0, 1] to integers in [0, max value], the same as
+            // vulkan::float_to_unorm
+            auto build_float_to_unorm = [&](::LLVMValueRef clamped_colors,
+                                            ::LLVMTypeRef result_type,
+                                            const char *result_name) -> ::LLVMValueRef
+            {
+                auto scale = make_per_component_floats(
+                    [&](std::size_t component) -> double
+                    {
+                        return std::nextafter(get_unorm_max(component) + 1.0f, 0.0f);
+                    });
+                return ::LLVMBuildFPToUI(builder.get(),
+                                         ::LLVMBuildFMul(builder.get(), clamped_colors, scale, ""),
+                                         ::LLVMVectorType(result_type, lane_colors_vector_length),
+                                         result_name);
+            };
+            switch(color_format_layout->kind)
+            {
+            case Color_format_kind::Unorm8:
+                return build_float_to_unorm(colors, llvm_u8_type, name);
+            case Color_format_kind::Srgb8:
+            {
+                // the encoding is approximated using square roots, then corrected by comparing
+                // with the exact thresholds for each 8-bit value. The approximation is within
+                // 0.002, so it is never off by more than 1.
+                auto sqrt1 = builder.build_sqrt(module.get(), colors, "");
+                auto sqrt2 = builder.build_sqrt(module.get(), sqrt1, "");
+                auto sqrt3 = builder.build_sqrt(module.get(), sqrt2, "");
+                auto approximation = ::LLVMBuildFAdd(
+                    builder.get(),
+                    ::LLVMBuildFMul(builder.get(),
+                                    sqrt1,
+                                    splat(::LLVMConstReal(llvm_float_type, 0.585122381)),
+                                    ""),
+                    ::LLVMBuildFSub(builder.get(),
+                                    ::LLVMBuildFMul(builder.get(),
+                                                    sqrt2,
+                                                    splat(::LLVMConstReal(llvm_float_type,
+                                                                          0.783140355)),
+                                                    ""),
+                                    ::LLVMBuildFMul(builder.get(),
+                                                    sqrt3,
+                                                    splat(::LLVMConstReal(llvm_float_type,
+                                                                          0.368262736)),
+                                                    ""),
+                                    ""),
+                    "");
+                approximation = ::LLVMBuildSelect(
+                    builder.get(),
+                    ::LLVMBuildFCmp(builder.get(),
+                                    ::LLVMRealOLE,
+                                    colors,
+                                    splat(::LLVMConstReal(llvm_float_type, 0.0031308)),
+                                    ""),
+                    ::LLVMBuildFMul(
+                        builder.get(), colors, splat(::LLVMConstReal(llvm_float_type, 12.92)), ""),
+                    approximation,
+                    "");
+                auto approximate_values = build_float_to_unorm(
+                    clamp_colors(approximation, ""), llvm_i32_type, "approximate_values");
+                constexpr std::size_t encode_thresholds_size = 0x101;
+                auto build_threshold_lookup = [&](::LLVMValueRef indexes) -> ::LLVMValueRef
+                {
+                    return build_table_lookup(vulkan::get_srgb8_encode_thresholds(),
+                                              encode_thresholds_size,
+                                              "srgb8_encode_thresholds",
+                                              indexes,
+                                              "");
+                };
+                auto is_too_small = ::LLVMBuildFCmp(
+                    builder.get(),
+                    ::LLVMRealOGE,
+                    colors,
+                    build_threshold_lookup(::LLVMBuildAdd(
+                        builder.get(),
+                        approximate_values,
+                        make_per_component_integers(llvm_i32_type,
+                                                    [](std::size_t) -> unsigned long long
+                                                    {
+                                                        return 1;
+                                                    }),
+                        "")),
+                    "");
+                auto is_too_large = ::LLVMBuildFCmp(builder.get(),
+                                                    ::LLVMRealOLT,
+                                                    colors,
+                                                    build_threshold_lookup(approximate_values),
+                                                    "");
+                auto encoded_values = ::LLVMBuildSub(
+                    builder.get(),
+                    ::LLVMBuildAdd(builder.get(),
+                                   approximate_values,
+                                   ::LLVMBuildZExt(
+                                       builder.get(), is_too_small, llvm_lane_i32_vector_type, ""),
+                                   ""),
+                    ::LLVMBuildZExt(builder.get(), is_too_large, llvm_lane_i32_vector_type, ""),
+                    "");
+                // alpha is always linear
+                return merge_color_and_alpha(
+                    ::LLVMBuildTrunc(builder.get(), encoded_values, llvm_lane_bytes_type, ""),
+                    build_float_to_unorm(colors, llvm_u8_type, ""),
+                    name);
+            }
+            case Color_format_kind::Unorm10_10_10_2:
+            {
+                auto components = ::LLVMBuildShl(builder.get(),
+                                                 build_float_to_unorm(colors, llvm_i32_type, ""),
+                                                 unorm10_10_10_2_shifts,
+                                                 "");
+                ::LLVMValueRef retval = nullptr;
+                for(std::size_t component = 0; component < 4; component++)
+                {
+                    auto pixel_components = build_shuffle(components,
+                                                          lane_count,
+                                                          [&](std::size_t pixel) -> std::size_t
+                                                          {
+                                                              return pixel * 4 + component;
+                                                          },
+                                                          "");
+                    if(retval)
+                        retval = ::LLVMBuildOr(builder.get(), retval, pixel_components, name);
+                    else
+                        retval = pixel_components;
+                }
+                return retval;
+            }
+            case Color_format_kind::Float16:
+                return ::LLVMBuildBitCast(
+                    builder.get(),
+                    ::LLVMBuildFPTrunc(builder.get(), colors, llvm_lane_halves_type, ""),
+                    llvm_packed_type,
+                    name);
+            case Color_format_kind::Float32:
+                return ::LLVMBuildBitCast(builder.get(), colors, llvm_packed_type, name);
+            }
+            assert(false);
+            return nullptr;
         };
-        multiplier_vec4 = ::LLVMConstVector(args, vector_length);
+        // converts from the color attachment's format
+        auto unpack_colors = [&](::LLVMValueRef packed, const char *name) -> ::LLVMValueRef
+        {
+            auto build_unorm_to_float = [&](::LLVMValueRef values) -> ::LLVMValueRef
+            {
+                return ::LLVMBuildFMul(
+                    builder.get(),
+                    ::LLVMBuildUIToFP(builder.get(), values, llvm_lane_colors_vector_type, ""),
+                    make_per_component_floats([&](std::size_t component) -> double
+                                              {
+                                                  return 1.0 / get_unorm_max(component);
+                                              }),
+                    "");
+            };
+            ::LLVMValueRef colors = nullptr;
+            switch(color_format_layout->kind)
+            {
+            case Color_format_kind::Unorm8:
+                colors = build_unorm_to_float(packed);
+                break;
+            case Color_format_kind::Srgb8:
+            {
+                constexpr std::size_t decode_table_size = 0x100;
+                colors = merge_color_and_alpha(
+                    build_table_lookup(
+                        vulkan::get_srgb8_decode_table(),
+                        decode_table_size,
+                        "srgb8_decode_table",
+                        ::LLVMBuildZExt(builder.get(), packed, llvm_lane_i32_vector_type, ""),
+                        ""),
+                    build_unorm_to_float(packed),
+                    "");
+                break;
+            }
+            case Color_format_kind::Unorm10_10_10_2:
+            {
+                auto components = ::LLVMBuildAnd(
+                    builder.get(),
+                    ::LLVMBuildLShr(builder.get(),
+                                    build_shuffle(packed,
+                                                  lane_colors_vector_length,
+                                                  [](std::size_t index) -> std::size_t
+                                                  {
+                                                      return index / 4;
+                                                  },
+                                                  ""),
+                                    unorm10_10_10_2_shifts,
+                                    ""),
+                    make_per_component_integers(llvm_i32_type, get_unorm_max),
+                    "");
+                colors = build_unorm_to_float(components);
+                break;
+            }
+            case Color_format_kind::Float16:
+                colors = ::LLVMBuildFPExt(
+                    builder.get(),
+                    ::LLVMBuildBitCast(builder.get(), packed, llvm_lane_halves_type, ""),
+                    llvm_lane_colors_vector_type,
+                    "");
+                break;
+            case Color_format_kind::Float32:
+                colors =
+                    ::LLVMBuildBitCast(builder.get(), packed, llvm_lane_colors_vector_type, "");
+                break;
+            }
+            assert(colors);
+            if(color_format_layout->swap_red_and_blue)
+                colors = reorder_components(colors);
+            ::LLVMSetValueName(colors, name);
+            return colors;
+        };
+        // normalized formats clamp the output colors before blending and before they are converted
+        auto source_colors = output_colors;
+        if(color_format_layout->is_normalized())
+            source_colors = clamp_colors(output_colors, "clamped_output_colors");
+        auto llvm_memory_vector_type =
+            ::LLVMVectorType(llvm_memory_element_type, lane_count * memory_elements_per_pixel);
+        auto sample_lane_mask = lane_mask;
+        if(sample_count != 1)
+        {
+            auto index = ::LLVMConstInt(llvm_i32_type, sample_index, false);
+            sample_lane_mask = ::LLVMBuildLoad(
+                builder.get(),
+                ::LLVMBuildGEP(builder.get(), sample_lane_masks, &index, 1, ""),
+                "sample_lane_mask");
+            ::LLVMSetAlignment(sample_lane_mask,
+                               ::LLVMABIAlignmentOfType(target_data, llvm_i32_type));
+        }
+        // inactive lanes may be outside of the color attachment, so they must not be accessed
+        auto store_mask = ::LLVMBuildBitCast(
+            builder.get(),
+            ::LLVMBuildTrunc(
+                builder.get(), sample_lane_mask, ::LLVMIntTypeInContext(context, lane_count), ""),
+            ::LLVMVectorType(llvm_i1_type, lane_count),
+            "store_mask");
+        if(memory_elements_per_pixel != 1)
+            store_mask = build_shuffle(store_mask,
+                                       lane_count * memory_elements_per_pixel,
+                                       [&](std::size_t index) -> std::size_t
+                                       {
+                                           return index / memory_elements_per_pixel;
+                                       },
+                                       "store_mask");
+        // the pipeline passes the address of the span's first pixel in each sample plane, so the
+        // span's pixels are contiguous in both the linear and the tiled image layouts
+        auto sample_plane_index_value = ::LLVMConstInt(llvm_i32_type, sample_plane_index, false);
+        auto span_pixels = ::LLVMBuildLoad(
+            builder.get(),
+            ::LLVMBuildGEP(
+                builder.get(), color_attachment_pixels, &sample_plane_index_value, 1, ""),
+            "span_pixels");
+        ::LLVMSetAlignment(span_pixels,
+                           ::LLVMABIAlignmentOfType(target_data, ::LLVMTypeOf(span_pixels)));
+        auto pixels_pointer =
+            ::LLVMBuildBitCast(builder.get(),
+                               span_pixels,
+                               ::LLVMPointerType(llvm_memory_vector_type, default_address_space),
+                               "pixels_pointer");
+        auto memory_alignment = ::LLVMABIAlignmentOfType(target_data, llvm_memory_element_type);
+        // the old pixels are only loaded if the blend state uses them
+        ::LLVMValueRef old_packed_pixels = nullptr;
+        auto get_old_packed_pixels = [&]() -> ::LLVMValueRef
+        {
+            if(!old_packed_pixels)
+            {
+                auto old_pixels = builder.build_masked_load(module.get(),
+                                                            pixels_pointer,
+                                                            memory_alignment,
+                                                            store_mask,
+                                                            ::LLVMGetUndef(llvm_memory_vector_type),
+                                                            "old_pixels");
+                old_packed_pixels = ::LLVMBuildBitCast(
+                    builder.get(), old_pixels, llvm_packed_type, "old_packed_pixels");
+            }
+            return old_packed_pixels;
+        };
+        ::LLVMValueRef output_pixels;
+        if(attachment_blend_state.blendEnable)
+        {
+            auto destination_colors = unpack_colors(get_old_packed_pixels(), "destination_colors");
+            auto broadcast_alpha = [&](::LLVMValueRef colors, const char *name) -> ::LLVMValueRef
+            {
+                ::LLVMValueRef shuffle_indexes[lane_colors_vector_length];
+                for(std::size_t i = 0; i < lane_colors_vector_length; i++)
+                    shuffle_indexes[i] = ::LLVMConstInt(llvm_i32_type, i - i % 4 + 3, false);
+                return ::LLVMBuildShuffleVector(builder.get(),
+                                                colors,
+                                                ::LLVMGetUndef(llvm_lane_colors_vector_type),
+                                                ::LLVMConstVector(shuffle_indexes,
+                                                                  lane_colors_vector_length),
+                                                name);
+            };
+            auto one_minus = [&](::LLVMValueRef value) -> ::LLVMValueRef
+            {
+                return ::LLVMBuildFSub(builder.get(), constant_vector_of_one, value, "");
+            };
+            // returns null for VK_BLEND_FACTOR_ONE so the multiply can be skipped
+            auto get_blend_factor = [&](VkBlendFactor blend_factor) -> ::LLVMValueRef
+            {
+                switch(blend_factor)
+                {
+                case VK_BLEND_FACTOR_ZERO:
+                    return constant_vector_of_zero;
+                case VK_BLEND_FACTOR_ONE:
+                    return nullptr;
+                case VK_BLEND_FACTOR_SRC_COLOR:
+                    return source_colors;
+                case VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR:
+                    return one_minus(source_colors);
+                case VK_BLEND_FACTOR_DST_COLOR:
+                    return destination_colors;
+                case VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR:
+                    return one_minus(destination_colors);
+                case VK_BLEND_FACTOR_SRC_ALPHA:
+                    return broadcast_alpha(source_colors, "source_alpha");
+                case VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:
+                    return one_minus(broadcast_alpha(source_colors, "source_alpha"));
+                case VK_BLEND_FACTOR_DST_ALPHA:
+                    return broadcast_alpha(destination_colors, "destination_alpha");
+                case VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:
+                    return one_minus(broadcast_alpha(destination_colors, "destination_alpha"));
+                case VK_BLEND_FACTOR_CONSTANT_COLOR:
+                case VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR:
+                case VK_BLEND_FACTOR_CONSTANT_ALPHA:
+                case VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA:
+                {
+                    assert(blend_constants);
+                    ::LLVMValueRef elements[lane_colors_vector_length];
+                    for(std::size_t i = 0; i < lane_colors_vector_length; i++)
+                    {
+                        float value = blend_constants[i % 4];
+                        if(blend_factor == VK_BLEND_FACTOR_CONSTANT_ALPHA
+                           || blend_factor == VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA)
+                            value = blend_constants[3];
+                        // normalized formats clamp the blend constants like the colors
+                        if(color_format_layout->is_normalized())
+                            value = std::min(std::max(value, 0.0f), 1.0f);
+                        if(blend_factor == VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR
+                           || blend_factor == VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA)
+                            value = 1.0f - value;
+                        elements[i] = ::LLVMConstReal(llvm_float_type, value);
+                    }
+                    return ::LLVMConstVector(elements, lane_colors_vector_length);
+                }
+                case VK_BLEND_FACTOR_SRC_ALPHA_SATURATE:
+                {
+                    // min(source alpha, 1 - destination alpha) for the color components and 1 for
+                    // the alpha component
+                    auto source_alpha = broadcast_alpha(source_colors, "source_alpha");
+                    auto one_minus_destination_alpha =
+                        one_minus(broadcast_alpha(destination_colors, "destination_alpha"));
+                    auto saturate = ::LLVMBuildSelect(
+                        builder.get(),
+                        ::LLVMBuildFCmp(builder.get(),
+                                        ::LLVMRealOLT,
+                                        source_alpha,
+                                        one_minus_destination_alpha,
+                                        ""),
+                        source_alpha,
+                        one_minus_destination_alpha,
+                        "");
+                    return merge_color_and_alpha(saturate, constant_vector_of_one, "saturate");
+                }
+                case VK_BLEND_FACTOR_SRC1_COLOR:
+                case VK_BLEND_FACTOR_ONE_MINUS_SRC1_COLOR:
+                case VK_BLEND_FACTOR_SRC1_ALPHA:
+                case VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA:
+                    // rejected in Graphics_pipeline::create
+                    break;
+                case VK_BLEND_FACTOR_RANGE_SIZE:
+                case VK_BLEND_FACTOR_MAX_ENUM:
+                    break;
+                }
+                throw Parser_error(0, 0, "unimplemented blend factor");
+            };
+            // multiplies colors by the color factor in the color components and by the alpha factor
+            // in the alpha components
+            auto apply_blend_factors = [&](::LLVMValueRef colors,
+                                           VkBlendFactor color_blend_factor,
+                                           VkBlendFactor alpha_blend_factor,
+                                           const char *name) -> ::LLVMValueRef
+            {
+                if(color_blend_factor == VK_BLEND_FACTOR_ONE
+                   && alpha_blend_factor == VK_BLEND_FACTOR_ONE)
+                    return colors;
+                if(color_blend_factor == VK_BLEND_FACTOR_ZERO
+                   && alpha_blend_factor == VK_BLEND_FACTOR_ZERO)
+                    return constant_vector_of_zero;
+                auto color_factor = get_blend_factor(color_blend_factor);
+                auto alpha_factor = color_factor;
+                if(alpha_blend_factor != color_blend_factor)
+                    alpha_factor = get_blend_factor(alpha_blend_factor);
+                if(!color_factor)
+                    color_factor = constant_vector_of_one;
+                if(!alpha_factor)
+                    alpha_factor = constant_vector_of_one;
+                return ::LLVMBuildFMul(builder.get(),
+                                       colors,
+                                       merge_color_and_alpha(color_factor, alpha_factor, ""),
+                                       name);
+            };
+            auto source_terms = apply_blend_factors(source_colors,
+                                                    attachment_blend_state.srcColorBlendFactor,
+                                                    attachment_blend_state.srcAlphaBlendFactor,
+                                                    "source_terms");
+            auto destination_terms = apply_blend_factors(destination_colors,
+                                                         attachment_blend_state.dstColorBlendFactor,
+                                                         attachment_blend_state.dstAlphaBlendFactor,
+                                                         "destination_terms");
+            auto apply_blend_op = [&](VkBlendOp blend_op) -> ::LLVMValueRef
+            {
+                switch(blend_op)
+                {
+                case VK_BLEND_OP_ADD:
+                    return ::LLVMBuildFAdd(builder.get(), source_terms, destination_terms, "");
+                case VK_BLEND_OP_SUBTRACT:
+                    return ::LLVMBuildFSub(builder.get(), source_terms, destination_terms, "");
+                case VK_BLEND_OP_REVERSE_SUBTRACT:
+                    return ::LLVMBuildFSub(builder.get(), destination_terms, source_terms, "");
+                // min and max ignore the blend factors
+                case VK_BLEND_OP_MIN:
+                    return ::LLVMBuildSelect(
+                        builder.get(),
+                        ::LLVMBuildFCmp(
+                            builder.get(), ::LLVMRealOLT, source_colors, destination_colors, ""),
+                        source_colors,
+                        destination_colors,
+                        "");
+                case VK_BLEND_OP_MAX:
+                    return ::LLVMBuildSelect(
+                        builder.get(),
+                        ::LLVMBuildFCmp(
+                            builder.get(), ::LLVMRealOGT, source_colors, destination_colors, ""),
+                        source_colors,
+                        destination_colors,
+                        "");
+                default:
+                    // advanced blend operations are rejected in Graphics_pipeline::create
+                    break;
+                }
+                throw Parser_error(0, 0, "unimplemented blend operation");
+            };
+            auto blended_colors = apply_blend_op(attachment_blend_state.colorBlendOp);
+            if(attachment_blend_state.alphaBlendOp != attachment_blend_state.colorBlendOp)
+                blended_colors = merge_color_and_alpha(
+                    blended_colors, apply_blend_op(attachment_blend_state.alphaBlendOp), "");
+            if(color_format_layout->is_normalized())
+                blended_colors = clamp_colors(blended_colors, "clamped_blended_colors");
+            output_pixels = pack_colors(blended_colors, "output_pixels");
+        }
+        else
+        {
+            output_pixels = pack_colors(source_colors, "output_pixels");
+        }
+        if(logic_op)
+        {
+            // the logic op is applied to the converted bits
+            auto source = output_pixels;
+            auto destination = get_old_packed_pixels();
+            auto all_ones = ::LLVMConstAllOnes(llvm_packed_type);
+            auto build_not = [&](::LLVMValueRef value) -> ::LLVMValueRef
+            {
+                return ::LLVMBuildXor(builder.get(), value, all_ones, "");
+            };
+            switch(*logic_op)
+            {
+            case VK_LOGIC_OP_CLEAR:
+                output_pixels = ::LLVMConstNull(llvm_packed_type);
+                break;
+            case VK_LOGIC_OP_AND:
+                output_pixels = ::LLVMBuildAnd(builder.get(), source, destination, "");
+                break;
+            case VK_LOGIC_OP_AND_REVERSE:
+                output_pixels = ::LLVMBuildAnd(builder.get(), source, build_not(destination), "");
+                break;
+            case VK_LOGIC_OP_COPY:
+                break;
+            case VK_LOGIC_OP_AND_INVERTED:
+                output_pixels = ::LLVMBuildAnd(builder.get(), build_not(source), destination, "");
+                break;
+            case VK_LOGIC_OP_NO_OP:
+                output_pixels = destination;
+                break;
+            case VK_LOGIC_OP_XOR:
+                output_pixels = ::LLVMBuildXor(builder.get(), source, destination, "");
+                break;
+            case VK_LOGIC_OP_OR:
+                output_pixels = ::LLVMBuildOr(builder.get(), source, destination, "");
+                break;
+            case VK_LOGIC_OP_NOR:
+                output_pixels = build_not(::LLVMBuildOr(builder.get(), source, destination, ""));
+                break;
+            case VK_LOGIC_OP_EQUIVALENT:
+                output_pixels = build_not(::LLVMBuildXor(builder.get(), source, destination, ""));
+                break;
+            case VK_LOGIC_OP_INVERT:
+                output_pixels = build_not(destination);
+                break;
+            case VK_LOGIC_OP_OR_REVERSE:
+                output_pixels = ::LLVMBuildOr(builder.get(), source, build_not(destination), "");
+                break;
+            case VK_LOGIC_OP_COPY_INVERTED:
+                output_pixels = build_not(source);
+                break;
+            case VK_LOGIC_OP_OR_INVERTED:
+                output_pixels = ::LLVMBuildOr(builder.get(), build_not(source), destination, "");
+                break;
+            case VK_LOGIC_OP_NAND:
+                output_pixels = build_not(::LLVMBuildAnd(builder.get(), source, destination, ""));
+                break;
+            case VK_LOGIC_OP_SET:
+                output_pixels = all_ones;
+                break;
+            case VK_LOGIC_OP_RANGE_SIZE:
+            case VK_LOGIC_OP_MAX_ENUM:
+                throw Parser_error(0, 0, "invalid logic op");
+            }
+        }
+        if(color_write_mask != all_color_components)
+        {
+            // keep the old value of the components that aren't in the write mask
+            ::LLVMValueRef write_mask;
+            if(color_format_layout->kind == Color_format_kind::Unorm10_10_10_2)
+            {
+                unsigned long long pixel_write_mask = 0;
+                for(std::size_t position = 0; position < 4; position++)
+                {
+                    auto component = get_memory_component(position);
+                    if(color_write_mask & (1ULL << component))
+                        pixel_write_mask |= get_unorm_max(component) << (10 * position);
+                }
+                std::vector<::LLVMValueRef> elements(
+                    lane_count, ::LLVMConstInt(llvm_i32_type, pixel_write_mask, false));
+                write_mask = ::LLVMConstVector(elements.data(), lane_count);
+            }
+            else
+            {
+                write_mask = make_per_component_integers(
+                    ::LLVMGetElementType(llvm_packed_type),
+                    [&](std::size_t position) -> unsigned long long
+                    {
+                        if(color_write_mask & (1ULL << get_memory_component(position)))
+                            return ~0ULL;
+                        return 0;
+                    });
+            }
+            output_pixels = ::LLVMBuildOr(
+                builder.get(),
+                ::LLVMBuildAnd(builder.get(), output_pixels, write_mask, ""),
+                ::LLVMBuildAnd(
+                    builder.get(), get_old_packed_pixels(), ::LLVMConstNot(write_mask), ""),
+                "masked_output_pixels");
+        }
+        builder.build_masked_store(
+            module.get(),
+            ::LLVMBuildBitCast(builder.get(), output_pixels, llvm_memory_vector_type, ""),
+            pixels_pointer,
+            memory_alignment,
+            store_mask);
     }
-    auto scaled_output_color = ::LLVMBuildFMul(
-        builder.get(), multiplier_vec4, clamped_output_color, "scaled_output_color");
-    auto converted_output_color = ::LLVMBuildFPToUI(
-        builder.get(), scaled_output_color, llvm_u8vec4_type, "converted_output_color");
-    auto packed_output_color = ::LLVMBuildBitCast(
-        builder.get(), converted_output_color, llvm_pixel_type, "packed_output_color");
-    ::LLVMBuildStore(builder.get(), packed_output_color, color_attachment_pixel);
-    static_assert(std::is_same<decltype(std::declval<Fragment_shader_function>()(nullptr, nullptr)),
+    static_assert(std::is_same<decltype(std::declval<Fragment_shader_function>()(
+                                   0, 0, 0, nullptr, nullptr, nullptr, nullptr)),
                                void>::value,
                   "");
     ::LLVMBuildRetVoid(builder.get());
@@ -21,6 +21,7 @@
  *
  */
 #include "spirv_to_llvm_implementation.h"
+#include "vulkan/color_format.h"
 
 namespace kazan
 {
@@ -536,6 +537,17 @@ namespace
 #ifdef __ARM_EABI__
 DECLARE_LIBRARY_SYMBOL(__aeabi_unwind_cpp_pr0)
 #endif
+
+// LLVM lowers half-precision conversions to these library calls on targets without F16C
+std::uint16_t float_to_half_library_function(float value) noexcept
+{
+    return vulkan::float_to_half(value);
+}
+
+float half_to_float_library_function(std::uint16_t value) noexcept
+{
+    return vulkan::half_to_float(value);
+}
 }
 
 Jit_symbol_resolver::Resolved_symbol Jit_symbol_resolver::resolve(util::string_view name)
@@ -552,6 +564,10 @@ Jit_symbol_resolver::Resolved_symbol Jit_symbol_resolver::resolve(util::string_v
 #ifdef __ARM_EABI__
     RESOLVE_LIBRARY_SYMBOL(__aeabi_unwind_cpp_pr0)
 #endif
+    if(name == "__truncsfhf2" || name == "__gnu_f2h_ieee")
+        return reinterpret_cast<Resolved_symbol>(float_to_half_library_function);
+    if(name == "__extendhfsf2" || name == "__gnu_h2f_ieee")
+        return reinterpret_cast<Resolved_symbol>(half_to_float_library_function);
 #warning finish implementing
     return nullptr;
 }
@@ -566,6 +582,9 @@ spirv_to_llvm::Converted_module spirv_to_llvm::spirv_to_llvm(
     spirv::Execution_model execution_model,
     util::string_view entry_point_name,
     const VkPipelineVertexInputStateCreateInfo *vertex_input_state,
+    const VkPipelineMultisampleStateCreateInfo *multisample_state,
+    const VkPipelineColorBlendStateCreateInfo *color_blend_state,
+    const std::vector<VkFormat> &color_attachment_formats,
     pipeline::Instantiated_pipeline_layout &pipeline_layout)
 {
     return Spirv_to_llvm(context,
@@ -574,6 +593,9 @@ spirv_to_llvm::Converted_module spirv_to_llvm::spirv_to_llvm(
                          execution_model,
                          entry_point_name,
                          vertex_input_state,
+                         multisample_state,
+                         color_blend_state,
+                         color_attachment_formats,
                          pipeline_layout)
         .run(shader_words, shader_size);
 }
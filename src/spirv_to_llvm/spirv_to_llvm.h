@@ -842,6 +842,9 @@ Converted_module spirv_to_llvm(::LLVMContextRef context,
                                spirv::Execution_model execution_model,
                                util::string_view entry_point_name,
                                const VkPipelineVertexInputStateCreateInfo *vertex_input_state,
+                               const VkPipelineMultisampleStateCreateInfo *multisample_state,
+                               const VkPipelineColorBlendStateCreateInfo *color_blend_state,
+                               const std::vector<VkFormat> &color_attachment_formats,
                                pipeline::Instantiated_pipeline_layout &pipeline_layout);
 }
 }
@@ -253,6 +253,12 @@ private:
     util::string_view entry_point_name;
     Op_entry_point_state *entry_point_state_pointer = nullptr;
     const VkPipelineVertexInputStateCreateInfo *vertex_input_state;
+    /** null when rasterizer discard is enabled */
+    const VkPipelineMultisampleStateCreateInfo *multisample_state;
+    /** null when rasterizer discard is enabled */
+    const VkPipelineColorBlendStateCreateInfo *color_blend_state;
+    /** one for each color attachment of the subpass; VK_FORMAT_UNDEFINED for unused attachments */
+    std::vector<VkFormat> color_attachment_formats;
     pipeline::Instantiated_pipeline_layout &pipeline_layout;
 
 private:
@@ -403,6 +409,9 @@ public:
                            spirv::Execution_model execution_model,
                            util::string_view entry_point_name,
                            const VkPipelineVertexInputStateCreateInfo *vertex_input_state,
+                           const VkPipelineMultisampleStateCreateInfo *multisample_state,
+                           const VkPipelineColorBlendStateCreateInfo *color_blend_state,
+                           const std::vector<VkFormat> &color_attachment_formats,
                            pipeline::Instantiated_pipeline_layout &pipeline_layout)
         : context(context),
           target_machine(target_machine),
@@ -411,6 +420,9 @@ public:
           execution_model(execution_model),
           entry_point_name(entry_point_name),
           vertex_input_state(vertex_input_state),
+          multisample_state(multisample_state),
+          color_blend_state(color_blend_state),
+          color_attachment_formats(color_attachment_formats),
           pipeline_layout(pipeline_layout)
     {
         {
@@ -34,24 +34,29 @@ using namespace spirv;
 {
     assert(vertex_input_state);
     typedef std::uint32_t Vertex_index_type;
+    typedef std::uint64_t Vertex_end_index_type;
     auto llvm_vertex_index_type = llvm_wrapper::Create_llvm_type<Vertex_index_type>()(context);
+    auto llvm_vertex_end_index_type =
+        llvm_wrapper::Create_llvm_type<Vertex_end_index_type>()(context);
     auto llvm_size_t_type = llvm_wrapper::Create_llvm_type<std::size_t>()(context);
     auto llvm_unsigned_char_pointer_type =
         llvm_wrapper::Create_llvm_type<unsigned char *>()(context);
     auto llvm_float_type = llvm_wrapper::Create_llvm_type<float>()(context);
     auto llvm_float_type_alignment = ::LLVMPreferredAlignmentOfType(target_data, llvm_float_type);
     typedef void (*Vertex_shader_function)(Vertex_index_type vertex_start_index,
-                                           Vertex_index_type vertex_end_index,
-                                           std::uint32_t instance_id,
+                                           Vertex_end_index_type vertex_end_index,
+                                           std::uint32_t instance_start_index,
+                                           std::uint32_t instance_end_index,
                                            void *output_buffer,
                                            void *const *bindings,
                                            void *uniforms);
     constexpr std::size_t arg_vertex_start_index = 0;
     constexpr std::size_t arg_vertex_end_index = 1;
-    constexpr std::size_t arg_instance_id = 2;
-    constexpr std::size_t arg_output_buffer = 3;
-    constexpr std::size_t arg_bindings = 4;
-    constexpr std::size_t arg_uniforms = 5;
+    constexpr std::size_t arg_instance_start_index = 2;
+    constexpr std::size_t arg_instance_end_index = 3;
+    constexpr std::size_t arg_output_buffer = 4;
+    constexpr std::size_t arg_bindings = 5;
+    constexpr std::size_t arg_uniforms = 6;
     static_assert(std::is_same<Vertex_shader_function,
                                pipeline::Graphics_pipeline::Vertex_shader_function>::value,
                   "vertex shader function signature mismatch");
@@ -62,7 +67,10 @@ using namespace spirv;
     ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_vertex_start_index),
                        "vertex_start_index");
     ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_vertex_end_index), "vertex_end_index");
-    ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_instance_id), "instance_id");
+    ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_instance_start_index),
+                       "instance_start_index");
+    ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_instance_end_index),
+                       "instance_end_index");
     ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_output_buffer), "output_buffer_");
     ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_bindings), "bindings");
     ::LLVMSetValueName(::LLVMGetParam(entry_function, arg_uniforms), "uniforms");
@@ -105,23 +113,58 @@ using namespace spirv;
                            ::LLVMGetParam(entry_function, arg_output_buffer),
                            outputs_struct_pointer_type->get_or_make_type().type,
                            "start_output_buffer");
-    auto start_loop_condition =
+    auto start_loop_condition = ::LLVMBuildAnd(
+        builder.get(),
         ::LLVMBuildICmp(builder.get(),
                         ::LLVMIntULT,
-                        ::LLVMGetParam(entry_function, arg_vertex_start_index),
+                        ::LLVMBuildZExt(builder.get(),
+                                        ::LLVMGetParam(entry_function, arg_vertex_start_index),
+                                        llvm_vertex_end_index_type,
+                                        ""),
                         ::LLVMGetParam(entry_function, arg_vertex_end_index),
-                        "start_loop_condition");
+                        ""),
+        ::LLVMBuildICmp(builder.get(),
+                        ::LLVMIntULT,
+                        ::LLVMGetParam(entry_function, arg_instance_start_index),
+                        ::LLVMGetParam(entry_function, arg_instance_end_index),
+                        ""),
+        "start_loop_condition");
     ::LLVMBuildCondBr(builder.get(), start_loop_condition, loop_block, exit_block);
     ::LLVMPositionBuilderAtEnd(builder.get(), loop_block);
     auto vertex_index = ::LLVMBuildPhi(builder.get(),
                                        llvm_wrapper::Create_llvm_type<Vertex_index_type>()(context),
                                        "vertex_index");
+    auto instance_id = ::LLVMBuildPhi(
+        builder.get(), llvm_wrapper::Create_llvm_type<std::uint32_t>()(context), "instance_id");
     auto output_buffer = ::LLVMBuildPhi(
         builder.get(), outputs_struct_pointer_type->get_or_make_type().type, "output_buffer");
-    auto next_vertex_index = ::LLVMBuildNUWAdd(builder.get(),
-                                               vertex_index,
-                                               ::LLVMConstInt(llvm_vertex_index_type, 1, false),
-                                               "next_vertex_index");
+    // the instances of each vertex are shaded one after another, so the outputs are at index
+    // (vertex_index - vertex_start_index) * instance_count + (instance_id - instance_start_index)
+    auto unwrapped_next_instance_id =
+        ::LLVMBuildNUWAdd(builder.get(),
+                          instance_id,
+                          ::LLVMConstInt(::LLVMTypeOf(instance_id), 1, false),
+                          "unwrapped_next_instance_id");
+    auto is_last_instance = ::LLVMBuildICmp(builder.get(),
+                                            ::LLVMIntEQ,
+                                            unwrapped_next_instance_id,
+                                            ::LLVMGetParam(entry_function, arg_instance_end_index),
+                                            "is_last_instance");
+    auto next_instance_id =
+        ::LLVMBuildSelect(builder.get(),
+                          is_last_instance,
+                          ::LLVMGetParam(entry_function, arg_instance_start_index),
+                          unwrapped_next_instance_id,
+                          "next_instance_id");
+    // computed in the end index type, since it's past vertex index 0xFFFFFFFF after the last
+    // instance of that vertex
+    auto wide_next_vertex_index = ::LLVMBuildNUWAdd(
+        builder.get(),
+        ::LLVMBuildZExt(builder.get(), vertex_index, llvm_vertex_end_index_type, ""),
+        ::LLVMBuildZExt(builder.get(), is_last_instance, llvm_vertex_end_index_type, ""),
+        "wide_next_vertex_index");
+    auto next_vertex_index = ::LLVMBuildTrunc(
+        builder.get(), wide_next_vertex_index, llvm_vertex_index_type, "next_vertex_index");
     constexpr std::size_t vertex_index_incoming_count = 2;
     ::LLVMValueRef vertex_index_incoming_values[vertex_index_incoming_count] = {
         next_vertex_index, ::LLVMGetParam(entry_function, arg_vertex_start_index),
@@ -133,6 +176,17 @@ using namespace spirv;
                       vertex_index_incoming_values,
                       vertex_index_incoming_blocks,
                       vertex_index_incoming_count);
+    constexpr std::size_t instance_id_incoming_count = 2;
+    ::LLVMValueRef instance_id_incoming_values[instance_id_incoming_count] = {
+        next_instance_id, ::LLVMGetParam(entry_function, arg_instance_start_index),
+    };
+    ::LLVMBasicBlockRef instance_id_incoming_blocks[instance_id_incoming_count] = {
+        loop_block, entry_block,
+    };
+    ::LLVMAddIncoming(instance_id,
+                      instance_id_incoming_values,
+                      instance_id_incoming_blocks,
+                      instance_id_incoming_count);
     ::LLVMValueRef next_output_buffer;
     {
         constexpr std::size_t index_count = 1;
@@ -373,8 +427,7 @@ using namespace spirv;
                             switch(vertex_binding_description.inputRate)
                             {
                             case VK_VERTEX_INPUT_RATE_INSTANCE:
-                                input_element_index =
-                                    ::LLVMGetParam(entry_function, arg_instance_id);
+                                input_element_index = instance_id;
                                 break;
                             case VK_VERTEX_INPUT_RATE_VERTEX:
                                 input_element_index = vertex_index;
@@ -640,8 +693,13 @@ using namespace spirv;
                             continue;
                         }
                         case Built_in::instance_index:
-#warning finish implementing Built_in::instance_index
-                            break;
+                        {
+                            if(input_type.type != ::LLVMTypeOf(instance_id))
+                                throw Parser_error(
+                                    0, 0, "invalid type for instance index built-in variable");
+                            ::LLVMBuildStore(builder.get(), instance_id, input_pointer);
+                            continue;
+                        }
                         case Built_in::subgroup_eq_mask_khr:
 #warning finish implementing Built_in::subgroup_eq_mask_khr
                             break;
@@ -752,11 +810,9 @@ using namespace spirv;
 #warning finish implementing Decoration::built_in
                         break;
                     case Decoration::no_perspective:
-#warning finish implementing Decoration::no_perspective
-                        break;
                     case Decoration::flat:
-#warning finish implementing Decoration::flat
-                        break;
+                        // interpolation is controlled by the fragment shader's decorations
+                        continue;
                     case Decoration::patch:
 #warning finish implementing Decoration::patch
                         break;
@@ -800,8 +856,8 @@ using namespace spirv;
 #warning finish implementing Decoration::stream
                         break;
                     case Decoration::location:
-#warning finish implementing Decoration::location
-                        break;
+                        // matched to fragment shader inputs in Graphics_pipeline::create
+                        continue;
                     case Decoration::component:
 #warning finish implementing Decoration::component
                         break;
@@ -900,13 +956,13 @@ using namespace spirv;
     auto next_iteration_condition =
         ::LLVMBuildICmp(builder.get(),
                         ::LLVMIntULT,
-                        next_vertex_index,
+                        wide_next_vertex_index,
                         ::LLVMGetParam(entry_function, arg_vertex_end_index),
                         "next_iteration_condition");
     ::LLVMBuildCondBr(builder.get(), next_iteration_condition, loop_block, exit_block);
     ::LLVMPositionBuilderAtEnd(builder.get(), exit_block);
     static_assert(
-        std::is_same<decltype(std::declval<Vertex_shader_function>()(0, 0, 0, nullptr, nullptr, nullptr)),
+        std::is_same<decltype(std::declval<Vertex_shader_function>()(0, 0, 0, 0, nullptr, nullptr, nullptr)),
                      void>::value,
         "");
     ::LLVMBuildRetVoid(builder.get());
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "thread_pool.h"
+#include <cstdlib>
+#include <cerrno>
+
+namespace kazan
+{
+namespace util
+{
+Thread_pool::Thread_pool(std::size_t thread_count)
+    : run_mutex(),
+      mutex(),
+      cond(),
+      done_cond(),
+      current_batch(nullptr),
+      batch_generation(0),
+      quit(false),
+      threads()
+{
+    if(thread_count == 0)
+        thread_count = get_default_thread_count();
+    threads.reserve(thread_count - 1);
+    try
+    {
+        for(std::size_t thread_index = 1; thread_index < thread_count; thread_index++)
+            threads.emplace_back(&Thread_pool::thread_fn, this, thread_index);
+    }
+    catch(...)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        quit = true;
+        cond.notify_all();
+        lock.unlock();
+        for(auto &thread : threads)
+            thread.join();
+        throw;
+    }
+}
+
+Thread_pool::~Thread_pool()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    quit = true;
+    cond.notify_all();
+    lock.unlock();
+    for(auto &thread : threads)
+        thread.join();
+    threads.clear();
+}
+
+void Thread_pool::thread_fn(std::size_t thread_index) noexcept
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::uint64_t last_batch_generation = 0;
+    while(true)
+    {
+        if(quit)
+            return;
+        if(!current_batch || batch_generation == last_batch_generation)
+        {
+            cond.wait(lock);
+            continue;
+        }
+        last_batch_generation = batch_generation;
+        auto &batch = *current_batch;
+        batch.active_thread_count++;
+        lock.unlock();
+        run_tasks(batch, thread_index);
+        lock.lock();
+        if(--batch.active_thread_count == 0)
+            done_cond.notify_all();
+    }
+}
+
+void Thread_pool::run_batch(Batch &batch) noexcept
+{
+    if(threads.empty() || batch.task_count <= 1)
+    {
+        run_tasks(batch, 0);
+        return;
+    }
+    std::unique_lock<std::mutex> run_lock(run_mutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    current_batch = &batch;
+    batch_generation++;
+    cond.notify_all();
+    lock.unlock();
+    run_tasks(batch, 0);
+    lock.lock();
+    // workers that haven't picked up the batch yet won't see it after this
+    current_batch = nullptr;
+    while(batch.active_thread_count != 0)
+        done_cond.wait(lock);
+}
+
+std::size_t Thread_pool::get_default_thread_count() noexcept
+{
+    if(const char *thread_count_string = std::getenv("KAZAN_THREAD_COUNT"))
+    {
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long thread_count = std::strtoull(thread_count_string, &end, 10);
+        if(errno == 0 && end != thread_count_string && *end == '\0' && thread_count != 0)
+            return thread_count;
+    }
+    std::size_t retval = std::thread::hardware_concurrency();
+    if(retval == 0)
+        retval = 1;
+    return retval;
+}
+}
+}
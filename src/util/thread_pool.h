@@ -0,0 +1,150 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef UTIL_THREAD_POOL_H_
+#define UTIL_THREAD_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <exception>
+
+namespace kazan
+{
+namespace util
+{
+/** a fixed set of worker threads that run batches of independent tasks.
+ *
+ * The thread calling run_parallel also runs tasks, so a pool with a thread count of 1 has no
+ * worker threads and runs everything on the calling thread.
+ * Tasks may throw: the first exception thrown by a task stops the remaining tasks from being
+ * handed out, and is rethrown by run_parallel on the calling thread after the batch finishes.
+ * run_parallel must not be called from inside a task. */
+class Thread_pool final
+{
+    Thread_pool(const Thread_pool &) = delete;
+    Thread_pool &operator=(const Thread_pool &) = delete;
+
+private:
+    typedef void (*Run_task_function)(void *state,
+                                      std::size_t task_index,
+                                      std::size_t thread_index);
+    struct Batch
+    {
+        Run_task_function run_task;
+        void *state;
+        std::size_t task_count;
+        std::atomic<std::size_t> next_task_index;
+        std::size_t active_thread_count;
+        std::atomic<bool> has_exception;
+        /** the first exception thrown by a task; only read after the batch finishes */
+        std::exception_ptr exception;
+        Batch(Run_task_function run_task, void *state, std::size_t task_count) noexcept
+            : run_task(run_task),
+              state(state),
+              task_count(task_count),
+              next_task_index(0),
+              active_thread_count(0),
+              has_exception(false),
+              exception()
+        {
+        }
+    };
+
+private:
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable done_cond;
+    Batch *current_batch;
+    std::uint64_t batch_generation;
+    bool quit;
+    std::vector<std::thread> threads;
+
+private:
+    static void run_tasks(Batch &batch, std::size_t thread_index) noexcept
+    {
+        while(true)
+        {
+            auto task_index = batch.next_task_index.fetch_add(1, std::memory_order_relaxed);
+            if(task_index >= batch.task_count)
+                return;
+            try
+            {
+                batch.run_task(batch.state, task_index, thread_index);
+            }
+            catch(...)
+            {
+                if(!batch.has_exception.exchange(true, std::memory_order_relaxed))
+                    batch.exception = std::current_exception();
+                // don't hand out the remaining tasks
+                batch.next_task_index.store(batch.task_count, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+    void thread_fn(std::size_t thread_index) noexcept;
+    void run_batch(Batch &batch) noexcept;
+
+public:
+    /** thread_count includes the thread calling run_parallel; 0 means use
+     * get_default_thread_count() */
+    explicit Thread_pool(std::size_t thread_count = 0);
+    ~Thread_pool();
+    /** the number of threads that run tasks, including the thread calling run_parallel.
+     * thread_index values passed to tasks are less than this. */
+    std::size_t get_thread_count() const noexcept
+    {
+        return threads.size() + 1;
+    }
+    /** calls fn(task_index, thread_index) for every task_index in [0, task_count), spread across
+     * all the threads in the pool, then waits for all of them to finish.
+     * Tasks are handed out in increasing task_index order, but may finish in any order.
+     * If a task throws, the tasks that weren't started yet are skipped and the first exception
+     * is rethrown once the tasks that were already running have finished. */
+    template <typename Fn>
+    void run_parallel(std::size_t task_count, Fn &&fn)
+    {
+        auto run_task = [](void *state, std::size_t task_index, std::size_t thread_index)
+        {
+            (*static_cast<typename std::remove_reference<Fn>::type *>(state))(task_index,
+                                                                            thread_index);
+        };
+        Batch batch(run_task, static_cast<void *>(&fn), task_count);
+        run_batch(batch);
+        if(batch.exception)
+            std::rethrow_exception(batch.exception);
+    }
+    /** returns the value of the KAZAN_THREAD_COUNT environment variable if it is set to a
+     * positive number, otherwise returns the number of hardware threads */
+    static std::size_t get_default_thread_count() noexcept;
+};
+}
+}
+
+#endif // UTIL_THREAD_POOL_H_
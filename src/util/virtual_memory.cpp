@@ -0,0 +1,173 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "virtual_memory.h"
+#include "memory.h"
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+
+namespace kazan
+{
+namespace util
+{
+namespace
+{
+std::size_t get_page_size() noexcept
+{
+    static const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+}
+
+void *Virtual_memory::allocate(std::size_t size)
+{
+    if(size == 0)
+        size = 1;
+    // allocations smaller than a page come from the heap, so they don't each take a page and a
+    // mapping
+    if(size < get_page_size())
+        return Aligned_memory_allocator<min_alignment>::allocate(size);
+    if(size < huge_page_size)
+    {
+        void *memory =
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+            throw std::bad_alloc();
+        return memory;
+    }
+    // map extra so the start can be aligned to a huge page, then unmap the unused ends
+    std::size_t mapped_size = size + huge_page_size;
+    if(mapped_size < size)
+        throw std::bad_alloc();
+    void *mapped_memory =
+        ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapped_memory == MAP_FAILED)
+        throw std::bad_alloc();
+    auto huge_page_mask = static_cast<std::uintptr_t>(huge_page_size - 1);
+    auto page_mask = static_cast<std::uintptr_t>(get_page_size() - 1);
+    auto mapped_start = reinterpret_cast<std::uintptr_t>(mapped_memory);
+    auto start = (mapped_start + huge_page_mask) & ~huge_page_mask;
+    auto end = (start + size + page_mask) & ~page_mask;
+    if(start != mapped_start)
+        ::munmap(mapped_memory, start - mapped_start);
+    if(end != mapped_start + mapped_size)
+        ::munmap(reinterpret_cast<void *>(end), mapped_start + mapped_size - end);
+    void *memory = reinterpret_cast<void *>(start);
+#ifdef MADV_HUGEPAGE
+    // only a hint; the pages are still committed lazily, a huge page at a time
+    ::madvise(memory, end - start, MADV_HUGEPAGE);
+#endif
+    return memory;
+}
+
+void Virtual_memory::deallocate(void *memory, std::size_t size) noexcept
+{
+    if(memory == nullptr)
+        return;
+    if(size == 0)
+        size = 1;
+    if(size < get_page_size())
+        Aligned_memory_allocator<min_alignment>::deallocate(memory);
+    else
+        ::munmap(memory, size);
+}
+
+std::size_t Virtual_memory::get_committed_size(const void *memory, std::size_t size) noexcept
+{
+    if(size == 0)
+        return 0;
+    std::size_t page_size = get_page_size();
+    // heap allocations are always committed
+    if(size < page_size)
+        return size;
+    auto page_mask = static_cast<std::uintptr_t>(page_size - 1);
+    auto start = reinterpret_cast<std::uintptr_t>(memory) & ~page_mask;
+    auto end = reinterpret_cast<std::uintptr_t>(memory) + size;
+    std::size_t page_count = (end - start + page_size - 1) / page_size;
+    // check the pages in chunks so large allocations don't need a large buffer
+    constexpr std::size_t chunk_page_count = 4096;
+    unsigned char residency[chunk_page_count];
+    std::size_t committed_page_count = 0;
+    for(std::size_t page_index = 0; page_index < page_count; page_index += chunk_page_count)
+    {
+        std::size_t count = page_count - page_index;
+        if(count > chunk_page_count)
+            count = chunk_page_count;
+        if(::mincore(reinterpret_cast<void *>(start + page_index * page_size),
+                     count * page_size,
+                     residency)
+           != 0)
+            return size;
+        for(std::size_t i = 0; i < count; i++)
+            if(residency[i] & 1)
+                committed_page_count++;
+    }
+    std::size_t committed_size = committed_page_count * page_size;
+    return committed_size < size ? committed_size : size;
+}
+
+void Virtual_memory::decommit(void *memory, std::size_t size) noexcept
+{
+    auto page_mask = static_cast<std::uintptr_t>(get_page_size() - 1);
+    auto start = (reinterpret_cast<std::uintptr_t>(memory) + page_mask) & ~page_mask;
+    auto end = (reinterpret_cast<std::uintptr_t>(memory) + size) & ~page_mask;
+    if(start < end)
+        ::madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+}
+}
+}
+#else
+namespace kazan
+{
+namespace util
+{
+// without an implementation for the platform, memory is allocated from the heap and is always
+// committed
+void *Virtual_memory::allocate(std::size_t size)
+{
+    return Aligned_memory_allocator<min_alignment>::allocate(size);
+}
+
+void Virtual_memory::deallocate(void *memory, std::size_t size) noexcept
+{
+    static_cast<void>(size);
+    Aligned_memory_allocator<min_alignment>::deallocate(memory);
+}
+
+std::size_t Virtual_memory::get_committed_size(const void *memory, std::size_t size) noexcept
+{
+    static_cast<void>(memory);
+    return size;
+}
+
+void Virtual_memory::decommit(void *memory, std::size_t size) noexcept
+{
+    static_cast<void>(memory);
+    static_cast<void>(size);
+}
+}
+}
+#endif
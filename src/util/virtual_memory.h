@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef UTIL_VIRTUAL_MEMORY_H_
+#define UTIL_VIRTUAL_MEMORY_H_
+
+#include <cstddef>
+
+namespace kazan
+{
+namespace util
+{
+/** memory allocated straight from the operating system's virtual memory, so its pages are only
+ * committed when they're first written, and can be given back without freeing the allocation.
+ * Allocations smaller than a page come from the heap instead. */
+struct Virtual_memory
+{
+    /** every allocation is aligned to at least this many bytes; allocations of at least a page
+     * are aligned to a page */
+    static constexpr std::size_t min_alignment = 64;
+    /** allocations of at least this size are aligned to it and use transparent huge pages where
+     * the operating system supports them, so large heaps take fewer page faults and TLB misses */
+    static constexpr std::size_t huge_page_size = 2UL << 20;
+    /** throws std::bad_alloc when out of memory */
+    static void *allocate(std::size_t size);
+    /** size must be the size passed to allocate */
+    static void deallocate(void *memory, std::size_t size) noexcept;
+    /** returns an upper bound on the number of bytes of [memory, memory + size) that are
+     * committed. Pages that were only read count as committed, since reading maps them to the
+     * shared zero page, and ranges smaller than a page always count as committed. */
+    static std::size_t get_committed_size(const void *memory, std::size_t size) noexcept;
+    /** gives the pages that are entirely inside [memory, memory + size) back to the operating
+     * system; their contents become undefined, and they're committed again when next written */
+    static void decommit(void *memory, std::size_t size) noexcept;
+    struct Deleter
+    {
+        std::size_t size;
+        void operator()(void *memory) const noexcept
+        {
+            deallocate(memory, size);
+        }
+    };
+};
+}
+}
+
+#endif // UTIL_VIRTUAL_MEMORY_H_
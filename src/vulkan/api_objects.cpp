@@ -21,12 +21,15 @@
  *
  */
 #include "api_objects.h"
+#include "color_format.h"
+#include "resolve_kernel.h"
 #include "util/optional.h"
+#include "util/bit_intrinsics.h"
 #include <iostream>
 #include <type_traits>
 #include <vector>
 #include <algorithm>
-#include <atomic>
+#include <cstring>
 
 namespace kazan
 {
@@ -463,7 +466,6 @@ std::unique_ptr<Vulkan_fence> Vulkan_fence::create(Vulkan_device &device,
 void Vulkan_image::clear(VkClearColorValue color) noexcept
 {
     assert(memory);
-    assert(descriptor.samples == VK_SAMPLE_COUNT_1_BIT && "multisample images are unimplemented");
     assert(descriptor.extent.width > 0);
     assert(descriptor.extent.height > 0);
     assert(descriptor.extent.depth > 0);
@@ -471,50 +473,367 @@ void Vulkan_image::clear(VkClearColorValue color) noexcept
     assert(descriptor.type == VK_IMAGE_TYPE_2D && "unimplemented image type");
     assert(descriptor.extent.depth == 1);
 
-    assert(descriptor.format == VK_FORMAT_B8G8R8A8_UNORM && "unimplemented image format");
     assert(descriptor.mip_levels == 1 && "mipmapping is unimplemented");
     assert(descriptor.array_layers == 1 && "array images are unimplemented");
-#warning implement non-linear image tiling
 
-    union
+    auto color_format_layout = Color_format_layout::get(descriptor.format);
+    assert(color_format_layout && "unimplemented image format");
+    auto color_component = descriptor.get_memory_properties().get_color_component();
+    std::size_t pixel_size = color_format_layout->get_pixel_size();
+    assert(color_component.pixel_size == pixel_size);
+    assert(pixel_size <= max_pixel_size);
+    // color images only have the color subimage
+    auto &clear_pixel = clear_pixels[0];
+    color_format_layout->pack(color.float32, clear_pixel);
+    // multisample images only clear sample 0 and mark every pixel compressed
+    if(sample_compression_masks)
+        std::memset(sample_compression_masks.get(),
+                    0xFF,
+                    get_sample_compression_mask_stride() * descriptor.extent.height);
+    if(cleared_tiles)
     {
-        std::uint8_t bytes[4];
-        std::uint32_t u32;
-    } clear_color;
-    float r_float = color.float32[0];
-    float g_float = color.float32[1];
-    float b_float = color.float32[2];
-    float a_float = color.float32[3];
-    auto float_to_byte = [](float v) noexcept->std::uint8_t
+        std::memset(cleared_tiles.get(),
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    get_cleared_tile_stride() * get_cleared_tile_row_count());
+        return;
+    }
+    // the sample plane of a linear image is an array of pixels, so it's cleared in one pass
+    auto *image_memory =
+        static_cast<unsigned char *>(memory.get()) + color_component.offset_from_array_layer_start;
+    for(std::size_t offset = 0; offset < color_component.sample_plane_size; offset += pixel_size)
+        std::memcpy(image_memory + offset, clear_pixel, pixel_size);
+}
+
+void Vulkan_image::fill_cleared_tile(std::uint32_t tile_x, std::uint32_t tile_y) const noexcept
+{
+    auto &cleared_tile = get_cleared_tile(tile_x, tile_y);
+    if(!cleared_tile)
+        return;
+    auto memory_properties = descriptor.get_memory_properties();
+    constexpr std::size_t macro_tile_pixel_count =
+        Vulkan_image_descriptor::macro_tile_size * Vulkan_image_descriptor::macro_tile_size;
+    for(std::size_t i = 0; i < memory_properties.subimage_count; i++)
+    {
+        auto &subimage = memory_properties.subimages[i];
+        if(!(cleared_tile & subimage.get_aspect_mask()))
+            continue;
+        assert(subimage.is_tiled);
+        std::uint32_t sample_plane_count = descriptor.get_sample_count();
+        if(subimage.component
+           == Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::Color)
+            sample_plane_count = 1;
+        // the macro-tile is contiguous, including the padding of partial macro-tiles
+        auto *pixels = static_cast<unsigned char *>(memory.get())
+                       + subimage.offset_from_array_layer_start
+                       + subimage.get_pixel_offset(
+                             tile_x << Vulkan_image_descriptor::log2_macro_tile_size,
+                             tile_y << Vulkan_image_descriptor::log2_macro_tile_size);
+        std::size_t pixel_size = subimage.pixel_size;
+        for(std::uint32_t sample = 0; sample < sample_plane_count; sample++)
+        {
+            auto *sample_pixels = pixels + sample * subimage.sample_plane_size;
+            for(std::size_t offset = 0; offset < macro_tile_pixel_count * pixel_size;
+                offset += pixel_size)
+                std::memcpy(sample_pixels + offset, clear_pixels[i], pixel_size);
+        }
+    }
+    cleared_tile = 0;
+}
+
+void Vulkan_image::prepare_for_overwrite(std::uint32_t x,
+                                         std::uint32_t y,
+                                         std::uint32_t width,
+                                         std::uint32_t height) noexcept
+{
+    if(!cleared_tiles || width == 0 || height == 0)
+        return;
+    constexpr std::uint32_t log2_macro_tile_size = Vulkan_image_descriptor::log2_macro_tile_size;
+    constexpr std::uint32_t macro_tile_size = Vulkan_image_descriptor::macro_tile_size;
+    std::uint32_t end_x = x + width;
+    std::uint32_t end_y = y + height;
+    for(std::uint32_t tile_y = y >> log2_macro_tile_size;
+        tile_y <= (end_y - 1) >> log2_macro_tile_size;
+        tile_y++)
+    {
+        for(std::uint32_t tile_x = x >> log2_macro_tile_size;
+            tile_x <= (end_x - 1) >> log2_macro_tile_size;
+            tile_x++)
+        {
+            // the pixels in the padding of partial macro-tiles are never read
+            std::uint32_t tile_min_x = tile_x << log2_macro_tile_size;
+            std::uint32_t tile_min_y = tile_y << log2_macro_tile_size;
+            std::uint32_t tile_end_x =
+                std::min(tile_min_x + macro_tile_size, descriptor.extent.width);
+            std::uint32_t tile_end_y =
+                std::min(tile_min_y + macro_tile_size, descriptor.extent.height);
+            if(tile_min_x >= x && tile_min_y >= y && tile_end_x <= end_x && tile_end_y <= end_y)
+                get_cleared_tile(tile_x, tile_y) &= ~VK_IMAGE_ASPECT_COLOR_BIT;
+            else
+                fill_cleared_tile(tile_x, tile_y);
+        }
+    }
+}
+
+void Vulkan_image::decompress_samples(std::uint32_t x,
+                                      std::uint32_t y,
+                                      std::uint32_t lane_mask) const noexcept
+{
+    assert(x % 8 == 0);
+    auto &compression_mask = get_sample_compression_mask(x, y);
+    lane_mask &= compression_mask;
+    if(!lane_mask)
+        return;
+    compression_mask &= ~lane_mask;
+    auto color_component = descriptor.get_memory_properties().get_color_component();
+    // the 8 pixels are contiguous in both image layouts
+    auto *pixels = static_cast<unsigned char *>(memory.get())
+                   + color_component.offset_from_array_layer_start
+                   + color_component.get_pixel_offset(x, y);
+    for(std::uint32_t sample = 1; sample < descriptor.get_sample_count(); sample++)
+    {
+        auto *sample_pixels = pixels + sample * color_component.sample_plane_size;
+        for(std::uint32_t lanes = lane_mask; lanes; lanes &= lanes - 1)
+        {
+            std::size_t offset = util::ctz32(lanes) * color_component.pixel_size;
+            std::memcpy(sample_pixels + offset, pixels + offset, color_component.pixel_size);
+        }
+    }
+}
+
+void Vulkan_image::resolve(Vulkan_image &destination, const VkImageResolve &region) const noexcept
+{
+    assert(memory);
+    assert(destination.memory);
+    assert(descriptor.samples != VK_SAMPLE_COUNT_1_BIT);
+    assert(destination.descriptor.samples == VK_SAMPLE_COUNT_1_BIT);
+    assert(descriptor.format == destination.descriptor.format);
+    assert(region.srcSubresource.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT);
+    assert(region.dstSubresource.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT);
+    assert(region.srcSubresource.mipLevel == 0 && "mipmapping is unimplemented");
+    assert(region.dstSubresource.mipLevel == 0 && "mipmapping is unimplemented");
+    assert(region.srcSubresource.baseArrayLayer == 0 && region.srcSubresource.layerCount == 1
+           && "array images are unimplemented");
+    assert(region.dstSubresource.baseArrayLayer == 0 && region.dstSubresource.layerCount == 1
+           && "array images are unimplemented");
+    assert(region.srcOffset.z == 0 && region.dstOffset.z == 0 && region.extent.depth == 1);
+    assert(region.srcOffset.x >= 0 && region.srcOffset.y >= 0);
+    assert(region.dstOffset.x >= 0 && region.dstOffset.y >= 0);
+    assert(region.srcOffset.x + region.extent.width <= descriptor.extent.width);
+    assert(region.srcOffset.y + region.extent.height <= descriptor.extent.height);
+    assert(region.dstOffset.x + region.extent.width <= destination.descriptor.extent.width);
+    assert(region.dstOffset.y + region.extent.height <= destination.descriptor.extent.height);
+    auto color_format_layout = Color_format_layout::get(descriptor.format);
+    assert(color_format_layout && "unimplemented image format");
+    auto source_component = descriptor.get_memory_properties().get_color_component();
+    auto destination_component =
+        destination.descriptor.get_memory_properties().get_color_component();
+    std::size_t pixel_size = source_component.pixel_size;
+    assert(destination_component.pixel_size == pixel_size);
+    std::uint32_t sample_count = descriptor.get_sample_count();
+    std::uint32_t log2_sample_count = util::ctz32(sample_count);
+    float inverse_sample_count = 1.0f / sample_count;
+    auto &unorm8_resolve_kernel = Unorm8_resolve_kernel::get();
+    destination.prepare_for_overwrite(
+        region.dstOffset.x, region.dstOffset.y, region.extent.width, region.extent.height);
+    // resolves width pixels of one row that may have compressed pixels
+    auto resolve_pixels = [&](unsigned char *destination_pixels,
+                              const unsigned char *source_pixels,
+                              std::uint32_t width) noexcept
     {
-        if(!(v >= 0))
-            v = 0;
-        else if(v > 1)
-            v = 1;
-        union
-        {
-            std::uint32_t i;
-            float f;
-        } u;
-        static_assert(sizeof(std::uint32_t) == sizeof(float), "");
-        u.f = 0x100;
-        u.i--; // u.f = nextafter(u.f, -1)
-        v *= u.f;
-        return (int)v;
+        switch(color_format_layout->kind)
+        {
+        case Color_format_layout::Kind::Unorm8:
+        case Color_format_layout::Kind::Srgb8:
+            unorm8_resolve_kernel.function(destination_pixels,
+                                           source_pixels,
+                                           source_component.sample_plane_size,
+                                           log2_sample_count,
+                                           width * pixel_size);
+            return;
+        case Color_format_layout::Kind::Unorm10_10_10_2:
+            for(std::uint32_t x = 0; x < width; x++)
+            {
+                std::uint32_t sums[4] = {};
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                {
+                    std::uint32_t pixel;
+                    std::memcpy(&pixel,
+                                source_pixels + x * pixel_size
+                                    + sample * source_component.sample_plane_size,
+                                sizeof(pixel));
+                    for(std::size_t i = 0; i < 4; i++)
+                        sums[i] += (pixel >> (10 * i)) & (i == 3 ? 0x3U : 0x3FFU);
+                }
+                std::uint32_t pixel = 0;
+                for(std::size_t i = 0; i < 4; i++)
+                    pixel |= ((sums[i] + sample_count / 2) >> log2_sample_count) << (10 * i);
+                std::memcpy(destination_pixels + x * pixel_size, &pixel, sizeof(pixel));
+            }
+            return;
+        case Color_format_layout::Kind::Float16:
+            for(std::size_t i = 0; i < width * 4; i++)
+            {
+                float sum = 0;
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                {
+                    std::uint16_t value;
+                    std::memcpy(&value,
+                                source_pixels + i * sizeof(value)
+                                    + sample * source_component.sample_plane_size,
+                                sizeof(value));
+                    sum += half_to_float(value);
+                }
+                std::uint16_t value = float_to_half(sum * inverse_sample_count);
+                std::memcpy(destination_pixels + i * sizeof(value), &value, sizeof(value));
+            }
+            return;
+        case Color_format_layout::Kind::Float32:
+            for(std::size_t i = 0; i < width * 4; i++)
+            {
+                float sum = 0;
+                for(std::uint32_t sample = 0; sample < sample_count; sample++)
+                {
+                    float value;
+                    std::memcpy(&value,
+                                source_pixels + i * sizeof(value)
+                                    + sample * source_component.sample_plane_size,
+                                sizeof(value));
+                    sum += value;
+                }
+                float value = sum * inverse_sample_count;
+                std::memcpy(destination_pixels + i * sizeof(value), &value, sizeof(value));
+            }
+            return;
+        }
+        assert(!"unknown color format kind");
     };
-    clear_color.bytes[0] = float_to_byte(b_float);
-    clear_color.bytes[1] = float_to_byte(g_float);
-    clear_color.bytes[2] = float_to_byte(r_float);
-    clear_color.bytes[3] = float_to_byte(a_float);
-    std::size_t pixel_count =
-        static_cast<std::size_t>(descriptor.extent.width) * descriptor.extent.height;
-    std::uint32_t *pixels = static_cast<std::uint32_t *>(memory.get());
-    for(std::size_t i = 0; i < pixel_count; i++)
+    for(std::uint32_t row = 0; row < region.extent.height; row++)
     {
-        pixels[i] = clear_color.u32;
+        std::uint32_t source_y = region.srcOffset.y + row;
+        std::uint32_t destination_y = region.dstOffset.y + row;
+        // each segment of the row is contiguous in both images: the whole row for linear images,
+        // and at most a row of a micro-tile for tiled images
+        for(std::uint32_t segment_start = 0, segment_end = 0; segment_start < region.extent.width;
+            segment_start = segment_end)
+        {
+            std::uint32_t source_x = region.srcOffset.x + segment_start;
+            std::uint32_t destination_x = region.dstOffset.x + segment_start;
+            std::uint32_t width = region.extent.width - segment_start;
+            width = std::min(width, source_component.get_contiguous_pixel_count(source_x));
+            width =
+                std::min(width, destination_component.get_contiguous_pixel_count(destination_x));
+            segment_end = segment_start + width;
+            auto *source_pixels = static_cast<const unsigned char *>(memory.get())
+                                  + source_component.offset_from_array_layer_start
+                                  + source_component.get_pixel_offset(source_x, source_y);
+            auto *destination_pixels =
+                static_cast<unsigned char *>(destination.memory.get())
+                + destination_component.offset_from_array_layer_start
+                + destination_component.get_pixel_offset(destination_x, destination_y);
+            if(is_pixel_in_cleared_tile(source_x, source_y))
+            {
+                // every sample of a cleared pixel has the clear color, so it resolves to itself
+                for(std::uint32_t x = 0; x < width; x++)
+                    std::memcpy(destination_pixels + x * pixel_size, clear_pixels[0], pixel_size);
+                continue;
+            }
+            if(!sample_compression_masks)
+            {
+                resolve_pixels(destination_pixels, source_pixels, width);
+                continue;
+            }
+            // compressed pixels are copied from sample 0. Runs of uncompressed pixels are
+            // resolved together so the kernel sees long rows.
+            auto is_compressed = [&](std::uint32_t x) noexcept->bool
+            {
+                return (get_sample_compression_mask(source_x + x, source_y)
+                        >> ((source_x + x) % 8))
+                       & 1;
+            };
+            std::uint32_t x = 0;
+            while(x < width)
+            {
+                std::uint32_t run_start = x;
+                bool run_is_compressed = is_compressed(x);
+                for(x++; x < width && is_compressed(x) == run_is_compressed; x++)
+                {
+                }
+                if(run_is_compressed)
+                    std::memcpy(destination_pixels + run_start * pixel_size,
+                                source_pixels + run_start * pixel_size,
+                                (x - run_start) * pixel_size);
+                else
+                    resolve_pixels(destination_pixels + run_start * pixel_size,
+                                   source_pixels + run_start * pixel_size,
+                                   x - run_start);
+            }
+        }
     }
 }
 
+void Vulkan_image::clear_depth_stencil(VkClearDepthStencilValue value,
+                                       VkImageAspectFlags aspect_mask) noexcept
+{
+    assert(memory);
+    assert(descriptor.type == VK_IMAGE_TYPE_2D && "unimplemented image type");
+    assert(descriptor.extent.depth == 1);
+    assert(descriptor.mip_levels == 1 && "mipmapping is unimplemented");
+    assert(descriptor.array_layers == 1 && "array images are unimplemented");
+    auto memory_properties = descriptor.get_memory_properties();
+    // the aspects that are cleared lazily
+    VkImageAspectFlags cleared_aspect_mask = 0;
+    for(std::size_t i = 0; i < memory_properties.subimage_count; i++)
+    {
+        auto &subimage = memory_properties.subimages[i];
+        auto *subimage_memory =
+            static_cast<unsigned char *>(memory.get()) + subimage.offset_from_array_layer_start;
+        switch(subimage.component)
+        {
+        case Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::Depth:
+        {
+            if(!(aspect_mask & VK_IMAGE_ASPECT_DEPTH_BIT))
+                break;
+            assert(subimage.pixel_size == sizeof(float));
+            std::memcpy(clear_pixels[i], &value.depth, sizeof(float));
+            if(cleared_tiles)
+            {
+                cleared_aspect_mask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+                break;
+            }
+            // the sample planes follow each other and are arrays of pixels in both image
+            // layouts, so every pixel of every sample is cleared in one pass
+            auto *pixels = reinterpret_cast<float *>(subimage_memory);
+            for(std::size_t i = 0; i < subimage.size / sizeof(float); i++)
+                pixels[i] = value.depth;
+            break;
+        }
+        case Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::Stencil:
+        {
+            if(!(aspect_mask & VK_IMAGE_ASPECT_STENCIL_BIT))
+                break;
+            assert(subimage.pixel_size == sizeof(std::uint8_t));
+            clear_pixels[i][0] = static_cast<std::uint8_t>(value.stencil);
+            if(cleared_tiles)
+            {
+                cleared_aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+                break;
+            }
+            // this also sets the padding at the end of the linear layout's rows
+            std::memset(
+                subimage_memory, static_cast<std::uint8_t>(value.stencil), subimage.size);
+            break;
+        }
+        case Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::None:
+        case Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::Color:
+            assert(!"clear_depth_stencil called on a color image");
+            break;
+        }
+    }
+    if(cleared_aspect_mask)
+        for(std::size_t i = 0; i < get_cleared_tile_stride() * get_cleared_tile_row_count(); i++)
+            cleared_tiles[i] |= cleared_aspect_mask;
+}
+
 std::unique_ptr<Vulkan_image> Vulkan_image::create(Vulkan_device &device,
                                                    const VkImageCreateInfo &create_info)
 {
@@ -607,7 +926,7 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
     assert(create_info.subpassCount == 1 && "render pass not implemented for subpassCount != 1");
     std::vector<VkAttachmentDescription> attachments(
         create_info.pAttachments, create_info.pAttachments + create_info.attachmentCount);
-    util::optional<std::uint32_t> color_attachment_index;
+    std::vector<std::uint32_t> color_attachment_indexes;
     util::optional<std::uint32_t> depth_stencil_attachment_index;
 
     for(std::uint32_t i = 0; i < create_info.subpassCount; i++)
@@ -617,6 +936,16 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
         assert(subpass.colorAttachmentCount == 0 || subpass.pColorAttachments);
         assert(subpass.preserveAttachmentCount == 0 || subpass.pPreserveAttachments);
         assert(subpass.pipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS);
+        // all the attachments of a subpass must have the same sample count
+        util::optional<VkSampleCountFlagBits> subpass_samples;
+        auto check_samples = [&](VkSampleCountFlagBits samples) noexcept
+        {
+            assert((samples & Vulkan_image_descriptor::supported_samples)
+                   && "render pass not implemented for attachment sample count");
+            assert((!subpass_samples || *subpass_samples == samples)
+                   && "subpass attachments have different sample counts");
+            subpass_samples = samples;
+        };
 
         assert(subpass.flags == 0
                && "render pass not implemented for VkSubpassDescription::flags != 0");
@@ -642,12 +971,7 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
             default:
                 assert(!"depth-stencil attachment format not implemented");
             }
-            assert(depth_stencil_attachment.samples == VK_SAMPLE_COUNT_1_BIT
-               && "render pass not implemented for depth_stencil_attachment.samples != VK_SAMPLE_COUNT_1_BIT");
-            assert(depth_stencil_attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR
-               && "render pass not implemented for depth_stencil_attachment.loadOp != VK_ATTACHMENT_LOAD_OP_CLEAR");
-            assert(depth_stencil_attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE
-               && "render pass not implemented for depth_stencil_attachment.stencilLoadOp != VK_ATTACHMENT_LOAD_OP_DONT_CARE");
+            check_samples(depth_stencil_attachment.samples);
             depth_stencil_attachment_index = subpass.pDepthStencilAttachment->attachment;
         }
         assert(
@@ -658,6 +982,7 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
         for(std::uint32_t j = 0; j < subpass.colorAttachmentCount; j++)
         {
             auto &color_attachment_reference = subpass.pColorAttachments[j];
+            color_attachment_indexes.push_back(color_attachment_reference.attachment);
             if(color_attachment_reference.attachment == VK_ATTACHMENT_UNUSED)
                 continue;
             valid_color_attachment_count++;
@@ -666,19 +991,13 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
                 create_info.pAttachments[color_attachment_reference.attachment];
             assert(color_attachment.flags == 0
                    && "render pass not implemented for color_attachment.flags != 0");
-            assert(color_attachment.format == VK_FORMAT_B8G8R8A8_UNORM
-               && "render pass not implemented for color_attachment.format != VK_FORMAT_B8G8R8A8_UNORM");
-            assert(color_attachment.samples == VK_SAMPLE_COUNT_1_BIT
-               && "render pass not implemented for color_attachment.samples != VK_SAMPLE_COUNT_1_BIT");
-            assert(color_attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR
-               && "render pass not implemented for color_attachment.loadOp != VK_ATTACHMENT_LOAD_OP_CLEAR");
-            assert(color_attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE
-               && "render pass not implemented for color_attachment.stencilLoadOp != VK_ATTACHMENT_LOAD_OP_DONT_CARE");
-            color_attachment_index = color_attachment_reference.attachment;
+            assert(Color_format_layout::get(color_attachment.format)
+                   && "render pass not implemented for color_attachment.format");
+            check_samples(color_attachment.samples);
 #warning implement non-linear image layouts
         }
-        assert(valid_color_attachment_count == 1
-               && "render pass not implemented for valid_color_attachment_count != 1");
+        assert(valid_color_attachment_count != 0
+               && "render pass not implemented for valid_color_attachment_count == 0");
     }
     for(std::uint32_t i = 0; i < create_info.dependencyCount; i++)
     {
@@ -698,14 +1017,9 @@ std::unique_ptr<Vulkan_render_pass> Vulkan_render_pass::create(
                && "intra-render-pass subpass dependencies are not implemented");
     }
 #warning finish implementing Vulkan_render_pass::create
-    if(depth_stencil_attachment_index)
-    {
-        static std::atomic_bool wrote_warning{false};
-        if(!wrote_warning.exchange(true, std::memory_order::memory_order_relaxed))
-            std::cerr << "depth stencil attachments not implemented" << std::endl;
-    }
-    return std::make_unique<Vulkan_render_pass>(
-        std::move(attachments), *color_attachment_index, depth_stencil_attachment_index);
+    return std::make_unique<Vulkan_render_pass>(std::move(attachments),
+                                                std::move(color_attachment_indexes),
+                                                depth_stencil_attachment_index);
 }
 
 std::unique_ptr<Vulkan_framebuffer> Vulkan_framebuffer::create(
@@ -753,7 +1067,8 @@ Vulkan_command_buffer::Vulkan_command_buffer(
                                       command_pool(command_pool),
                                       device(device),
                                       commands(),
-                                      state(Command_buffer_state::Initial)
+                                      state(Command_buffer_state::Initial),
+                                      recording_state()
 {
 }
 
@@ -761,12 +1076,14 @@ void Vulkan_command_buffer::reset(VkCommandBufferResetFlags flags)
 {
     commands.clear();
     state = Command_buffer_state::Initial;
+    recording_state = Recording_state();
 }
 
 void Vulkan_command_buffer::begin(const VkCommandBufferBeginInfo &begin_info)
 {
     commands.clear();
     state = Command_buffer_state::Recording;
+    recording_state = Recording_state();
 }
 
 VkResult Vulkan_command_buffer::end() noexcept
@@ -35,8 +35,11 @@
 #include "util/optional.h"
 #include "util/circular_queue.h"
 #include "util/memory.h"
+#include "util/thread_pool.h"
+#include "util/virtual_memory.h"
 #include <memory>
 #include <cassert>
+#include <cstring>
 #include <chrono>
 #include <limits>
 #include <vector>
@@ -1548,6 +1551,14 @@ struct Vulkan_physical_device
         return heap_size;
     }
     static constexpr std::size_t main_memory_type_index = 0;
+    /** memory for transient attachments, which gives its pages back to the operating system when
+     * the attachment's contents are no longer needed; it isn't host visible */
+    static constexpr std::size_t lazily_allocated_memory_type_index = 1;
+    /** the largest framebuffer and viewport width and height; the rasterizer's guard band and
+     * fixed-point edge equations are sized to contain it */
+    static constexpr std::uint32_t max_framebuffer_size = 1UL << 20;
+    /** the minimum number of sub-pixel bits vertexes are snapped to */
+    static constexpr std::uint32_t sub_pixel_precision_bits = 8;
     Vulkan_physical_device(Vulkan_instance &instance) noexcept
         : instance(instance),
           properties{
@@ -1626,7 +1637,7 @@ struct Vulkan_physical_device
                               static_cast<std::uint32_t>(-1),
                               static_cast<std::uint32_t>(-1),
                           },
-                      .subPixelPrecisionBits = 16,
+                      .subPixelPrecisionBits = sub_pixel_precision_bits,
                       .subTexelPrecisionBits = 8,
                       .mipmapPrecisionBits = 8,
                       .maxDrawIndexedIndexValue = static_cast<std::uint32_t>(-1),
@@ -1636,11 +1647,11 @@ struct Vulkan_physical_device
                       .maxViewports = 1,
                       .maxViewportDimensions =
                           {
-                              1UL << 20, 1UL << 20,
+                              max_framebuffer_size, max_framebuffer_size,
                           },
                       .viewportBoundsRange =
                           {
-                              static_cast<float>(-1) * (1UL << 21), 1UL << 21,
+                              -2.0f * max_framebuffer_size, 2.0f * max_framebuffer_size,
                           },
                       .viewportSubPixelBits = 16,
                       .minMemoryMapAlignment = 64,
@@ -1654,14 +1665,25 @@ struct Vulkan_physical_device
                       .minInterpolationOffset = 0,
                       .maxInterpolationOffset = 0,
                       .subPixelInterpolationOffsetBits = 0,
-                      .maxFramebufferWidth = 1UL << 20,
-                      .maxFramebufferHeight = 1UL << 20,
+                      .maxFramebufferWidth = max_framebuffer_size,
+                      .maxFramebufferHeight = max_framebuffer_size,
                       .maxFramebufferLayers = static_cast<std::uint32_t>(-1),
-#warning fix up sample counts after adding multisampling
-                      .framebufferColorSampleCounts = VK_SAMPLE_COUNT_1_BIT,
-                      .framebufferDepthSampleCounts = VK_SAMPLE_COUNT_1_BIT,
-                      .framebufferStencilSampleCounts = VK_SAMPLE_COUNT_1_BIT,
-                      .framebufferNoAttachmentsSampleCounts = VK_SAMPLE_COUNT_1_BIT,
+                      .framebufferColorSampleCounts = VK_SAMPLE_COUNT_1_BIT
+                                                      | VK_SAMPLE_COUNT_2_BIT
+                                                      | VK_SAMPLE_COUNT_4_BIT
+                                                      | VK_SAMPLE_COUNT_8_BIT,
+                      .framebufferDepthSampleCounts = VK_SAMPLE_COUNT_1_BIT
+                                                      | VK_SAMPLE_COUNT_2_BIT
+                                                      | VK_SAMPLE_COUNT_4_BIT
+                                                      | VK_SAMPLE_COUNT_8_BIT,
+                      .framebufferStencilSampleCounts = VK_SAMPLE_COUNT_1_BIT
+                                                        | VK_SAMPLE_COUNT_2_BIT
+                                                        | VK_SAMPLE_COUNT_4_BIT
+                                                        | VK_SAMPLE_COUNT_8_BIT,
+                      .framebufferNoAttachmentsSampleCounts = VK_SAMPLE_COUNT_1_BIT
+                                                              | VK_SAMPLE_COUNT_2_BIT
+                                                              | VK_SAMPLE_COUNT_4_BIT
+                                                              | VK_SAMPLE_COUNT_8_BIT,
                       .maxColorAttachments = static_cast<std::uint32_t>(-1),
                       .sampledImageColorSampleCounts = VK_SAMPLE_COUNT_1_BIT,
                       .sampledImageIntegerSampleCounts = VK_SAMPLE_COUNT_1_BIT,
@@ -1680,16 +1702,15 @@ struct Vulkan_physical_device
                       .discreteQueuePriorities = 2,
                       .pointSizeRange =
                           {
-                              1, 1,
+                              1, 64,
                           },
                       .lineWidthRange =
                           {
-                              1, 1,
+                              1, 64,
                           },
-                      .pointSizeGranularity = 0,
-                      .lineWidthGranularity = 0,
-#warning update strictLines when the line rasterizer is implemented
-                      .strictLines = true,
+                      .pointSizeGranularity = 0.125f,
+                      .lineWidthGranularity = 0.125f,
+                      .strictLines = false,
                       .standardSampleLocations = true,
                       .optimalBufferCopyOffsetAlignment = 16,
                       .optimalBufferCopyRowPitchAlignment = 16,
@@ -1718,7 +1739,7 @@ struct Vulkan_physical_device
               },
           },
           memory_properties{
-              .memoryTypeCount = 1,
+              .memoryTypeCount = 2,
               .memoryTypes =
                   {
                       {
@@ -1728,6 +1749,11 @@ struct Vulkan_physical_device
                                            | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
                           .heapIndex = 0,
                       },
+                      {
+                          .propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                           | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                          .heapIndex = 0,
+                      },
                   },
               .memoryHeapCount = 1,
               .memoryHeaps =
@@ -1752,10 +1778,10 @@ struct Vulkan_physical_device
               .drawIndirectFirstInstance = true,
               .depthClamp = false,
               .depthBiasClamp = false,
-              .fillModeNonSolid = false,
+              .fillModeNonSolid = true,
               .depthBounds = false,
-              .wideLines = false,
-              .largePoints = false,
+              .wideLines = true,
+              .largePoints = true,
               .alphaToOne = false,
               .multiViewport = false,
               .samplerAnisotropy = false,
@@ -1803,25 +1829,60 @@ struct Vulkan_device_memory
     : public Vulkan_nondispatchable_object<Vulkan_device_memory, VkDeviceMemory>
 {
     static constexpr std::size_t alignment = 64;
+    static_assert(alignment <= util::Virtual_memory::min_alignment, "");
+    /** images and buffers are bound to ranges of memory, sharing ownership of it, so any number of
+     * them can alias the same range */
     std::shared_ptr<void> memory;
-    explicit Vulkan_device_memory(std::shared_ptr<void> memory) noexcept : memory(std::move(memory))
+    VkDeviceSize size;
+    std::uint32_t memory_type_index;
+    Vulkan_device_memory(std::shared_ptr<void> memory,
+                         VkDeviceSize size,
+                         std::uint32_t memory_type_index) noexcept
+        : memory(std::move(memory)),
+          size(size),
+          memory_type_index(memory_type_index)
+    {
+    }
+    /** returns the memory starting at offset, which shares ownership of this allocation */
+    std::shared_ptr<void> get_range(VkDeviceSize offset, VkDeviceSize range_size) const noexcept
+    {
+        assert(offset <= size && range_size <= size - offset);
+        static_cast<void>(range_size);
+        return std::shared_ptr<void>(memory, static_cast<unsigned char *>(memory.get()) + offset);
+    }
+    bool is_lazily_allocated() const noexcept
+    {
+        return memory_type_index == Vulkan_physical_device::lazily_allocated_memory_type_index;
+    }
+    /** returns an upper bound on the number of bytes that are committed; see
+     * util::Virtual_memory::get_committed_size */
+    VkDeviceSize get_committed_size() const noexcept
     {
+        return util::Virtual_memory::get_committed_size(memory.get(), size);
     }
+    /** device memory comes straight from the operating system's virtual memory, so pages are
+     * only committed when they're first written, and large allocations use huge pages */
     static std::shared_ptr<void> allocate(VkDeviceSize size)
     {
         if(static_cast<std::size_t>(size) != size)
             throw std::bad_alloc();
-        typedef util::Aligned_memory_allocator<alignment> Allocator;
-        return std::shared_ptr<void>(Allocator::allocate(size), Allocator::Deleter{});
+        // the deleter is called if the shared_ptr constructor throws
+        return std::shared_ptr<void>(
+            util::Virtual_memory::allocate(size),
+            util::Virtual_memory::Deleter{.size = static_cast<std::size_t>(size)});
     }
     static std::unique_ptr<Vulkan_device_memory> create(Vulkan_device &device,
                                                         const VkMemoryAllocateInfo &allocate_info)
     {
         static_cast<void>(device);
         assert(allocate_info.sType == VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
-        assert(allocate_info.memoryTypeIndex == Vulkan_physical_device::main_memory_type_index);
+        assert(allocate_info.memoryTypeIndex == Vulkan_physical_device::main_memory_type_index
+               || allocate_info.memoryTypeIndex
+                      == Vulkan_physical_device::lazily_allocated_memory_type_index);
         assert(allocate_info.allocationSize != 0);
-        return std::make_unique<Vulkan_device_memory>(allocate(allocate_info.allocationSize));
+        return std::make_unique<Vulkan_device_memory>(allocate(allocate_info.allocationSize),
+                                                      allocate_info.allocationSize,
+                                                      allocate_info.memoryTypeIndex);
     }
 };
 
@@ -2093,14 +2154,16 @@ struct Vulkan_device : public Vulkan_dispatchable_object<Vulkan_device, VkDevice
     static constexpr std::size_t queue_count = 1;
     std::unique_ptr<Queue> queues[queue_count];
     Supported_extensions extensions; // includes both device and instance extensions
+    util::Thread_pool worker_thread_pool; // shared by all the draws on this device
     explicit Vulkan_device(Vulkan_physical_device &physical_device,
                            const VkPhysicalDeviceFeatures &enabled_features,
-                           const Supported_extensions &extensions) noexcept
+                           const Supported_extensions &extensions)
         : instance(physical_device.instance),
           physical_device(physical_device),
           enabled_features(enabled_features),
           queues{},
-          extensions(extensions)
+          extensions(extensions),
+          worker_thread_pool()
     {
         for(auto &queue : queues)
             queue = std::make_unique<Queue>();
@@ -2124,9 +2187,12 @@ struct Vulkan_image_descriptor
     VkExtent3D extent;
     std::uint32_t mip_levels;
     std::uint32_t array_layers;
-    static constexpr VkSampleCountFlags supported_samples = VK_SAMPLE_COUNT_1_BIT;
+    static constexpr VkSampleCountFlags supported_samples =
+        VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_2_BIT | VK_SAMPLE_COUNT_4_BIT
+        | VK_SAMPLE_COUNT_8_BIT;
     VkSampleCountFlagBits samples;
     VkImageTiling tiling;
+    VkImageUsageFlags usage;
     constexpr Vulkan_image_descriptor() noexcept : flags(),
                                                    type(),
                                                    format(),
@@ -2134,7 +2200,8 @@ struct Vulkan_image_descriptor
                                                    mip_levels(),
                                                    array_layers(),
                                                    samples(),
-                                                   tiling()
+                                                   tiling(),
+                                                   usage()
     {
     }
     constexpr explicit Vulkan_image_descriptor(const VkImageCreateInfo &image_create_info) noexcept
@@ -2145,7 +2212,8 @@ struct Vulkan_image_descriptor
           mip_levels(image_create_info.mipLevels),
           array_layers(image_create_info.arrayLayers),
           samples(image_create_info.samples),
-          tiling(image_create_info.tiling)
+          tiling(image_create_info.tiling),
+          usage(image_create_info.usage)
     {
         assert(image_create_info.sType == VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO);
         assert((flags & ~supported_flags) == 0);
@@ -2160,7 +2228,14 @@ struct Vulkan_image_descriptor
 
         switch(format)
         {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
         case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
         case VK_FORMAT_D32_SFLOAT_S8_UINT:
         case VK_FORMAT_D32_SFLOAT:
             break;
@@ -2169,8 +2244,10 @@ struct Vulkan_image_descriptor
         }
         assert(mip_levels == 1 && "mipmapping is unimplemented");
         assert(array_layers == 1 && "array images are unimplemented");
+        // images don't keep any layout state, so preinitialized images, such as linear images
+        // bound to memory that the application already wrote, keep their contents
         assert(image_create_info.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED
-               && "preinitialized images are unimplemented");
+               || image_create_info.initialLayout == VK_IMAGE_LAYOUT_PREINITIALIZED);
     }
     constexpr Vulkan_image_descriptor(VkImageCreateFlags flags,
                                       VkImageType type,
@@ -2179,21 +2256,40 @@ struct Vulkan_image_descriptor
                                       std::uint32_t mip_levels,
                                       std::uint32_t array_layers,
                                       VkSampleCountFlagBits samples,
-                                      VkImageTiling tiling) noexcept : flags(flags),
-                                                                       type(type),
-                                                                       format(format),
-                                                                       extent(extent),
-                                                                       mip_levels(mip_levels),
-                                                                       array_layers(array_layers),
-                                                                       samples(samples),
-                                                                       tiling(tiling)
+                                      VkImageTiling tiling,
+                                      VkImageUsageFlags usage) noexcept
+        : flags(flags),
+          type(type),
+          format(format),
+          extent(extent),
+          mip_levels(mip_levels),
+          array_layers(array_layers),
+          samples(samples),
+          tiling(tiling),
+          usage(usage)
     {
     }
+    /** VkSampleCountFlagBits values are the sample count */
+    constexpr std::uint32_t get_sample_count() const noexcept
+    {
+        return static_cast<std::uint32_t>(samples);
+    }
+    /** images with VK_IMAGE_TILING_OPTIMAL use the tiled layout: each sample plane is split into
+     * macro-tiles of macro_tile_size by macro_tile_size pixels, stored in row-major order; each
+     * macro-tile is split into micro-tiles of micro_tile_size by micro_tile_size pixels, stored
+     * in row-major order, and the pixels of each micro-tile are stored in row-major order.
+     * Images with VK_IMAGE_TILING_LINEAR, which includes the images that the application and the
+     * WSI read and write directly, store rows of pixels one after another. */
+    static constexpr std::uint32_t log2_micro_tile_size = 3;
+    static constexpr std::uint32_t micro_tile_size = 1UL << log2_micro_tile_size;
+    static constexpr std::uint32_t log2_macro_tile_size = 6;
+    static constexpr std::uint32_t macro_tile_size = 1UL << log2_macro_tile_size;
     struct Image_memory_properties
     {
         std::size_t array_layer_size;
         std::size_t size;
-        std::size_t alignment = util::get_max_align_alignment();
+        /** every image starts on a cache line, so macro-tiles of the tiled layout do too */
+        std::size_t alignment = Vulkan_device_memory::alignment;
         static constexpr std::size_t max_subimage_count = 2;
         std::size_t subimage_count;
         struct Subimage
@@ -2207,27 +2303,86 @@ struct Vulkan_image_descriptor
             };
             Component component;
             std::size_t size;
+            /** multisample images store each sample in a separate plane of sample_plane_size
+             * bytes, one after another; sample i of pixel (x, y) is at
+             * i * sample_plane_size + get_pixel_offset(x, y) */
+            std::size_t sample_plane_size;
+            /** the size of a row of pixels, or of a row of macro-tiles for the tiled layout */
             std::size_t stride;
             std::size_t pixel_size;
             std::size_t offset_from_array_layer_start;
+            bool is_tiled;
             constexpr Subimage() noexcept : component(Component::None),
                                             size(0),
+                                            sample_plane_size(0),
                                             stride(0),
                                             pixel_size(0),
-                                            offset_from_array_layer_start(0)
+                                            offset_from_array_layer_start(0),
+                                            is_tiled(false)
             {
             }
             constexpr Subimage(Component component,
                                std::size_t size,
+                               std::size_t sample_plane_size,
                                std::size_t stride,
                                std::size_t pixel_size,
-                               std::size_t offset_from_array_layer_start) noexcept
+                               std::size_t offset_from_array_layer_start,
+                               bool is_tiled) noexcept
                 : component(component),
                   size(size),
+                  sample_plane_size(sample_plane_size),
                   stride(stride),
                   pixel_size(pixel_size),
-                  offset_from_array_layer_start(offset_from_array_layer_start)
+                  offset_from_array_layer_start(offset_from_array_layer_start),
+                  is_tiled(is_tiled)
+            {
+            }
+            /** returns the offset of pixel (x, y) from the start of its sample plane */
+            constexpr std::size_t get_pixel_offset(std::uint32_t x, std::uint32_t y) const
+                noexcept
             {
+                if(!is_tiled)
+                    return y * stride + x * pixel_size;
+                constexpr std::uint32_t micro_tile_mask = micro_tile_size - 1;
+                constexpr std::uint32_t macro_tile_mask = macro_tile_size - 1;
+                constexpr std::uint32_t log2_micro_tiles_per_row =
+                    log2_macro_tile_size - log2_micro_tile_size;
+                std::uint32_t macro_tile_x = x & macro_tile_mask;
+                std::uint32_t macro_tile_y = y & macro_tile_mask;
+                std::size_t micro_tile_index =
+                    ((macro_tile_y >> log2_micro_tile_size) << log2_micro_tiles_per_row)
+                    | (macro_tile_x >> log2_micro_tile_size);
+                std::size_t pixel_index = (micro_tile_index << (2 * log2_micro_tile_size))
+                                          | ((macro_tile_y & micro_tile_mask)
+                                             << log2_micro_tile_size)
+                                          | (macro_tile_x & micro_tile_mask);
+                std::size_t macro_tile_index = x >> log2_macro_tile_size;
+                return (y >> log2_macro_tile_size) * stride
+                       + ((macro_tile_index << (2 * log2_macro_tile_size)) + pixel_index)
+                             * pixel_size;
+            }
+            constexpr VkImageAspectFlags get_aspect_mask() const noexcept
+            {
+                switch(component)
+                {
+                case Component::None:
+                    break;
+                case Component::Color:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+                case Component::Depth:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case Component::Stencil:
+                    return VK_IMAGE_ASPECT_STENCIL_BIT;
+                }
+                return 0;
+            }
+            /** returns the number of pixels starting at (x, y) that are contiguous in memory,
+             * which can be more than are left in the row */
+            constexpr std::uint32_t get_contiguous_pixel_count(std::uint32_t x) const noexcept
+            {
+                if(!is_tiled)
+                    return static_cast<std::uint32_t>(-1);
+                return micro_tile_size - (x & (micro_tile_size - 1));
             }
         };
         Subimage subimages[max_subimage_count];
@@ -2257,6 +2412,13 @@ struct Vulkan_image_descriptor
             assert(!"image component not found");
             return {};
         }
+        constexpr VkImageAspectFlags get_aspect_mask() const noexcept
+        {
+            VkImageAspectFlags retval = 0;
+            for(std::size_t i = 0; i < subimage_count; i++)
+                retval |= subimages[i].get_aspect_mask();
+            return retval;
+        }
         constexpr Subimage get_color_component() const noexcept
         {
             return get_component(Subimage::Component::Color);
@@ -2270,10 +2432,44 @@ struct Vulkan_image_descriptor
             return get_component(Subimage::Component::Stencil);
         }
     };
+    /** returns the layout of a subimage with pixel_size byte pixels, using the image's tiling;
+     * rows of the linear layout are padded to a multiple of row_alignment bytes */
+    constexpr Image_memory_properties::Subimage get_subimage(
+        Image_memory_properties::Subimage::Component component,
+        std::size_t pixel_size,
+        std::size_t row_alignment,
+        std::size_t offset_from_array_layer_start) const noexcept
+    {
+        if(tiling == VK_IMAGE_TILING_OPTIMAL)
+        {
+            // partial macro-tiles at the right and bottom edges are padded
+            std::size_t macro_tile_size_in_bytes = macro_tile_size * macro_tile_size * pixel_size;
+            std::size_t stride =
+                ((extent.width + macro_tile_size - 1) >> log2_macro_tile_size)
+                * macro_tile_size_in_bytes;
+            std::size_t sample_plane_size =
+                stride * ((extent.height + macro_tile_size - 1) >> log2_macro_tile_size);
+            return Image_memory_properties::Subimage(component,
+                                                     sample_plane_size * get_sample_count(),
+                                                     sample_plane_size,
+                                                     stride,
+                                                     pixel_size,
+                                                     offset_from_array_layer_start,
+                                                     true);
+        }
+        std::size_t stride = (pixel_size * extent.width + row_alignment - 1) & ~(row_alignment - 1);
+        std::size_t sample_plane_size = stride * extent.height;
+        return Image_memory_properties::Subimage(component,
+                                                 sample_plane_size * get_sample_count(),
+                                                 sample_plane_size,
+                                                 stride,
+                                                 pixel_size,
+                                                 offset_from_array_layer_start,
+                                                 false);
+    }
     constexpr Image_memory_properties get_memory_properties() const noexcept
     {
 #warning finish implementing Image
-        assert(samples == VK_SAMPLE_COUNT_1_BIT && "multisample images are unimplemented");
         assert(extent.width > 0);
         assert(extent.height > 0);
         assert(extent.depth > 0);
@@ -2284,60 +2480,46 @@ struct Vulkan_image_descriptor
         assert(mip_levels == 1 && "mipmapping is unimplemented");
         assert(array_layers == 1 && "array images are unimplemented");
 
-#warning implement non-linear image tiling
         switch(format)
         {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
         case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
         {
             std::size_t pixel_size = sizeof(std::uint32_t);
-            std::size_t stride = pixel_size * extent.width;
-            std::size_t subimage_size = stride * extent.height;
-            return Image_memory_properties(array_layers,
-                                           Image_memory_properties::Subimage(
-                                               Image_memory_properties::Subimage::Component::Color,
-                                               subimage_size,
-                                               stride,
-                                               pixel_size,
-                                               0));
+            if(format == VK_FORMAT_R16G16B16A16_SFLOAT)
+                pixel_size = 4 * sizeof(std::uint16_t);
+            else if(format == VK_FORMAT_R32G32B32A32_SFLOAT)
+                pixel_size = 4 * sizeof(float);
+            return Image_memory_properties(
+                array_layers,
+                get_subimage(
+                    Image_memory_properties::Subimage::Component::Color, pixel_size, 1, 0));
         }
         case VK_FORMAT_D32_SFLOAT:
         {
-            std::size_t pixel_size = sizeof(float);
-            std::size_t stride = pixel_size * extent.width;
-            std::size_t subimage_size = stride * extent.height;
-            return Image_memory_properties(array_layers,
-                                           Image_memory_properties::Subimage(
-                                               Image_memory_properties::Subimage::Component::Depth,
-                                               subimage_size,
-                                               stride,
-                                               pixel_size,
-                                               0));
+            return Image_memory_properties(
+                array_layers,
+                get_subimage(
+                    Image_memory_properties::Subimage::Component::Depth, sizeof(float), 1, 0));
         }
         case VK_FORMAT_D32_SFLOAT_S8_UINT:
         {
-            std::size_t depth_pixel_size = sizeof(float);
-            std::size_t stencil_pixel_size = sizeof(std::uint8_t);
-            std::size_t depth_stride = depth_pixel_size * extent.width;
-            std::size_t stencil_stride = stencil_pixel_size * extent.width;
-            static_assert(sizeof(float) == 4, "");
-            // round stencil_stride up to multiple of sizeof(float)
-            stencil_stride = (stencil_stride + sizeof(float) - 1) & ~(sizeof(float) - 1);
-            std::size_t depth_subimage_size = depth_stride * extent.height;
-            std::size_t stencil_subimage_size = stencil_stride * extent.height;
+            auto depth_subimage = get_subimage(
+                Image_memory_properties::Subimage::Component::Depth, sizeof(float), 1, 0);
+            // round the stencil rows up to a multiple of sizeof(float)
             return Image_memory_properties(
                 array_layers,
-                Image_memory_properties::Subimage(
-                    Image_memory_properties::Subimage::Component::Depth,
-                    depth_subimage_size,
-                    depth_stride,
-                    depth_pixel_size,
-                    0),
-                Image_memory_properties::Subimage(
-                    Image_memory_properties::Subimage::Component::Stencil,
-                    stencil_subimage_size,
-                    stencil_stride,
-                    stencil_pixel_size,
-                    depth_subimage_size));
+                depth_subimage,
+                get_subimage(Image_memory_properties::Subimage::Component::Stencil,
+                             sizeof(std::uint8_t),
+                             sizeof(float),
+                             depth_subimage.size));
         }
         default:
             assert(!"unimplemented image format");
@@ -2347,10 +2529,13 @@ struct Vulkan_image_descriptor
     constexpr VkMemoryRequirements get_memory_requirements() const noexcept
     {
         auto memory_properties = get_memory_properties();
+        std::uint32_t memory_type_bits = 1UL << Vulkan_physical_device::main_memory_type_index;
+        if(usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+            memory_type_bits |= 1UL << Vulkan_physical_device::lazily_allocated_memory_type_index;
         return {
             .size = memory_properties.size,
             .alignment = memory_properties.alignment,
-            .memoryTypeBits = 1UL << Vulkan_physical_device::main_memory_type_index,
+            .memoryTypeBits = memory_type_bits,
         };
     }
 };
@@ -2359,23 +2544,135 @@ struct Vulkan_image : public Vulkan_nondispatchable_object<Vulkan_image, VkImage
 {
     const Vulkan_image_descriptor descriptor;
     std::shared_ptr<void> memory;
-    Vulkan_image(const Vulkan_image_descriptor &descriptor,
-                 std::shared_ptr<void> memory = nullptr) noexcept : descriptor(descriptor),
-                                                                    memory(std::move(memory))
+    /** multisample color images keep pixels that have the same color in all samples compressed:
+     * when the pixel's bit is set, only sample 0 is up to date. Bit i of byte
+     * y * get_sample_compression_mask_stride() + x / 8 is for pixel (x - x % 8 + i, y). Null for
+     * other images. */
+    std::unique_ptr<std::uint8_t[]> sample_compression_masks;
+    /** tiled images are cleared lazily: clear and clear_depth_stencil only pack the clear value
+     * of each cleared subimage into clear_pixels and mark every macro-tile cleared, and the
+     * pixels of a cleared macro-tile are written by fill_cleared_tile right before the tile is
+     * next accessed. Byte tile_y * get_cleared_tile_stride() + tile_x has the
+     * VkImageAspectFlags of the aspects that are cleared in macro-tile (tile_x, tile_y). Null for
+     * linear images, which are cleared right away since the application and the WSI read them
+     * directly. */
+    std::unique_ptr<std::uint8_t[]> cleared_tiles;
+    static constexpr std::size_t max_pixel_size = 4 * sizeof(float);
+    /** the packed clear value of each subimage, in the order of
+     * Image_memory_properties::subimages */
+    unsigned char clear_pixels[Vulkan_image_descriptor::Image_memory_properties::max_subimage_count]
+                              [max_pixel_size];
+    /** true when memory is in a lazily allocated Vulkan_device_memory */
+    bool is_memory_lazily_allocated;
+    Vulkan_image(const Vulkan_image_descriptor &descriptor, std::shared_ptr<void> memory = nullptr)
+        : descriptor(descriptor),
+          memory(std::move(memory)),
+          sample_compression_masks(),
+          cleared_tiles(),
+          clear_pixels(),
+          is_memory_lazily_allocated(false)
+    {
+        if(descriptor.samples != VK_SAMPLE_COUNT_1_BIT
+           && descriptor.get_memory_properties().subimages[0].component
+                  == Vulkan_image_descriptor::Image_memory_properties::Subimage::Component::Color)
+        {
+            // the samples start out uncompressed, since the image contents are undefined
+            std::size_t size = get_sample_compression_mask_stride() * descriptor.extent.height;
+            sample_compression_masks.reset(new std::uint8_t[size]);
+            std::memset(sample_compression_masks.get(), 0, size);
+        }
+        if(descriptor.tiling == VK_IMAGE_TILING_OPTIMAL)
+        {
+            // no tiles start out cleared, since the image contents are undefined
+            std::size_t size = get_cleared_tile_stride() * get_cleared_tile_row_count();
+            cleared_tiles.reset(new std::uint8_t[size]);
+            std::memset(cleared_tiles.get(), 0, size);
+        }
+    }
+    std::size_t get_sample_compression_mask_stride() const noexcept
+    {
+        return (descriptor.extent.width + 7) / 8;
+    }
+    std::uint8_t &get_sample_compression_mask(std::uint32_t x, std::uint32_t y) const noexcept
+    {
+        assert(sample_compression_masks);
+        return sample_compression_masks[y * get_sample_compression_mask_stride() + x / 8];
+    }
+    std::size_t get_cleared_tile_stride() const noexcept
+    {
+        return (descriptor.extent.width + Vulkan_image_descriptor::macro_tile_size - 1)
+               >> Vulkan_image_descriptor::log2_macro_tile_size;
+    }
+    std::size_t get_cleared_tile_row_count() const noexcept
     {
+        return (descriptor.extent.height + Vulkan_image_descriptor::macro_tile_size - 1)
+               >> Vulkan_image_descriptor::log2_macro_tile_size;
     }
+    std::uint8_t &get_cleared_tile(std::uint32_t tile_x, std::uint32_t tile_y) const noexcept
+    {
+        assert(cleared_tiles);
+        return cleared_tiles[tile_y * get_cleared_tile_stride() + tile_x];
+    }
+    /** returns true if pixel (x, y) is in a macro-tile where the color is cleared, so it has the
+     * color in clear_pixels[0] instead of the color in memory */
+    bool is_pixel_in_cleared_tile(std::uint32_t x, std::uint32_t y) const noexcept
+    {
+        return cleared_tiles
+               && (get_cleared_tile(x >> Vulkan_image_descriptor::log2_macro_tile_size,
+                                    y >> Vulkan_image_descriptor::log2_macro_tile_size)
+                   & VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    /** marks the aspects in aspect_mask of every macro-tile not cleared without writing them, for
+     * when the image contents become undefined */
+    void discard_clears(VkImageAspectFlags aspect_mask) noexcept
+    {
+        if(!cleared_tiles)
+            return;
+        for(std::size_t i = 0; i < get_cleared_tile_stride() * get_cleared_tile_row_count(); i++)
+            cleared_tiles[i] &= ~aspect_mask;
+    }
+    /** discards the clears of every aspect, for when the whole image's contents are no longer
+     * needed, and gives the pages of lazily allocated memory back to the operating system;
+     * they're committed again when next written. Pages shared with other resources bound to the
+     * same memory are kept. */
+    void release_memory() noexcept
+    {
+        auto memory_properties = descriptor.get_memory_properties();
+        discard_clears(memory_properties.get_aspect_mask());
+        if(!is_memory_lazily_allocated)
+            return;
+        util::Virtual_memory::decommit(memory.get(), memory_properties.size);
+    }
+    /** creates an image with its own memory, for images that aren't bound to memory allocated
+     * by the application */
     static std::unique_ptr<Vulkan_image> create_with_memory(
         const Vulkan_image_descriptor &descriptor)
     {
-        std::shared_ptr<unsigned char> memory(
-            new unsigned char[descriptor.get_memory_properties().size],
-            [](unsigned char *p) noexcept
-            {
-                delete[] p;
-            });
-        return std::make_unique<Vulkan_image>(descriptor, std::move(memory));
+        return std::make_unique<Vulkan_image>(
+            descriptor,
+            Vulkan_device_memory::allocate(descriptor.get_memory_properties().size));
     }
     void clear(VkClearColorValue color) noexcept;
+    void clear_depth_stencil(VkClearDepthStencilValue value,
+                             VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT
+                                                              | VK_IMAGE_ASPECT_STENCIL_BIT) noexcept;
+    /** writes the clear value to the pixels of macro-tile (tile_x, tile_y) in every subimage
+     * that's cleared there, then marks it not cleared. Multisample color images only write
+     * sample 0, since clear marks every pixel compressed. */
+    void fill_cleared_tile(std::uint32_t tile_x, std::uint32_t tile_y) const noexcept;
+    /** prepares the rectangle of color pixels to be overwritten: macro-tiles with a cleared
+     * color that are entirely inside the rectangle are marked not cleared without writing them,
+     * and the other cleared macro-tiles that overlap it are filled */
+    void prepare_for_overwrite(std::uint32_t x,
+                               std::uint32_t y,
+                               std::uint32_t width,
+                               std::uint32_t height) noexcept;
+    /** copies sample 0 to the other samples of the compressed pixels (x + i, y) that have bit i
+     * of lane_mask set, then marks them uncompressed; x is a multiple of 8 */
+    void decompress_samples(std::uint32_t x, std::uint32_t y, std::uint32_t lane_mask) const
+        noexcept;
+    /** resolves region of this multisample color image into the single-sample destination */
+    void resolve(Vulkan_image &destination, const VkImageResolve &region) const noexcept;
     virtual ~Vulkan_image() = default;
 #warning finish implementing Vulkan_image
     static std::unique_ptr<Vulkan_image> create(Vulkan_device &device,
@@ -2505,13 +2802,15 @@ struct Vulkan_render_pass : public Vulkan_nondispatchable_object<Vulkan_render_p
 {
 #warning finish implementing Vulkan_render_pass
     std::vector<VkAttachmentDescription> attachments;
-    std::uint32_t color_attachment_index;
+    /** the attachment index for each color attachment (fragment shader output Location) of the
+     * subpass; VK_ATTACHMENT_UNUSED for unused color attachments */
+    std::vector<std::uint32_t> color_attachment_indexes;
     util::optional<std::uint32_t> depth_stencil_attachment_index;
     Vulkan_render_pass(std::vector<VkAttachmentDescription> attachments,
-                       std::uint32_t color_attachment_index,
+                       std::vector<std::uint32_t> color_attachment_indexes,
                        util::optional<std::uint32_t> depth_stencil_attachment_index) noexcept
         : attachments(std::move(attachments)),
-          color_attachment_index(color_attachment_index),
+          color_attachment_indexes(std::move(color_attachment_indexes)),
           depth_stencil_attachment_index(depth_stencil_attachment_index)
     {
     }
@@ -2572,11 +2871,34 @@ struct Vulkan_command_buffer
         Executable,
         Out_of_memory,
     };
+    /** the state set by the bind and render pass commands; draw commands copy the parts they use
+     * when they're recorded */
+    struct Recording_state
+    {
+        VkPipeline graphics_pipeline;
+        /** the address of each bound vertex buffer, including the binding offset */
+        std::vector<void *> vertex_buffers;
+        /** the address of the bound index buffer, including the binding offset */
+        const void *index_buffer;
+        VkIndexType index_type;
+        Vulkan_framebuffer *framebuffer;
+        /** set by vkCmdSetLineWidth */
+        float line_width;
+        Recording_state() noexcept : graphics_pipeline(VK_NULL_HANDLE),
+                                     vertex_buffers(),
+                                     index_buffer(nullptr),
+                                     index_type(VK_INDEX_TYPE_UINT16),
+                                     framebuffer(nullptr),
+                                     line_width(1)
+        {
+        }
+    };
     std::list<std::unique_ptr<Vulkan_command_buffer>>::iterator iter;
     Vulkan_command_pool &command_pool;
     Vulkan_device &device;
     std::vector<std::unique_ptr<Command>> commands;
     Command_buffer_state state;
+    Recording_state recording_state;
     Vulkan_command_buffer(std::list<std::unique_ptr<Vulkan_command_buffer>>::iterator iter,
                           Vulkan_command_pool &command_pool,
                           Vulkan_device &device) noexcept;
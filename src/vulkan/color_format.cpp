@@ -0,0 +1,241 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "color_format.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <cassert>
+#include <utility>
+
+namespace kazan
+{
+namespace vulkan
+{
+util::optional<Color_format_layout> Color_format_layout::get(VkFormat format) noexcept
+{
+    switch(format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return Color_format_layout{.kind = Kind::Unorm8, .swap_red_and_blue = false};
+    case VK_FORMAT_B8G8R8A8_UNORM:
+        return Color_format_layout{.kind = Kind::Unorm8, .swap_red_and_blue = true};
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return Color_format_layout{.kind = Kind::Srgb8, .swap_red_and_blue = false};
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return Color_format_layout{.kind = Kind::Srgb8, .swap_red_and_blue = true};
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        return Color_format_layout{.kind = Kind::Unorm10_10_10_2, .swap_red_and_blue = false};
+    case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        return Color_format_layout{.kind = Kind::Unorm10_10_10_2, .swap_red_and_blue = true};
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return Color_format_layout{.kind = Kind::Float16, .swap_red_and_blue = false};
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return Color_format_layout{.kind = Kind::Float32, .swap_red_and_blue = false};
+    default:
+#warning implement more color attachment formats
+        return {};
+    }
+}
+
+void Color_format_layout::pack(const float color[4], void *pixel) const noexcept
+{
+    float components[4] = {
+        color[0], color[1], color[2], color[3],
+    };
+    if(swap_red_and_blue)
+        std::swap(components[0], components[2]);
+    switch(kind)
+    {
+    case Kind::Unorm8:
+    case Kind::Srgb8:
+    {
+        std::uint8_t bytes[4];
+        for(std::size_t i = 0; i < 4; i++)
+        {
+            float value = components[i];
+            // alpha is always linear
+            if(kind == Kind::Srgb8 && i != 3)
+                value = linear_to_srgb(value);
+            bytes[i] = float_to_unorm(value, 0xFF);
+        }
+        std::memcpy(pixel, bytes, sizeof(bytes));
+        return;
+    }
+    case Kind::Unorm10_10_10_2:
+    {
+        std::uint32_t value = float_to_unorm(components[0], 0x3FF)
+                              | float_to_unorm(components[1], 0x3FF) << 10
+                              | float_to_unorm(components[2], 0x3FF) << 20
+                              | float_to_unorm(components[3], 0x3) << 30;
+        std::memcpy(pixel, &value, sizeof(value));
+        return;
+    }
+    case Kind::Float16:
+    {
+        std::uint16_t values[4];
+        for(std::size_t i = 0; i < 4; i++)
+            values[i] = float_to_half(components[i]);
+        std::memcpy(pixel, values, sizeof(values));
+        return;
+    }
+    case Kind::Float32:
+        std::memcpy(pixel, components, sizeof(components));
+        return;
+    }
+    assert(!"unknown color format kind");
+}
+
+std::uint32_t float_to_unorm(float value, std::uint32_t max_value) noexcept
+{
+    if(!(value >= 0))
+        value = 0;
+    else if(value > 1)
+        value = 1;
+    return static_cast<std::uint32_t>(value * std::nextafter(max_value + 1.0f, 0.0f));
+}
+
+std::uint16_t float_to_half(float value) noexcept
+{
+    std::uint32_t bits;
+    static_assert(sizeof(bits) == sizeof(value), "");
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000U);
+    std::uint32_t magnitude_bits = bits & 0x7FFFFFFFUL;
+    constexpr std::uint32_t float_infinity_bits = 0x7F800000UL;
+    constexpr std::uint16_t half_infinity_bits = 0x7C00U;
+    constexpr std::uint16_t half_quiet_nan_bit = 0x200U;
+    if(magnitude_bits > float_infinity_bits)
+        return sign | half_infinity_bits | half_quiet_nan_bit;
+    // 65520 is the smallest value that rounds to infinity
+    if(magnitude_bits >= 0x477FF000UL)
+        return sign | half_infinity_bits;
+    // 2^-14 is the smallest normal half
+    if(magnitude_bits < 0x38800000UL)
+    {
+        float magnitude;
+        std::memcpy(&magnitude, &magnitude_bits, sizeof(magnitude));
+        // scale so the smallest subnormal half is 1; multiplying by 2^24 is exact and rounding up
+        // to 0x400 gives the smallest normal half
+        return sign | static_cast<std::uint16_t>(std::nearbyint(magnitude * 16777216.0f));
+    }
+    // round to nearest even, the carry out of the mantissa increments the exponent
+    magnitude_bits += 0xFFFU + ((magnitude_bits >> 13) & 1);
+    // rebias the exponent from 127 to 15
+    return sign | static_cast<std::uint16_t>((magnitude_bits - 0x38000000UL) >> 13);
+}
+
+float half_to_float(std::uint16_t value) noexcept
+{
+    std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000U) << 16;
+    std::uint32_t exponent = (value >> 10) & 0x1FU;
+    std::uint32_t mantissa = value & 0x3FFU;
+    std::uint32_t bits;
+    if(exponent == 0x1FU)
+    {
+        bits = sign | 0x7F800000UL | (mantissa << 13);
+    }
+    else if(exponent == 0)
+    {
+        // zero and subnormals are mantissa * 2^-24, which is exact in float
+        float magnitude = mantissa * (1.0f / 16777216.0f);
+        std::memcpy(&bits, &magnitude, sizeof(bits));
+        bits |= sign;
+    }
+    else
+    {
+        // rebias the exponent from 15 to 127
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float retval;
+    static_assert(sizeof(bits) == sizeof(retval), "");
+    std::memcpy(&retval, &bits, sizeof(retval));
+    return retval;
+}
+
+float linear_to_srgb(float value) noexcept
+{
+    if(value <= 0.0031308f)
+        return value * 12.92f;
+    return 1.055 * std::pow(static_cast<double>(value), 1 / 2.4) - 0.055;
+}
+
+float srgb_to_linear(float value) noexcept
+{
+    if(value <= 0.04045f)
+        return value * (1 / 12.92f);
+    return std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+namespace
+{
+struct Srgb8_tables
+{
+    float encode_thresholds[0x101];
+    float decode_table[0x100];
+    Srgb8_tables() noexcept
+    {
+        auto encode = [](std::uint32_t bits) noexcept->std::uint32_t
+        {
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return float_to_unorm(linear_to_srgb(value), 0xFF);
+        };
+        constexpr std::uint32_t one_bits = 0x3F800000UL;
+        encode_thresholds[0] = 0;
+        for(std::uint32_t i = 1; i < 0x100; i++)
+        {
+            // binary search for the first non-negative float that encodes to at least i
+            std::uint32_t low_bits = 0, high_bits = one_bits;
+            while(low_bits < high_bits)
+            {
+                auto middle_bits = low_bits + (high_bits - low_bits) / 2;
+                if(encode(middle_bits) >= i)
+                    high_bits = middle_bits;
+                else
+                    low_bits = middle_bits + 1;
+            }
+            std::memcpy(&encode_thresholds[i], &low_bits, sizeof(float));
+        }
+        encode_thresholds[0x100] = std::numeric_limits<float>::infinity();
+        for(std::uint32_t i = 0; i < 0x100; i++)
+            decode_table[i] = srgb_to_linear(i / 255.0f);
+    }
+    static const Srgb8_tables &get() noexcept
+    {
+        static const Srgb8_tables tables;
+        return tables;
+    }
+};
+}
+
+const float *get_srgb8_encode_thresholds() noexcept
+{
+    return Srgb8_tables::get().encode_thresholds;
+}
+
+const float *get_srgb8_decode_table() noexcept
+{
+    return Srgb8_tables::get().decode_table;
+}
+}
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef VULKAN_COLOR_FORMAT_H_
+#define VULKAN_COLOR_FORMAT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "vulkan/vulkan.h"
+#include "vulkan/remove_xlib_macros.h"
+#include "util/optional.h"
+
+namespace kazan
+{
+namespace vulkan
+{
+/** how the pixels of a color attachment format are stored. The fragment shader's conversion to
+ * the format is JIT compiled, see spirv_to_llvm/fragment_entry_point.cpp; the functions here do
+ * the same conversions on the CPU, for clearing images. */
+struct Color_format_layout
+{
+    enum class Kind
+    {
+        /** 4 8-bit unsigned normalized components */
+        Unorm8,
+        /** 4 8-bit components, with the color components sRGB encoded */
+        Srgb8,
+        /** 3 10-bit and 1 2-bit unsigned normalized components packed into 32 bits, starting at
+         * the least significant bit */
+        Unorm10_10_10_2,
+        /** 4 16-bit floating-point components */
+        Float16,
+        /** 4 32-bit floating-point components */
+        Float32,
+    };
+    Kind kind;
+    /** the red and blue components are swapped in memory, as in VK_FORMAT_B8G8R8A8_UNORM */
+    bool swap_red_and_blue;
+    constexpr std::size_t get_pixel_size() const noexcept
+    {
+        switch(kind)
+        {
+        case Kind::Unorm8:
+        case Kind::Srgb8:
+        case Kind::Unorm10_10_10_2:
+            break;
+        case Kind::Float16:
+            return 4 * sizeof(std::uint16_t);
+        case Kind::Float32:
+            return 4 * sizeof(float);
+        }
+        return sizeof(std::uint32_t);
+    }
+    /** the components are clamped to [0, 1] before they are converted */
+    constexpr bool is_normalized() const noexcept
+    {
+        return kind != Kind::Float16 && kind != Kind::Float32;
+    }
+    /** the logic op is only applied to formats that aren't floating-point or sRGB */
+    constexpr bool supports_logic_op() const noexcept
+    {
+        return kind == Kind::Unorm8 || kind == Kind::Unorm10_10_10_2;
+    }
+    /** returns the layout of format or nullopt if format can't be used as a color attachment */
+    static util::optional<Color_format_layout> get(VkFormat format) noexcept;
+    /** converts the R, G, B, A color to a pixel of get_pixel_size() bytes */
+    void pack(const float color[4], void *pixel) const noexcept;
+};
+
+/** converts a value in [0, 1] to an integer in [0, max_value], clamping values outside of
+ * [0, 1]; maps equal-sized ranges to each integer, the same as the JIT compiled conversion */
+std::uint32_t float_to_unorm(float value, std::uint32_t max_value) noexcept;
+
+/** converts to IEEE 754 half precision, rounding to nearest even */
+std::uint16_t float_to_half(float value) noexcept;
+
+/** converts from IEEE 754 half precision; exact */
+float half_to_float(std::uint16_t value) noexcept;
+
+float linear_to_srgb(float value) noexcept;
+
+float srgb_to_linear(float value) noexcept;
+
+/** the smallest linear value in [0, 1] that is converted to each 8-bit sRGB value. Has 257
+ * elements; the last one is infinity, so the element after any 8-bit value can be read. */
+const float *get_srgb8_encode_thresholds() noexcept;
+
+/** the linear value of each 8-bit sRGB value. Has 256 elements. */
+const float *get_srgb8_decode_table() noexcept;
+}
+}
+
+#endif // VULKAN_COLOR_FORMAT_H_
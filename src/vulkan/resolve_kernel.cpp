@@ -0,0 +1,149 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "resolve_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VULKAN_RESOLVE_KERNEL_HAS_X86_KERNELS 1
+#else
+#define VULKAN_RESOLVE_KERNEL_HAS_X86_KERNELS 0
+#endif
+
+namespace kazan
+{
+namespace vulkan
+{
+namespace
+{
+void resolve_unorm8_generic(unsigned char *destination,
+                            const unsigned char *source,
+                            std::size_t sample_plane_size,
+                            std::uint32_t log2_sample_count,
+                            std::size_t byte_count)
+{
+    std::uint32_t sample_count = 1UL << log2_sample_count;
+    std::uint32_t rounding = sample_count / 2;
+    for(std::size_t i = 0; i < byte_count; i++)
+    {
+        std::uint32_t sum = rounding;
+        for(std::uint32_t sample = 0; sample < sample_count; sample++)
+            sum += source[i + sample * sample_plane_size];
+        destination[i] = sum >> log2_sample_count;
+    }
+}
+
+#if VULKAN_RESOLVE_KERNEL_HAS_X86_KERNELS
+// The x86 kernels widen the bytes to 16 bits before adding them: the sum of 8 samples is at most
+// 8 * 255, so it can't overflow.
+
+__attribute__((target("sse2"))) void resolve_unorm8_sse2(unsigned char *destination,
+                                                         const unsigned char *source,
+                                                         std::size_t sample_plane_size,
+                                                         std::uint32_t log2_sample_count,
+                                                         std::size_t byte_count)
+{
+    constexpr std::size_t vector_size = 16;
+    std::uint32_t sample_count = 1UL << log2_sample_count;
+    auto rounding = _mm_set1_epi16(sample_count / 2);
+    auto shift = _mm_cvtsi32_si128(log2_sample_count);
+    auto zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for(; i + vector_size <= byte_count; i += vector_size)
+    {
+        auto low_sum = rounding;
+        auto high_sum = rounding;
+        for(std::uint32_t sample = 0; sample < sample_count; sample++)
+        {
+            auto bytes = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(source + i + sample * sample_plane_size));
+            low_sum = _mm_add_epi16(low_sum, _mm_unpacklo_epi8(bytes, zero));
+            high_sum = _mm_add_epi16(high_sum, _mm_unpackhi_epi8(bytes, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i),
+                         _mm_packus_epi16(_mm_srl_epi16(low_sum, shift),
+                                          _mm_srl_epi16(high_sum, shift)));
+    }
+    resolve_unorm8_generic(
+        destination + i, source + i, sample_plane_size, log2_sample_count, byte_count - i);
+}
+
+__attribute__((target("avx2"))) void resolve_unorm8_avx2(unsigned char *destination,
+                                                         const unsigned char *source,
+                                                         std::size_t sample_plane_size,
+                                                         std::uint32_t log2_sample_count,
+                                                         std::size_t byte_count)
+{
+    constexpr std::size_t vector_size = 32;
+    std::uint32_t sample_count = 1UL << log2_sample_count;
+    auto rounding = _mm256_set1_epi16(sample_count / 2);
+    auto shift = _mm_cvtsi32_si128(log2_sample_count);
+    std::size_t i = 0;
+    for(; i + vector_size <= byte_count; i += vector_size)
+    {
+        auto low_sum = rounding;
+        auto high_sum = rounding;
+        for(std::uint32_t sample = 0; sample < sample_count; sample++)
+        {
+            auto *bytes = source + i + sample * sample_plane_size;
+            low_sum = _mm256_add_epi16(
+                low_sum,
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes))));
+            high_sum = _mm256_add_epi16(high_sum,
+                                        _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                                            reinterpret_cast<const __m128i *>(bytes + 16))));
+        }
+        // packus works within each 128-bit half, so the 64-bit quarters need to be reordered
+        auto packed = _mm256_packus_epi16(_mm256_srl_epi16(low_sum, shift),
+                                          _mm256_srl_epi16(high_sum, shift));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i),
+                            _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    resolve_unorm8_generic(
+        destination + i, source + i, sample_plane_size, log2_sample_count, byte_count - i);
+}
+#endif
+}
+
+const Unorm8_resolve_kernel &Unorm8_resolve_kernel::get() noexcept
+{
+    static const Unorm8_resolve_kernel retval = []() noexcept->Unorm8_resolve_kernel
+    {
+#if VULKAN_RESOLVE_KERNEL_HAS_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return Unorm8_resolve_kernel{
+                .function = resolve_unorm8_avx2, .name = "avx2",
+            };
+        if(__builtin_cpu_supports("sse2"))
+            return Unorm8_resolve_kernel{
+                .function = resolve_unorm8_sse2, .name = "sse2",
+            };
+#endif
+        return Unorm8_resolve_kernel{
+            .function = resolve_unorm8_generic, .name = "generic",
+        };
+    }();
+    return retval;
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 Jacob Lifshay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef VULKAN_RESOLVE_KERNEL_H_
+#define VULKAN_RESOLVE_KERNEL_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace kazan
+{
+namespace vulkan
+{
+/** averages the samples of multisample pixels with 8-bit components, for resolving Unorm8 and
+ * Srgb8 images. Byte i of destination is set to the rounded average of byte i of each of the
+ * 1 << log2_sample_count sample planes, which start at source and are sample_plane_size bytes
+ * apart. sRGB components are averaged without decoding them first, which the spec allows. */
+struct Unorm8_resolve_kernel
+{
+    typedef void (*Function)(unsigned char *destination,
+                             const unsigned char *source,
+                             std::size_t sample_plane_size,
+                             std::uint32_t log2_sample_count,
+                             std::size_t byte_count);
+    Function function;
+    const char *name;
+    /** returns the fastest kernel that the running cpu supports */
+    static const Unorm8_resolve_kernel &get() noexcept;
+};
+}
+}
+
+#endif // VULKAN_RESOLVE_KERNEL_H_
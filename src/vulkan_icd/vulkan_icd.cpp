@@ -385,9 +385,9 @@ extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device,
     assert(device);
     assert(memory);
     assert(data);
-    *data = static_cast<unsigned char *>(
-                vulkan::Vulkan_device_memory::from_handle(memory)->memory.get())
-            + offset;
+    auto *device_memory = vulkan::Vulkan_device_memory::from_handle(memory);
+    assert(!device_memory->is_lazily_allocated() && "lazily allocated memory isn't host visible");
+    *data = static_cast<unsigned char *>(device_memory->memory.get()) + offset;
     return VK_SUCCESS;
 }
 
@@ -400,22 +400,29 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device, VkDeviceMem
 extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(
     VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange *pMemoryRanges)
 {
-#warning finish implementing vkFlushMappedMemoryRanges
-    assert(!"vkFlushMappedMemoryRanges is not implemented");
+    assert(device);
+    assert(memoryRangeCount == 0 || pMemoryRanges);
+    // the only host visible memory type is host coherent, and the device is the CPU
+    return VK_SUCCESS;
 }
 
 extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(
     VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange *pMemoryRanges)
 {
-#warning finish implementing vkInvalidateMappedMemoryRanges
-    assert(!"vkInvalidateMappedMemoryRanges is not implemented");
+    assert(device);
+    assert(memoryRangeCount == 0 || pMemoryRanges);
+    // the only host visible memory type is host coherent, and the device is the CPU
+    return VK_SUCCESS;
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkGetDeviceMemoryCommitment(
     VkDevice device, VkDeviceMemory memory, VkDeviceSize *pCommittedMemoryInBytes)
 {
-#warning finish implementing vkGetDeviceMemoryCommitment
-    assert(!"vkGetDeviceMemoryCommitment is not implemented");
+    assert(device);
+    assert(memory);
+    assert(pCommittedMemoryInBytes);
+    *pCommittedMemoryInBytes =
+        vulkan::Vulkan_device_memory::from_handle(memory)->get_committed_size();
 }
 
 extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device,
@@ -432,9 +439,10 @@ extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device,
             auto *buffer_pointer = vulkan::Vulkan_buffer::from_handle(buffer);
             auto *device_memory = vulkan::Vulkan_device_memory::from_handle(memory);
             assert(!buffer_pointer->memory);
-            buffer_pointer->memory = std::shared_ptr<void>(
-                device_memory->memory,
-                static_cast<unsigned char *>(device_memory->memory.get()) + memory_offset);
+            auto memory_requirements = buffer_pointer->descriptor.get_memory_requirements();
+            assert(memory_offset % memory_requirements.alignment == 0);
+            buffer_pointer->memory =
+                device_memory->get_range(memory_offset, memory_requirements.size);
             return VK_SUCCESS;
         });
 }
@@ -453,9 +461,11 @@ extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device,
             auto *image_pointer = vulkan::Vulkan_image::from_handle(image);
             auto *device_memory = vulkan::Vulkan_device_memory::from_handle(memory);
             assert(!image_pointer->memory);
-            image_pointer->memory = std::shared_ptr<void>(
-                device_memory->memory,
-                static_cast<unsigned char *>(device_memory->memory.get()) + memory_offset);
+            auto memory_requirements = image_pointer->descriptor.get_memory_requirements();
+            assert(memory_offset % memory_requirements.alignment == 0);
+            image_pointer->memory =
+                device_memory->get_range(memory_offset, memory_requirements.size);
+            image_pointer->is_memory_lazily_allocated = device_memory->is_lazily_allocated();
             return VK_SUCCESS;
         });
 }
@@ -763,8 +773,39 @@ extern "C" VKAPI_ATTR void VKAPI_CALL
                                 const VkImageSubresource *pSubresource,
                                 VkSubresourceLayout *pLayout)
 {
-#warning finish implementing vkGetImageSubresourceLayout
-    assert(!"vkGetImageSubresourceLayout is not implemented");
+    assert(device);
+    assert(image);
+    assert(pSubresource);
+    assert(pLayout);
+    auto *image_pointer = vulkan::Vulkan_image::from_handle(image);
+    assert(image_pointer->descriptor.tiling == VK_IMAGE_TILING_LINEAR);
+    assert(pSubresource->mipLevel == 0 && "mipmapping is unimplemented");
+    assert(pSubresource->arrayLayer == 0 && "array images are unimplemented");
+    auto memory_properties = image_pointer->descriptor.get_memory_properties();
+    vulkan::Vulkan_image_descriptor::Image_memory_properties::Subimage subimage;
+    switch(pSubresource->aspectMask)
+    {
+    case VK_IMAGE_ASPECT_COLOR_BIT:
+        subimage = memory_properties.get_color_component();
+        break;
+    case VK_IMAGE_ASPECT_DEPTH_BIT:
+        subimage = memory_properties.get_depth_component();
+        break;
+    case VK_IMAGE_ASPECT_STENCIL_BIT:
+        subimage = memory_properties.get_stencil_component();
+        break;
+    default:
+        assert(!"invalid aspect mask passed to vkGetImageSubresourceLayout");
+    }
+    // the layout of sample 0, which is the only sample of the single-sample images that the
+    // application can access
+    *pLayout = VkSubresourceLayout{
+        .offset = subimage.offset_from_array_layer_start,
+        .size = subimage.sample_plane_size,
+        .rowPitch = subimage.stride,
+        .arrayPitch = memory_properties.array_layer_size,
+        .depthPitch = subimage.sample_plane_size,
+    };
 }
 
 extern "C" VKAPI_ATTR VkResult VKAPI_CALL
@@ -1230,12 +1271,20 @@ extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer c
         });
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer commandBuffer,
-                                                        VkPipelineBindPoint pipelineBindPoint,
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer command_buffer,
+                                                        VkPipelineBindPoint pipeline_bind_point,
                                                         VkPipeline pipeline)
 {
-#warning finish implementing vkCmdBindPipeline
-    assert(!"vkCmdBindPipeline is not implemented");
+    assert(command_buffer);
+    assert(pipeline);
+    assert(pipeline_bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS
+           && "vkCmdBindPipeline for compute pipelines is not implemented");
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            command_buffer_pointer->recording_state.graphics_pipeline = pipeline;
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer commandBuffer,
@@ -1256,11 +1305,16 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer commandBuf
     assert(!"vkCmdSetScissor is not implemented");
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetLineWidth(VkCommandBuffer commandBuffer,
-                                                        float lineWidth)
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetLineWidth(VkCommandBuffer command_buffer,
+                                                        float line_width)
 {
-#warning finish implementing vkCmdSetLineWidth
-    assert(!"vkCmdSetLineWidth is not implemented");
+    assert(command_buffer);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            command_buffer_pointer->recording_state.line_width = line_width;
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthBias(VkCommandBuffer commandBuffer,
@@ -1325,44 +1379,203 @@ extern "C" VKAPI_ATTR void VKAPI_CALL
     assert(!"vkCmdBindDescriptorSets is not implemented");
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer,
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer command_buffer,
                                                            VkBuffer buffer,
                                                            VkDeviceSize offset,
-                                                           VkIndexType indexType)
+                                                           VkIndexType index_type)
 {
-#warning finish implementing vkCmdBindIndexBuffer
-    assert(!"vkCmdBindIndexBuffer is not implemented");
+    assert(command_buffer);
+    assert(buffer);
+    assert(index_type == VK_INDEX_TYPE_UINT16 || index_type == VK_INDEX_TYPE_UINT32);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto *buffer_pointer = vulkan::Vulkan_buffer::from_handle(buffer);
+            assert(buffer_pointer->memory);
+            assert(offset < buffer_pointer->descriptor.size);
+            auto &recording_state = command_buffer_pointer->recording_state;
+            recording_state.index_buffer =
+                static_cast<const unsigned char *>(buffer_pointer->memory.get()) + offset;
+            recording_state.index_type = index_type;
+        });
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer,
-                                                             uint32_t firstBinding,
-                                                             uint32_t bindingCount,
-                                                             const VkBuffer *pBuffers,
-                                                             const VkDeviceSize *pOffsets)
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer command_buffer,
+                                                             uint32_t first_binding,
+                                                             uint32_t binding_count,
+                                                             const VkBuffer *buffers,
+                                                             const VkDeviceSize *offsets)
 {
-#warning finish implementing vkCmdBindVertexBuffers
-    assert(!"vkCmdBindVertexBuffers is not implemented");
+    assert(command_buffer);
+    assert(binding_count > 0);
+    assert(buffers);
+    assert(offsets);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto &vertex_buffers = command_buffer_pointer->recording_state.vertex_buffers;
+            if(vertex_buffers.size() < first_binding + binding_count)
+                vertex_buffers.resize(first_binding + binding_count, nullptr);
+            for(std::uint32_t i = 0; i < binding_count; i++)
+            {
+                auto *buffer_pointer = vulkan::Vulkan_buffer::from_handle(buffers[i]);
+                assert(buffer_pointer);
+                assert(buffer_pointer->memory);
+                assert(offsets[i] < buffer_pointer->descriptor.size);
+                vertex_buffers[first_binding + i] =
+                    static_cast<unsigned char *>(buffer_pointer->memory.get()) + offsets[i];
+            }
+        });
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer,
-                                                uint32_t vertexCount,
-                                                uint32_t instanceCount,
-                                                uint32_t firstVertex,
-                                                uint32_t firstInstance)
+/** records a draw command using the currently bound state; for indexed draws, first and count are
+ * the range of indexes in the bound index buffer */
+static void record_draw(vulkan::Vulkan_command_buffer &command_buffer,
+                        std::uint32_t first,
+                        std::uint32_t count,
+                        std::uint32_t instance_count,
+                        std::uint32_t first_instance,
+                        bool is_indexed,
+                        std::int32_t vertex_offset)
+{
+    auto &recording_state = command_buffer.recording_state;
+    auto *graphics_pipeline =
+        pipeline::Graphics_pipeline::from_handle(recording_state.graphics_pipeline);
+    assert(graphics_pipeline && "draw command with no graphics pipeline bound");
+    auto *framebuffer = recording_state.framebuffer;
+    assert(framebuffer && "draw command outside of a render pass");
+    auto &render_pass = framebuffer->render_pass;
+    std::vector<const vulkan::Vulkan_image *> color_attachments;
+    color_attachments.reserve(render_pass.color_attachment_indexes.size());
+    for(auto color_attachment_index : render_pass.color_attachment_indexes)
+    {
+        if(color_attachment_index == VK_ATTACHMENT_UNUSED)
+            color_attachments.push_back(nullptr);
+        else
+            color_attachments.push_back(
+                &framebuffer->attachments[color_attachment_index]->base_image);
+    }
+    assert(color_attachments.size() == graphics_pipeline->get_color_attachment_count());
+    const vulkan::Vulkan_image *depth_attachment = nullptr;
+    if(render_pass.depth_stencil_attachment_index)
+        depth_attachment =
+            &framebuffer->attachments[*render_pass.depth_stencil_attachment_index]->base_image;
+    pipeline::Graphics_pipeline::Index_buffer index_buffer = {
+        .indexes = recording_state.index_buffer,
+        .index_type = recording_state.index_type,
+        .vertex_offset = vertex_offset,
+    };
+    assert((!is_indexed || index_buffer.indexes)
+           && "indexed draw command with no index buffer bound");
+    struct Draw_command final : public vulkan::Vulkan_command_buffer::Command
+    {
+        pipeline::Graphics_pipeline *graphics_pipeline;
+        std::uint32_t first;
+        std::uint32_t count;
+        std::uint32_t instance_count;
+        std::uint32_t first_instance;
+        bool is_indexed;
+        pipeline::Graphics_pipeline::Index_buffer index_buffer;
+        std::vector<void *> vertex_buffers;
+        std::vector<const vulkan::Vulkan_image *> color_attachments;
+        const vulkan::Vulkan_image *depth_attachment;
+        float line_width;
+        Draw_command(pipeline::Graphics_pipeline *graphics_pipeline,
+                     std::uint32_t first,
+                     std::uint32_t count,
+                     std::uint32_t instance_count,
+                     std::uint32_t first_instance,
+                     bool is_indexed,
+                     const pipeline::Graphics_pipeline::Index_buffer &index_buffer,
+                     std::vector<void *> vertex_buffers,
+                     std::vector<const vulkan::Vulkan_image *> color_attachments,
+                     const vulkan::Vulkan_image *depth_attachment,
+                     float line_width) noexcept
+            : graphics_pipeline(graphics_pipeline),
+              first(first),
+              count(count),
+              instance_count(instance_count),
+              first_instance(first_instance),
+              is_indexed(is_indexed),
+              index_buffer(index_buffer),
+              vertex_buffers(std::move(vertex_buffers)),
+              color_attachments(std::move(color_attachments)),
+              depth_attachment(depth_attachment),
+              line_width(line_width)
+        {
+        }
+        virtual void run(vulkan::Vulkan_command_buffer::Running_state &state) noexcept override
+        {
+            static_cast<void>(state);
+#warning finish implementing descriptor sets
+            graphics_pipeline->run(first,
+                                   first + count,
+                                   first_instance,
+                                   first_instance + instance_count,
+                                   is_indexed ? &index_buffer : nullptr,
+                                   color_attachments.data(),
+                                   depth_attachment,
+                                   vertex_buffers.data(),
+                                   nullptr,
+                                   line_width);
+        }
+    };
+    command_buffer.commands.push_back(std::make_unique<Draw_command>(graphics_pipeline,
+                                                                     first,
+                                                                     count,
+                                                                     instance_count,
+                                                                     first_instance,
+                                                                     is_indexed,
+                                                                     index_buffer,
+                                                                     recording_state.vertex_buffers,
+                                                                     std::move(color_attachments),
+                                                                     depth_attachment,
+                                                                     recording_state.line_width));
+}
+
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer command_buffer,
+                                                uint32_t vertex_count,
+                                                uint32_t instance_count,
+                                                uint32_t first_vertex,
+                                                uint32_t first_instance)
 {
-#warning finish implementing vkCmdDraw
-    assert(!"vkCmdDraw is not implemented");
+    assert(command_buffer);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            record_draw(*command_buffer_pointer,
+                        first_vertex,
+                        vertex_count,
+                        instance_count,
+                        first_instance,
+                        false,
+                        0);
+        });
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer commandBuffer,
-                                                       uint32_t indexCount,
-                                                       uint32_t instanceCount,
-                                                       uint32_t firstIndex,
-                                                       int32_t vertexOffset,
-                                                       uint32_t firstInstance)
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer command_buffer,
+                                                       uint32_t index_count,
+                                                       uint32_t instance_count,
+                                                       uint32_t first_index,
+                                                       int32_t vertex_offset,
+                                                       uint32_t first_instance)
 {
-#warning finish implementing vkCmdDrawIndexed
-    assert(!"vkCmdDrawIndexed is not implemented");
+    assert(command_buffer);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            record_draw(*command_buffer_pointer,
+                        first_index,
+                        index_count,
+                        instance_count,
+                        first_instance,
+                        true,
+                        vertex_offset);
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndirect(VkCommandBuffer commandBuffer,
@@ -1562,7 +1775,6 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdClearColorImage(VkCommandBuffer comma
                        && "vkCmdClearColorImage with clearing only some of the array layers is not implemented");
                 static_cast<void>(range);
             }
-#warning finish implementing non-linear image layouts
             struct Clear_command final : public vulkan::Vulkan_command_buffer::Command
             {
                 VkClearColorValue clear_color;
@@ -1585,15 +1797,64 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdClearColorImage(VkCommandBuffer comma
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL
-    vkCmdClearDepthStencilImage(VkCommandBuffer commandBuffer,
+    vkCmdClearDepthStencilImage(VkCommandBuffer command_buffer,
                                 VkImage image,
-                                VkImageLayout imageLayout,
-                                const VkClearDepthStencilValue *pDepthStencil,
-                                uint32_t rangeCount,
-                                const VkImageSubresourceRange *pRanges)
+                                VkImageLayout image_layout,
+                                const VkClearDepthStencilValue *depth_stencil,
+                                uint32_t range_count,
+                                const VkImageSubresourceRange *ranges)
 {
-#warning finish implementing vkCmdClearDepthStencilImage
-    assert(!"vkCmdClearDepthStencilImage is not implemented");
+    assert(command_buffer);
+    assert(image);
+    assert(image_layout == VK_IMAGE_LAYOUT_GENERAL
+           || image_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    assert(depth_stencil);
+    assert(range_count > 0);
+    assert(ranges);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto image_pointer = vulkan::Vulkan_image::from_handle(image);
+            VkImageAspectFlags aspect_mask = 0;
+            for(std::uint32_t i = 0; i < range_count; i++)
+            {
+                auto &range = ranges[i];
+                assert((range.aspectMask
+                        & ~(VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT))
+                       == 0);
+                assert(range.baseMipLevel == 0
+                       && (range.levelCount == image_pointer->descriptor.mip_levels
+                           || range.levelCount == VK_REMAINING_MIP_LEVELS)
+                       && "vkCmdClearDepthStencilImage with clearing only some of the mipmap levels is not implemented");
+                assert(range.baseArrayLayer == 0
+                       && (range.layerCount == image_pointer->descriptor.array_layers
+                           || range.layerCount == VK_REMAINING_ARRAY_LAYERS)
+                       && "vkCmdClearDepthStencilImage with clearing only some of the array layers is not implemented");
+                aspect_mask |= range.aspectMask;
+            }
+            struct Clear_command final : public vulkan::Vulkan_command_buffer::Command
+            {
+                VkClearDepthStencilValue clear_value;
+                VkImageAspectFlags aspect_mask;
+                vulkan::Vulkan_image *image;
+                Clear_command(const VkClearDepthStencilValue &clear_value,
+                              VkImageAspectFlags aspect_mask,
+                              vulkan::Vulkan_image *image) noexcept : clear_value(clear_value),
+                                                                      aspect_mask(aspect_mask),
+                                                                      image(image)
+                {
+                }
+                virtual void run(
+                    vulkan::Vulkan_command_buffer::Running_state &state) noexcept override
+                {
+                    static_cast<void>(state);
+                    image->clear_depth_stencil(clear_value, aspect_mask);
+                }
+            };
+            command_buffer_pointer->commands.push_back(
+                std::make_unique<Clear_command>(*depth_stencil, aspect_mask, image_pointer));
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdClearAttachments(VkCommandBuffer commandBuffer,
@@ -1606,16 +1867,55 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdClearAttachments(VkCommandBuffer comm
     assert(!"vkCmdClearAttachments is not implemented");
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdResolveImage(VkCommandBuffer commandBuffer,
-                                                        VkImage srcImage,
-                                                        VkImageLayout srcImageLayout,
-                                                        VkImage dstImage,
-                                                        VkImageLayout dstImageLayout,
-                                                        uint32_t regionCount,
-                                                        const VkImageResolve *pRegions)
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdResolveImage(VkCommandBuffer command_buffer,
+                                                        VkImage source_image,
+                                                        VkImageLayout source_image_layout,
+                                                        VkImage destination_image,
+                                                        VkImageLayout destination_image_layout,
+                                                        uint32_t region_count,
+                                                        const VkImageResolve *regions)
 {
-#warning finish implementing vkCmdResolveImage
-    assert(!"vkCmdResolveImage is not implemented");
+    assert(command_buffer);
+    assert(source_image);
+    assert(destination_image);
+    assert(source_image_layout == VK_IMAGE_LAYOUT_GENERAL
+           || source_image_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    assert(destination_image_layout == VK_IMAGE_LAYOUT_GENERAL
+           || destination_image_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    assert(region_count > 0);
+    assert(regions);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto source_image_pointer = vulkan::Vulkan_image::from_handle(source_image);
+            auto destination_image_pointer = vulkan::Vulkan_image::from_handle(destination_image);
+            struct Resolve_command final : public vulkan::Vulkan_command_buffer::Command
+            {
+                const vulkan::Vulkan_image *source_image;
+                vulkan::Vulkan_image *destination_image;
+                std::vector<VkImageResolve> regions;
+                Resolve_command(const vulkan::Vulkan_image *source_image,
+                                vulkan::Vulkan_image *destination_image,
+                                std::vector<VkImageResolve> regions) noexcept
+                    : source_image(source_image),
+                      destination_image(destination_image),
+                      regions(std::move(regions))
+                {
+                }
+                virtual void run(
+                    vulkan::Vulkan_command_buffer::Running_state &state) noexcept override
+                {
+                    static_cast<void>(state);
+                    for(auto &region : regions)
+                        source_image->resolve(*destination_image, region);
+                }
+            };
+            command_buffer_pointer->commands.push_back(std::make_unique<Resolve_command>(
+                source_image_pointer,
+                destination_image_pointer,
+                std::vector<VkImageResolve>(regions, regions + region_count)));
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdSetEvent(VkCommandBuffer commandBuffer,
@@ -1691,13 +1991,46 @@ extern "C" VKAPI_ATTR void VKAPI_CALL
                 assert(!"vkCmdPipelineBarrier for VkBufferMemoryBarrier is not implemented");
                 any_memory_barriers = true;
             }
+            // transitions from VK_IMAGE_LAYOUT_UNDEFINED discard the image contents, which is
+            // how images that alias the same memory hand it over to each other, so the image's
+            // lazy clears are dropped instead of later overwriting the other image's pixels
+            struct Discarded_image
+            {
+                vulkan::Vulkan_image *image;
+                VkImageAspectFlags aspect_mask;
+            };
+            std::vector<Discarded_image> discarded_images;
             for(std::uint32_t i = 0; i < image_memory_barrier_count; i++)
             {
                 auto &image_memory_barrier = image_memory_barriers[i];
                 assert(image_memory_barrier.sType == VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER);
-#warning finish implementing non-linear image layouts
+                if(image_memory_barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+                    discarded_images.push_back(Discarded_image{
+                        .image = vulkan::Vulkan_image::from_handle(image_memory_barrier.image),
+                        .aspect_mask = image_memory_barrier.subresourceRange.aspectMask,
+                    });
                 any_memory_barriers = true;
             }
+            if(!discarded_images.empty())
+            {
+                struct Discard_command final : public vulkan::Vulkan_command_buffer::Command
+                {
+                    std::vector<Discarded_image> discarded_images;
+                    explicit Discard_command(std::vector<Discarded_image> discarded_images) noexcept
+                        : discarded_images(std::move(discarded_images))
+                    {
+                    }
+                    void run(kazan::vulkan::Vulkan_command_buffer::Running_state
+                                 &state) noexcept override
+                    {
+                        static_cast<void>(state);
+                        for(auto &discarded_image : discarded_images)
+                            discarded_image.image->discard_clears(discarded_image.aspect_mask);
+                    }
+                };
+                command_buffer_pointer->commands.push_back(
+                    std::make_unique<Discard_command>(std::move(discarded_images)));
+            }
             if(any_memory_barriers)
             {
                 struct Generic_memory_barrier_command final
@@ -1776,12 +2109,89 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer command
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL
-    vkCmdBeginRenderPass(VkCommandBuffer commandBuffer,
-                         const VkRenderPassBeginInfo *pRenderPassBegin,
+    vkCmdBeginRenderPass(VkCommandBuffer command_buffer,
+                         const VkRenderPassBeginInfo *render_pass_begin,
                          VkSubpassContents contents)
 {
-#warning finish implementing vkCmdBeginRenderPass
-    assert(!"vkCmdBeginRenderPass is not implemented");
+    assert(command_buffer);
+    assert(render_pass_begin);
+    assert(render_pass_begin->sType == VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO);
+    assert(render_pass_begin->renderPass);
+    assert(render_pass_begin->framebuffer);
+    assert(render_pass_begin->clearValueCount == 0 || render_pass_begin->pClearValues);
+    assert(contents == VK_SUBPASS_CONTENTS_INLINE
+           && "vkCmdBeginRenderPass with secondary command buffers is not implemented");
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto *framebuffer =
+                vulkan::Vulkan_framebuffer::from_handle(render_pass_begin->framebuffer);
+            auto &render_area = render_pass_begin->renderArea;
+            static_cast<void>(render_area);
+            assert(render_area.offset.x == 0 && render_area.offset.y == 0
+                   && render_area.extent.width == framebuffer->width
+                   && render_area.extent.height == framebuffer->height
+                   && "vkCmdBeginRenderPass with a partial render area is not implemented");
+            assert(command_buffer_pointer->recording_state.framebuffer == nullptr);
+            command_buffer_pointer->recording_state.framebuffer = framebuffer;
+            struct Begin_render_pass_command final : public vulkan::Vulkan_command_buffer::Command
+            {
+                vulkan::Vulkan_framebuffer *framebuffer;
+                std::vector<VkClearValue> clear_values;
+                Begin_render_pass_command(vulkan::Vulkan_framebuffer *framebuffer,
+                                          std::vector<VkClearValue> clear_values) noexcept
+                    : framebuffer(framebuffer),
+                      clear_values(std::move(clear_values))
+                {
+                }
+                virtual void run(
+                    vulkan::Vulkan_command_buffer::Running_state &state) noexcept override
+                {
+                    static_cast<void>(state);
+                    // the load ops only update the tiled attachments' per-tile clear state,
+                    // and the back end initializes each tile the first time a draw touches it
+                    auto &render_pass = framebuffer->render_pass;
+                    for(std::size_t i = 0; i < render_pass.attachments.size(); i++)
+                    {
+                        auto &attachment = render_pass.attachments[i];
+                        auto &image = framebuffer->attachments[i]->base_image;
+                        if(render_pass.depth_stencil_attachment_index
+                           && i == *render_pass.depth_stencil_attachment_index)
+                        {
+                            VkImageAspectFlags clear_aspect_mask = 0;
+                            VkImageAspectFlags discard_aspect_mask = 0;
+                            if(attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+                                clear_aspect_mask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+                            else if(attachment.loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE)
+                                discard_aspect_mask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+                            if(attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+                                clear_aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+                            else if(attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE)
+                                discard_aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+                            image.discard_clears(discard_aspect_mask);
+                            if(clear_aspect_mask != 0)
+                                image.clear_depth_stencil(clear_values[i].depthStencil,
+                                                          clear_aspect_mask);
+                        }
+                        else if(attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+                        {
+                            image.clear(clear_values[i].color);
+                        }
+                        else if(attachment.loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE)
+                        {
+                            // the tiles that are still cleared don't need to be filled
+                            image.discard_clears(VK_IMAGE_ASPECT_COLOR_BIT);
+                        }
+                    }
+                }
+            };
+            command_buffer_pointer->commands.push_back(std::make_unique<Begin_render_pass_command>(
+                framebuffer,
+                std::vector<VkClearValue>(render_pass_begin->pClearValues,
+                                          render_pass_begin->pClearValues
+                                              + render_pass_begin->clearValueCount)));
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdNextSubpass(VkCommandBuffer commandBuffer,
@@ -1791,10 +2201,61 @@ extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdNextSubpass(VkCommandBuffer commandBu
     assert(!"vkCmdNextSubpass is not implemented");
 }
 
-extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer commandBuffer)
+extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer command_buffer)
 {
-#warning finish implementing vkCmdEndRenderPass
-    assert(!"vkCmdEndRenderPass is not implemented");
+    assert(command_buffer);
+    auto command_buffer_pointer = vulkan::Vulkan_command_buffer::from_handle(command_buffer);
+    command_buffer_pointer->record_command_and_keep_errors(
+        [&]()
+        {
+            auto *framebuffer = command_buffer_pointer->recording_state.framebuffer;
+            assert(framebuffer != nullptr);
+            command_buffer_pointer->recording_state.framebuffer = nullptr;
+            struct End_render_pass_command final : public vulkan::Vulkan_command_buffer::Command
+            {
+                vulkan::Vulkan_framebuffer *framebuffer;
+                explicit End_render_pass_command(vulkan::Vulkan_framebuffer *framebuffer) noexcept
+                    : framebuffer(framebuffer)
+                {
+                }
+                virtual void run(
+                    vulkan::Vulkan_command_buffer::Running_state &state) noexcept override
+                {
+                    static_cast<void>(state);
+                    // draws write the attachments' tiles directly, so there's nothing to write
+                    // back; the contents of attachments that aren't stored are undefined, so
+                    // their tiles that are still cleared are never filled
+                    auto &render_pass = framebuffer->render_pass;
+                    for(std::size_t i = 0; i < render_pass.attachments.size(); i++)
+                    {
+                        auto &attachment = render_pass.attachments[i];
+                        VkImageAspectFlags discard_aspect_mask = 0;
+                        if(render_pass.depth_stencil_attachment_index
+                           && i == *render_pass.depth_stencil_attachment_index)
+                        {
+                            if(attachment.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE)
+                                discard_aspect_mask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+                            if(attachment.stencilStoreOp == VK_ATTACHMENT_STORE_OP_DONT_CARE)
+                                discard_aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+                        }
+                        else if(attachment.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE)
+                        {
+                            discard_aspect_mask |= VK_IMAGE_ASPECT_COLOR_BIT;
+                        }
+                        auto &image = framebuffer->attachments[i]->base_image;
+                        // transient attachments in lazily allocated memory also give their
+                        // pages back, so they only take memory while a render pass uses them
+                        if(discard_aspect_mask
+                           == image.descriptor.get_memory_properties().get_aspect_mask())
+                            image.release_memory();
+                        else
+                            image.discard_clears(discard_aspect_mask);
+                    }
+                }
+            };
+            command_buffer_pointer->commands.push_back(
+                std::make_unique<End_render_pass_command>(framebuffer));
+        });
 }
 
 extern "C" VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands(VkCommandBuffer commandBuffer,
@@ -452,7 +452,9 @@ struct Xcb_wsi::Implementation
                                        1,
                                        1,
                                        VK_SAMPLE_COUNT_1_BIT,
-                                       VK_IMAGE_TILING_OPTIMAL));
+                                       // presenting reads the image memory directly
+                                       VK_IMAGE_TILING_LINEAR,
+                                       0));
     }
     struct Swapchain final : public Vulkan_swapchain
     {
@@ -545,6 +547,7 @@ struct Xcb_wsi::Implementation
                 status = Status::Out_of_date;
             }
             start_setup_results.image_descriptor.format = create_info.imageFormat;
+            start_setup_results.image_descriptor.usage = create_info.imageUsage;
             swapchain_width = start_setup_results.image_width;
             swapchain_height = start_setup_results.image_height;
             const char *warning_message_present_mode_name = nullptr;